@@ -0,0 +1,931 @@
+/**
+ * @file bench_pty.c
+ * @brief Headless rendering benchmark, run with `make bench`.
+ *
+ * The pager is run inside a pseudo-terminal, so no real terminal is
+ * needed.  Scripted keystrokes are written to the master side of
+ * the pty, read back from the raw-mode slave and dispatched to
+ * pager actions, as a keyboard-driven program would.  Screen output
+ * goes to the slave and is drained by a background thread.
+ *
+ * The program is linked with `-Wl,--wrap=write` to count the write
+ * calls and bytes that reach the terminal.
+ *
+ * Each scenario prints one line of JSON to the original stdout.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdint.h>       // intptr_t
+#include <sched.h>        // sched_yield()
+#include <termios.h>
+#include <pty.h>          // openpty()
+#include <malloc.h>       // mallinfo2()
+
+#include "pager.h"
+
+/** @brief Counters shared by the write wrapper and the printer */
+typedef struct bench_counters {
+   long writes;
+   long bytes;
+   long printer_calls;
+} BCOUNTERS;
+
+static BCOUNTERS counters;
+
+/** @brief Microseconds to wait before each keystroke, as a reader would */
+static int idle_us;
+
+ssize_t __real_write(int fd, const void *buff, size_t count);
+
+/**
+ * @brief Replaces `write` in this program and libpager.a.
+ */
+ssize_t __wrap_write(int fd, const void *buff, size_t count)
+{
+   if (fd == STDOUT_FILENO)
+   {
+      ++counters.writes;
+      counters.bytes += count;
+   }
+   return __real_write(fd, buff, count);
+}
+
+/**
+ * @brief Discard everything the pager writes to the terminal.
+ */
+static void *drain_master(void *arg)
+{
+   int fd = *(int*)arg;
+   char buff[65536];
+   while (read(fd, buff, sizeof(buff)) > 0)
+      ;
+   return NULL;
+}
+
+static int bench_printer(int row_index,
+                         int indicated,
+                         int length,
+                         void *data_source,
+                         void *data_extra)
+{
+   ++counters.printer_calls;
+
+   if (indicated)
+      ti_write_str("\x1b[7m");
+
+   int len = ti_printf("%-*.*s%10d", length - 10, length - 10,
+                       "Row of generated content for the benchmark", row_index);
+
+   if (indicated)
+      ti_write_str("\x1b[27m");
+
+   return len;
+}
+
+static const char *const levels[] = { "INFO ", "WARN ", "ERROR" };
+
+/**
+ * @brief Printer of a coloured log line that writes its own escape
+ *        sequences, resetting after each field as printers did
+ *        before styled spans.
+ */
+static int styled_raw_printer(int row_index,
+                              int indicated,
+                              int length,
+                              void *data_source,
+                              void *data_extra)
+{
+   ++counters.printer_calls;
+
+   int level = row_index % 7 == 0 ? 2 : (row_index % 3 == 0 ? 1 : 0);
+   static const char *const colors[] = { "\x1b[32m", "\x1b[33m", "\x1b[1;31m" };
+
+   if (indicated)
+      ti_write_str("\x1b[7m");
+
+   int len = ti_printf("\x1b[36m%08d\x1b[0m%s %s%s\x1b[0m%s %-*.*s",
+                       row_index, indicated ? "\x1b[7m" : "",
+                       colors[level], levels[level], indicated ? "\x1b[7m" : "",
+                       length - 15, length - 15,
+                       "Log message generated for the styled printer benchmark");
+
+   if (indicated)
+      ti_write_str("\x1b[27m");
+
+   return len;
+}
+
+/**
+ * @brief The same log line as runs of styled text.
+ */
+static int styled_span_printer(int row_index,
+                               int indicated,
+                               int length,
+                               void *data_source,
+                               void *data_extra)
+{
+   ++counters.printer_calls;
+
+   int level = row_index % 7 == 0 ? 2 : (row_index % 3 == 0 ? 1 : 0);
+   static const PSTYLE styles[] = {
+      { PAGER_COLOR(2), 0, 0 },
+      { PAGER_COLOR(3), 0, 0 },
+      { PAGER_COLOR(1), 0, PAGER_ATTR_BOLD }
+   };
+
+   char number[16];
+   int number_len = snprintf(number, sizeof(number), "%08d", row_index);
+   static const char message[] = "Log message generated for the styled printer benchmark";
+
+   PSPAN spans[] = {
+      { number, number_len, { PAGER_COLOR(6), 0, 0 } },
+      { " ", 1, { 0, 0, 0 } },
+      { levels[level], 5, styles[level] },
+      { " ", 1, { 0, 0, 0 } },
+      { message, (int)sizeof(message) - 1, { 0, 0, 0 } }
+   };
+
+   return pager_write_spans(spans, 5, length, indicated);
+}
+
+/** @brief Strings in the string-array scenarios */
+#define STRING_ROWS 100000
+
+/**
+ * @brief Printer of an array of C strings, as programs wrote before
+ *        the library could draw string arrays itself.
+ */
+static int string_callback_printer(int row_index,
+                                   int indicated,
+                                   int length,
+                                   void *data_source,
+                                   void *data_extra)
+{
+   ++counters.printer_calls;
+
+   const char *val = ((const char **)data_source)[row_index];
+   PSPAN span = { val, (int)strlen(val), { 0, 0, 0 } };
+   return pager_write_spans(&span, 1, length, indicated);
+}
+
+/** @brief Nanoseconds spent by the slow printer on each row */
+#define SLOW_PRINTER_NS 20000
+
+/**
+ * @brief Wait as long as a query of a database takes.
+ */
+static void wait_for_query(void)
+{
+   struct timespec start, now;
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   do
+      clock_gettime(CLOCK_MONOTONIC, &now);
+   while ((now.tv_sec - start.tv_sec) * 1000000000L
+          + (now.tv_nsec - start.tv_nsec) < SLOW_PRINTER_NS);
+}
+
+/**
+ * @brief Printer of a source that takes time to produce each row,
+ *        like one that queries a database.
+ */
+static int slow_printer(int row_index,
+                        int indicated,
+                        int length,
+                        void *data_source,
+                        void *data_extra)
+{
+   __atomic_add_fetch(&counters.printer_calls, 1, __ATOMIC_RELAXED);
+
+   wait_for_query();
+
+   char text[64];
+   int len = snprintf(text, sizeof(text), "%08d row of a slow source", row_index);
+   PSPAN span = { text, len, { 0, 0, 0 } };
+   return pager_write_spans(&span, 1, length, indicated);
+}
+
+/**
+ * @brief Fetch rows of the slow source with one query.
+ */
+static int slow_get_rows(void *source, int first, int count, void **rows)
+{
+   wait_for_query();
+
+   // The row is its index, offset to not be NULL:
+   for (int i = 0; i < count; ++i)
+      rows[i] = (void*)(intptr_t)(first + i + 1);
+   return count;
+}
+
+static int slow_row_count(void *source)
+{
+   return 1000000;
+}
+
+static int slow_print_row(void *row, int row_index, int indicated, int length, void *source)
+{
+   ++counters.printer_calls;
+
+   char text[64];
+   int len = snprintf(text, sizeof(text), "%08d row of a slow source",
+                      (int)((intptr_t)row - 1));
+   PSPAN span = { text, len, { 0, 0, 0 } };
+   return pager_write_spans(&span, 1, length, indicated);
+}
+
+/** @brief Shape of the wide table used to compare printers */
+#define TABLE_ROWS 200000
+#define TABLE_COLUMNS 30
+
+static long *table_longs;
+static double *table_doubles;
+
+/**
+ * @brief Printer that formats every column of a wide table, then
+ *        writes as much of the line as fits, as applications did
+ *        before the table engine.
+ */
+static int wide_line_printer(int row_index,
+                             int indicated,
+                             int length,
+                             void *data_source,
+                             void *data_extra)
+{
+   ++counters.printer_calls;
+
+   char line[TABLE_COLUMNS * 16];
+   int len = 0;
+   for (int col = 0; col < TABLE_COLUMNS; ++col)
+   {
+      if (col % 2)
+         len += snprintf(line + len, sizeof(line) - len, "%10.2f ", table_doubles[row_index]);
+      else
+         len += snprintf(line + len, sizeof(line) - len, "%10ld ", table_longs[row_index] + col);
+   }
+
+   if (len > length)
+      len = length;
+
+   if (indicated)
+      ti_write_str("\x1b[7m");
+   ti_write(line, len);
+   if (indicated)
+      ti_write_str("\x1b[27m");
+
+   return len;
+}
+
+/** @brief Keystrokes recognized by the benchmark key dispatcher */
+typedef struct bench_key {
+   const char *stroke;
+   PACTION action;
+} BKEY;
+
+static const BKEY bench_keys[] = {
+   { "\x1b[B",  pager_focus_down_one },
+   { "\x1b[A",  pager_focus_up_one },
+   { "\x1b[6~", pager_focus_down_page },
+   { "\x1b[5~", pager_focus_up_page },
+   { "\x1b[F",  pager_focus_end },
+   { "\x1b[H",  pager_focus_home },
+   { NULL, NULL }
+};
+
+/**
+ * @brief Read one keystroke from the terminal and run its action.
+ */
+static void dispatch_keystroke(DPARMS *parms, int fd)
+{
+   char buff[16];
+   ssize_t len = read(fd, buff, sizeof(buff) - 1);
+   if (len <= 0)
+      return;
+   buff[len] = '\0';
+
+   const BKEY *key = bench_keys;
+   for (; key->stroke; ++key)
+   {
+      if (strcmp(key->stroke, buff) == 0)
+      {
+         unsigned long trace = pager_trace_begin();
+         if ((*key->action)(parms) == ARV_REPLOT_DATA)
+            pager_plot(parms);
+         pager_trace_end(trace, "key", (int)(key - bench_keys));
+         break;
+      }
+   }
+}
+
+static long elapsed_ns(const struct timespec *start, const struct timespec *end)
+{
+   return (end->tv_sec - start->tv_sec) * 1000000000L
+      + (end->tv_nsec - start->tv_nsec);
+}
+
+static int compare_long(const void *left, const void *right)
+{
+   long l = *(const long*)left, r = *(const long*)right;
+   return (l > r) - (l < r);
+}
+
+static long percentile(const long *sorted, int count, int pct)
+{
+   int index = (int)((long)count * pct / 100);
+   if (index >= count)
+      index = count - 1;
+   return sorted[index];
+}
+
+/**
+ * @brief Run a scripted keystroke sequence and report the results.
+ * @param "name"    scenario name for the report
+ * @param "parms"   pager being exercised
+ * @param "fds"     pty master and slave
+ * @param "strokes" NULL-terminated list of keystrokes, sent in turn
+ *                  and repeated as necessary
+ * @param "count"   number of keystrokes to send, or 0 to continue
+ *                  until the focus stops moving
+ * @param "out"     stream for the JSON report
+ */
+static void run_scenario(const char *name,
+                         DPARMS *parms,
+                         const int *fds,
+                         const char **strokes,
+                         int count,
+                         FILE *out)
+{
+   int limit = count ? count : parms->row_count;
+   long *times = (long*)malloc(sizeof(long) * limit);
+   int actions = 0;
+   const char **stroke = strokes;
+
+   memset(&counters, 0, sizeof(counters));
+
+   while (actions < limit)
+   {
+      int old_focus = parms->index_row_focus;
+
+      if (idle_us)
+         usleep(idle_us);
+
+      __real_write(fds[0], *stroke, strlen(*stroke));
+      if (*++stroke == NULL)
+         stroke = strokes;
+
+      struct timespec start, end;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      dispatch_keystroke(parms, fds[1]);
+      clock_gettime(CLOCK_MONOTONIC, &end);
+
+      times[actions++] = elapsed_ns(&start, &end);
+
+      if (count == 0 && parms->index_row_focus == old_focus)
+         break;
+   }
+
+   qsort(times, actions, sizeof(long), compare_long);
+
+   fprintf(out,
+           "{\"scenario\":\"%s\",\"rows\":%d,\"actions\":%d,"
+           "\"latency_ns\":{\"p50\":%ld,\"p90\":%ld,\"p99\":%ld,\"max\":%ld},"
+           "\"bytes\":%ld,\"writes\":%ld,\"printer_calls\":%ld}\n",
+           name, parms->row_count, actions,
+           percentile(times, actions, 50),
+           percentile(times, actions, 90),
+           percentile(times, actions, 99),
+           times[actions-1],
+           counters.bytes, counters.writes, counters.printer_calls);
+   fflush(out);
+
+   free(times);
+}
+
+/** @brief Row changes made between frames to compare redraw methods */
+#define UPDATE_CHANGES 500
+
+/** @brief Frames of changes in each redraw scenario */
+#define UPDATE_FRAMES 200
+
+/**
+ * @brief Redraw rows as they change, as a live feed would.
+ * @param "use_dirty"  *true* to mark rows and redraw them once per
+ *                     frame, *false* to redraw each row as it changes
+ *
+ * Each frame changes #UPDATE_CHANGES rows spread over the page and
+ * the rows below it, so some changes repeat a row, and some are out
+ * of view.
+ */
+static void run_updates(const char *name, DPARMS *parms, bool use_dirty, FILE *out)
+{
+   long *times = (long*)malloc(sizeof(long) * UPDATE_FRAMES);
+   memset(&counters, 0, sizeof(counters));
+
+   unsigned int seed = 12345;
+   int span = parms->line_count * 2;
+
+   for (int frame = 0; frame < UPDATE_FRAMES; ++frame)
+   {
+      struct timespec start, end;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+
+      for (int change = 0; change < UPDATE_CHANGES; ++change)
+      {
+         seed = seed * 1103515245u + 12345u;
+         int row = parms->index_row_top + (int)((seed >> 8) % span);
+         if (use_dirty)
+            pager_invalidate_rows(parms, row, row);
+         else
+            pager_plot_row(parms, row);
+      }
+
+      if (use_dirty)
+         pager_plot_dirty(parms);
+
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      times[frame] = elapsed_ns(&start, &end);
+   }
+
+   qsort(times, UPDATE_FRAMES, sizeof(long), compare_long);
+
+   fprintf(out,
+           "{\"scenario\":\"%s\",\"frames\":%d,\"changes_per_frame\":%d,"
+           "\"latency_ns\":{\"p50\":%ld,\"p90\":%ld,\"max\":%ld},"
+           "\"bytes\":%ld,\"writes\":%ld,\"printer_calls\":%ld}\n",
+           name, UPDATE_FRAMES, UPDATE_CHANGES,
+           percentile(times, UPDATE_FRAMES, 50),
+           percentile(times, UPDATE_FRAMES, 90),
+           times[UPDATE_FRAMES-1],
+           counters.bytes, counters.writes, counters.printer_calls);
+   fflush(out);
+
+   free(times);
+}
+
+/** @brief Query typed a character at a time in the filter scenarios */
+#define FILTER_QUERY "99entrywide"
+
+static const char *counted_text(void *data_source, int row_index, int *len)
+{
+   const PSTRING *string = &((const PSTRING*)data_source)[row_index];
+   *len = string->len;
+   return string->text;
+}
+
+/**
+ * @brief Type a query into a fuzzy filter and show the best matches.
+ * @param "narrow"  *false* to clear the query before each keystroke,
+ *                  so every row is scored each time
+ *
+ * Each keystroke is timed until every row is scored and the page of
+ * the best matches is drawn.
+ */
+static void run_filter(const char *name, DPARMS *parms, PFILTER *filter, bool narrow, FILE *out)
+{
+   int count = (int)strlen(FILTER_QUERY);
+   long *times = (long*)malloc(sizeof(long) * count);
+   char query[sizeof(FILTER_QUERY)];
+   memset(&counters, 0, sizeof(counters));
+
+   for (int i = 0; i < count; ++i)
+   {
+      memcpy(query, FILTER_QUERY, i + 1);
+      query[i + 1] = '\0';
+
+      if (!narrow)
+         pager_filter_set_query(filter, "");
+
+      struct timespec start, end;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+
+      pager_filter_set_query(filter, query);
+      bool finished = false;
+      while (parms->row_count = pager_filter_count(filter, &finished), !finished)
+         sched_yield();
+
+      parms->index_row_top = parms->index_row_focus = 0;
+      pager_plot(parms);
+
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      times[i] = elapsed_ns(&start, &end);
+   }
+
+   qsort(times, count, sizeof(long), compare_long);
+
+   fprintf(out,
+           "{\"scenario\":\"%s\",\"keystrokes\":%d,\"matches\":%d,"
+           "\"latency_ns\":{\"p50\":%ld,\"p90\":%ld,\"max\":%ld},"
+           "\"bytes\":%ld,\"writes\":%ld}\n",
+           name, count, parms->row_count,
+           percentile(times, count, 50),
+           percentile(times, count, 90),
+           times[count-1],
+           counters.bytes, counters.writes);
+   fflush(out);
+
+   free(times);
+}
+
+/** @brief Nodes in the tree scenario */
+#define TREE_NODES 1000000
+
+/** @brief Descendants of each top-level node of the tree */
+#define TREE_BRANCH 1000
+
+/** @brief Collapses or expansions timed in the tree scenario */
+#define TREE_TOGGLES 1000
+
+static int tree_node_printer(int row_index,
+                             int indicated,
+                             int length,
+                             void *data_source,
+                             void *data_extra)
+{
+   ++counters.printer_calls;
+
+   char buff[32];
+   PSPAN span = { buff, snprintf(buff, sizeof(buff), "node %d", row_index), { 0, 0, 0 } };
+   return pager_write_spans(&span, 1, length, indicated);
+}
+
+/**
+ * @brief Collapse and expand top-level nodes of a large tree.
+ *
+ * Each toggle of a node hides or shows #TREE_BRANCH - 1 rows, and
+ * is timed until the page is redrawn.
+ */
+static void run_tree(const char *name, DPARMS *parms, PTREE *tree, FILE *out)
+{
+   long *times = (long*)malloc(sizeof(long) * TREE_TOGGLES);
+   memset(&counters, 0, sizeof(counters));
+
+   unsigned int seed = 12345;
+
+   for (int toggle = 0; toggle < TREE_TOGGLES; ++toggle)
+   {
+      seed = seed * 1103515245u + 12345u;
+      int node = (int)((seed >> 8) % (TREE_NODES / TREE_BRANCH)) * TREE_BRANCH;
+      int row = pager_tree_row(tree, node);
+
+      struct timespec start, end;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+
+      parms->index_row_top = parms->index_row_focus = row;
+      pager_tree_toggle(parms);
+      pager_plot(parms);
+
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      times[toggle] = elapsed_ns(&start, &end);
+   }
+
+   qsort(times, TREE_TOGGLES, sizeof(long), compare_long);
+
+   fprintf(out,
+           "{\"scenario\":\"%s\",\"nodes\":%d,\"toggles\":%d,"
+           "\"latency_ns\":{\"p50\":%ld,\"p90\":%ld,\"max\":%ld},"
+           "\"rows\":%d,\"bytes\":%ld,\"writes\":%ld}\n",
+           name, TREE_NODES, TREE_TOGGLES,
+           percentile(times, TREE_TOGGLES, 50),
+           percentile(times, TREE_TOGGLES, 90),
+           times[TREE_TOGGLES-1],
+           parms->row_count, counters.bytes, counters.writes);
+   fflush(out);
+
+   free(times);
+}
+
+/** @brief Lines piped in to compare line stores */
+#define INGEST_LINES 5000000
+
+/** @brief Piped input and where it's written */
+typedef struct bench_pipe {
+   int fd;
+   const char *text;
+   size_t len;
+} BPIPE;
+
+static void *write_pipe(void *arg)
+{
+   BPIPE *bpipe = (BPIPE*)arg;
+   const char *ptr = bpipe->text;
+   const char *end = ptr + bpipe->len;
+   while (ptr < end)
+   {
+      ssize_t len = __real_write(bpipe->fd, ptr, end - ptr);
+      if (len <= 0)
+         break;
+      ptr += len;
+   }
+   close(bpipe->fd);
+   return NULL;
+}
+
+/** @brief Node and pointer array of a list-per-line store, like linelist */
+typedef struct bench_node {
+   struct bench_node *next;
+   char *line;
+} BNODE;
+
+/**
+ * @brief Read lines into a node and string each, then index them
+ *        with a pointer array, as test_main did with linelist.
+ */
+static int read_node_lines(int fd, BNODE **head, char ***index)
+{
+   char buff[65536];
+   char *partial = NULL;
+   size_t partial_len = 0;
+   BNODE **tail = head;
+   int count = 0;
+   ssize_t len;
+
+   while ((len = read(fd, buff, sizeof(buff))) > 0)
+   {
+      char *ptr = buff, *end = buff + len;
+      while (ptr < end)
+      {
+         char *newline = memchr(ptr, '\n', end - ptr);
+         size_t piece = (newline ? newline : end) - ptr;
+
+         partial = (char*)realloc(partial, partial_len + piece + 1);
+         memcpy(partial + partial_len, ptr, piece);
+         partial_len += piece;
+
+         if (newline == NULL)
+            break;
+
+         BNODE *node = (BNODE*)malloc(sizeof(BNODE));
+         partial[partial_len] = '\0';
+         node->line = strdup(partial);
+         node->next = NULL;
+         *tail = node;
+         tail = &node->next;
+         ++count;
+         partial_len = 0;
+         ptr = newline + 1;
+      }
+   }
+   free(partial);
+
+   *index = (char**)malloc(sizeof(char*) * count);
+   BNODE *node = *head;
+   for (int i = 0; i < count; ++i, node = node->next)
+      (*index)[i] = node->line;
+
+   return count;
+}
+
+static void free_node_lines(BNODE *head, char **index)
+{
+   while (head)
+   {
+      BNODE *next = head->next;
+      free(head->line);
+      free(head);
+      head = next;
+   }
+   free(index);
+}
+
+/**
+ * @brief Pipe generated text into a line store and report the
+ *        throughput and heap used per row.
+ */
+static void run_ingest(const char *name, const char *text, size_t len, bool use_store, FILE *out)
+{
+   int fds[2];
+   if (pipe(fds))
+      return;
+
+   BPIPE bpipe = { fds[1], text, len };
+   pthread_t writer;
+   pthread_create(&writer, NULL, write_pipe, &bpipe);
+
+   size_t heap_before = mallinfo2().uordblks;
+   struct timespec start, end;
+   clock_gettime(CLOCK_MONOTONIC, &start);
+
+   PLINES *store = NULL;
+   BNODE *head = NULL;
+   char **index = NULL;
+   int rows;
+
+   if (use_store)
+   {
+      store = pager_lines_create();
+      pager_lines_read_fd(store, fds[0]);
+      rows = pager_lines_count(store);
+   }
+   else
+      rows = read_node_lines(fds[0], &head, &index);
+
+   clock_gettime(CLOCK_MONOTONIC, &end);
+   size_t heap = mallinfo2().uordblks - heap_before;
+
+   pthread_join(writer, NULL);
+   close(fds[0]);
+
+   double seconds = elapsed_ns(&start, &end) / 1e9;
+   fprintf(out,
+           "{\"scenario\":\"%s\",\"rows\":%d,\"mb_per_s\":%.1f,"
+           "\"heap_bytes_per_row\":%.1f,\"text_bytes_per_row\":%.1f}\n",
+           name, rows, len / seconds / 1e6,
+           (double)heap / rows, (double)len / rows);
+   fflush(out);
+
+   if (store)
+      pager_lines_destroy(store);
+   else
+      free_node_lines(head, index);
+}
+
+int main(int argc, const char **argv)
+{
+   int fds[2];
+   struct winsize ws = { 50, 132, 0, 0 };
+   if (openpty(&fds[0], &fds[1], NULL, NULL, &ws))
+   {
+      perror("openpty");
+      return 1;
+   }
+
+   // Keystrokes should arrive unprocessed, as in an interactive pager:
+   struct termios tios;
+   tcgetattr(fds[1], &tios);
+   cfmakeraw(&tios);
+   tcsetattr(fds[1], TCSANOW, &tios);
+
+   // Report to the original stdout, render to the pty:
+   FILE *out = fdopen(dup(STDOUT_FILENO), "w");
+   dup2(fds[1], STDOUT_FILENO);
+
+   pthread_t drainer;
+   pthread_create(&drainer, NULL, drain_master, &fds[0]);
+
+   // Use a compiled-in terminal profile to avoid terminfo dependence:
+   setenv("TERM", "xterm-256color", 1);
+   pager_init();
+
+   DPARMS parms;
+   pager_init_dparms(&parms, NULL, 1000000, bench_printer, NULL);
+   pager_plot(&parms);
+
+   const char *page_down[] = { "\x1b[6~", NULL };
+   const char *page_up[] = { "\x1b[5~", NULL };
+   const char *arrow_down[] = { "\x1b[B", NULL };
+   const char *arrow_up[] = { "\x1b[A", NULL };
+   const char *end_home[] = { "\x1b[F", "\x1b[H", NULL };
+
+   run_scenario("page_down_1M", &parms, fds, page_down, 0, out);
+   run_scenario("page_up_1M", &parms, fds, page_up, 0, out);
+   run_scenario("arrow_down_burst", &parms, fds, arrow_down, 5000, out);
+   run_scenario("arrow_up_burst", &parms, fds, arrow_up, 5000, out);
+   run_scenario("jump_end_home", &parms, fds, end_home, 1000, out);
+
+   // Compare to page_down_1M for the cost of tracing:
+   pager_trace_start(0, NULL);
+   pager_focus_home(&parms);
+   run_scenario("traced_page_down_1M", &parms, fds, page_down, 0, out);
+   pager_trace_stop();
+
+   run_updates("plot_row_updates", &parms, false, out);
+   run_updates("dirty_row_updates", &parms, true, out);
+
+   // Compare printers writing their own escape sequences to spans:
+   pager_init_dparms(&parms, NULL, 1000000, styled_raw_printer, NULL);
+   pager_plot(&parms);
+   run_scenario("styled_raw_page_down", &parms, fds, page_down, 2000, out);
+   run_scenario("styled_raw_arrow_down", &parms, fds, arrow_down, 5000, out);
+
+   pager_init_dparms(&parms, NULL, 1000000, styled_span_printer, NULL);
+   pager_plot(&parms);
+   run_scenario("styled_span_page_down", &parms, fds, page_down, 2000, out);
+   run_scenario("styled_span_arrow_down", &parms, fds, arrow_down, 5000, out);
+
+   // Compare drawing the pages of a slow printer to drawing them ahead,
+   // pausing between keystrokes as a reader does:
+   idle_us = 5000;
+   pager_init_dparms(&parms, NULL, 1000000, slow_printer, NULL);
+   pager_plot(&parms);
+   run_scenario("slow_page_down", &parms, fds, page_down, 200, out);
+
+   // Compare a query for each row to one for each page:
+   PFETCHOPS slow_ops = { slow_get_rows, NULL, slow_row_count, NULL, slow_print_row };
+   PFETCH *fetch = pager_fetch_create(&slow_ops, NULL, 0);
+   pager_init_fetch(&parms, fetch);
+   pager_plot(&parms);
+   run_scenario("fetch_page_down", &parms, fds, page_down, 200, out);
+   pager_fetch_destroy(fetch);
+
+   pager_init_dparms(&parms, NULL, 1000000, slow_printer, NULL);
+
+   pager_prerender_start(&parms, 1024 * 1024);
+   pager_plot(&parms);
+   run_scenario("prerender_page_down", &parms, fds, page_down, 200, out);
+   pager_prerender_stop(&parms);
+   idle_us = 0;
+
+   // Compare a printer of string arrays to the library drawing them:
+   char *string_text = (char*)malloc((size_t)STRING_ROWS * 200);
+   const char **strings = (const char**)malloc(sizeof(char*) * STRING_ROWS);
+   PSTRING *counted = (PSTRING*)malloc(sizeof(PSTRING) * STRING_ROWS);
+   char *string_end = string_text;
+   for (int i = 0; i < STRING_ROWS; ++i)
+   {
+      int len = sprintf(string_end, "%06d menu entry %.*s", i, i % 160,
+                        "Some descriptive text of varying length that may be longer "
+                        "than the screen is wide, as menu items and file lists are, "
+                        "repeated to make long lines. Some descriptive text.");
+      strings[i] = string_end;
+      counted[i].text = string_end;
+      counted[i].len = len;
+      string_end += len + 1;
+   }
+
+   pager_init_dparms(&parms, strings, STRING_ROWS, string_callback_printer, NULL);
+   pager_plot(&parms);
+   run_scenario("string_callback_page_down", &parms, fds, page_down, 0, out);
+
+   pager_init_strings(&parms, strings, STRING_ROWS);
+   pager_plot(&parms);
+   run_scenario("string_array_page_down", &parms, fds, page_down, 0, out);
+
+   pager_init_counted(&parms, counted, STRING_ROWS);
+   pager_plot(&parms);
+   run_scenario("counted_array_page_down", &parms, fds, page_down, 0, out);
+
+   // Compare scoring every row on each keystroke to narrowing the matches:
+   PFILTER *filter = pager_filter_create(counted_text, counted, STRING_ROWS, 0);
+   pager_init_dparms(&parms, filter, 0, pager_filter_printer, NULL);
+   run_filter("filter_rescan_typing", &parms, filter, false, out);
+   run_filter("filter_narrow_typing", &parms, filter, true, out);
+   pager_filter_destroy(filter);
+
+   free(counted);
+   free(strings);
+   free(string_text);
+
+   // Compare whole-line formatting of a wide table to the table engine:
+   table_longs = (long*)malloc(sizeof(long) * TABLE_ROWS);
+   table_doubles = (double*)malloc(sizeof(double) * TABLE_ROWS);
+   for (int i = 0; i < TABLE_ROWS; ++i)
+   {
+      table_longs[i] = (long)i * 7919;
+      table_doubles[i] = i / 3.0;
+   }
+
+   PCOLUMN columns[TABLE_COLUMNS];
+   memset(columns, 0, sizeof(columns));
+   for (int col = 0; col < TABLE_COLUMNS; ++col)
+   {
+      columns[col].type = col % 2 ? PCOL_DOUBLE : PCOL_LONG;
+      columns[col].values = col % 2 ? (const void*)table_doubles : (const void*)table_longs;
+      columns[col].precision = 2;
+      columns[col].align_right = true;
+   }
+   PTABLE *table = pager_table_create(columns, TABLE_COLUMNS, TABLE_ROWS);
+
+   pager_init_dparms(&parms, NULL, TABLE_ROWS, wide_line_printer, NULL);
+   pager_plot(&parms);
+   run_scenario("wide_line_page_down", &parms, fds, page_down, 0, out);
+   run_scenario("wide_line_arrow_up", &parms, fds, arrow_up, 5000, out);
+
+   pager_init_dparms(&parms, table, TABLE_ROWS, pager_table_printer, NULL);
+   pager_plot(&parms);
+   run_scenario("table_page_down", &parms, fds, page_down, 0, out);
+   run_scenario("table_arrow_up", &parms, fds, arrow_up, 5000, out);
+
+   pager_table_destroy(table);
+   free(table_doubles);
+   free(table_longs);
+
+   // Collapse and expand subtrees of a million-node tree:
+   int *depths = (int*)malloc(sizeof(int) * TREE_NODES);
+   for (int i = 0; i < TREE_NODES; ++i)
+      depths[i] = i % TREE_BRANCH == 0 ? 0 : 1 + (i % 10 != 1);
+
+   PTREE *tree = pager_tree_create(depths, TREE_NODES, true, tree_node_printer, NULL);
+   pager_init_dparms(&parms, tree, pager_tree_row_count(tree), pager_tree_printer, NULL);
+   run_tree("tree_toggle", &parms, tree, out);
+   pager_tree_destroy(tree);
+   free(depths);
+
+   // Compare storing piped lines in a line store to a node per line:
+   size_t text_len = 0;
+   char *text = (char*)malloc((size_t)INGEST_LINES * 64);
+   for (int i = 0; i < INGEST_LINES; ++i)
+      text_len += sprintf(text + text_len, "%08d some piped log text %.*s\n",
+                          i, i % 32, "abcdefghijklmnopqrstuvwxyz012345");
+
+   run_ingest("node_per_line_ingest", text, text_len, false, out);
+   run_ingest("line_store_ingest", text, text_len, true, out);
+   free(text);
+
+   pager_cleanup();
+
+   fclose(out);
+   return 0;
+}
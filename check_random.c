@@ -0,0 +1,560 @@
+/**
+ * @file check_random.c
+ * @brief Randomized checks of the library's data structures, run
+ *        with `make check`.
+ *
+ * Each check applies random changes to a structure and compares
+ * every answer it gives with a brute-force model kept alongside:
+ *
+ * - collapsible trees against a flattening of the visible nodes,
+ * - selections against an array of flags,
+ * - line stores against the lines split from the text added,
+ * - compressed text files against the text that was compressed,
+ *   reading rows in random order across checkpoints, with and
+ *   without the checkpoints cached.
+ *
+ * No terminal is needed.  Runs are repeatable, and another seed
+ * can be given as the only argument.  The exit status is 0 if every
+ * check passed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>       // getpid(), unlink(), rmdir()
+#include <dirent.h>
+#include <zlib.h>
+
+#include "pager.h"
+
+static unsigned long long rand_state;
+static int failures;
+
+/**
+ * @brief Next pseudo-random number (xorshift64*), repeatable for a seed.
+ */
+static unsigned long rand_next(void)
+{
+   rand_state ^= rand_state >> 12;
+   rand_state ^= rand_state << 25;
+   rand_state ^= rand_state >> 27;
+   return (unsigned long)((rand_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+/** @brief Random integer from 0 to @p limit - 1 */
+static int rand_below(int limit)
+{
+   return limit > 0 ? (int)(rand_next() % (unsigned long)limit) : 0;
+}
+
+/**
+ * @brief Report a failed comparison, returning *false* for the
+ *        caller to abandon its trial.
+ */
+static bool check(bool ok, const char *name, int trial, const char *what, int at)
+{
+   if (!ok)
+   {
+      fprintf(stderr, "FAIL %s, trial %d: %s at %d\n", name, trial, what, at);
+      ++failures;
+   }
+   return ok;
+}
+
+/**
+ * @defgroup CHECK_TREE Collapsible trees
+ * @{
+ */
+
+/**
+ * @brief Make random depths of a tree in preorder.
+ */
+static void random_depths(int *depths, int count)
+{
+   for (int i = 0; i < count; ++i)
+   {
+      int most = i ? depths[i - 1] + 1 : 0;
+      // Favour deep trees, with the occasional return to a root:
+      depths[i] = rand_below(8) ? most - rand_below(3) : rand_below(most + 1);
+      if (depths[i] < 0)
+         depths[i] = 0;
+   }
+}
+
+/**
+ * @brief List the visible nodes, skipping the descendants of
+ *        collapsed nodes, and note the row of each node.
+ * @return number of visible nodes
+ */
+static int flatten_tree(const int *depths, const bool *collapsed, int count,
+                        int *visible, int *rows)
+{
+   int shown = 0;
+   for (int node = 0; node < count; )
+   {
+      rows[node] = shown;
+      visible[shown++] = node;
+
+      int next = node + 1;
+      if (collapsed[node])
+         for (; next < count && depths[next] > depths[node]; ++next)
+            rows[next] = -1;
+      node = next;
+   }
+   return shown;
+}
+
+/**
+ * @brief Compare every answer of a tree with its flattening.
+ */
+static bool compare_tree(const PTREE *tree, const int *depths, const bool *collapsed,
+                         int count, int *visible, int *rows, int trial)
+{
+   static const char *name = "tree";
+   int shown = flatten_tree(depths, collapsed, count, visible, rows);
+
+   if (!check(pager_tree_row_count(tree) == shown, name, trial, "row count", shown))
+      return false;
+
+   for (int row = 0; row < shown; ++row)
+      if (!check(pager_tree_node(tree, row) == visible[row], name, trial, "node of row", row))
+         return false;
+
+   if (!check(pager_tree_node(tree, shown) == -1, name, trial, "node past the end", shown))
+      return false;
+
+   for (int node = 0; node < count; ++node)
+   {
+      bool children = node + 1 < count && depths[node + 1] > depths[node];
+      if (!check(pager_tree_row(tree, node) == rows[node], name, trial, "row of node", node)
+          || !check(pager_tree_has_children(tree, node) == children,
+                    name, trial, "has children", node)
+          || !check(pager_tree_is_expanded(tree, node) == !collapsed[node],
+                    name, trial, "expanded", node))
+         return false;
+
+      int parent = node - 1;
+      while (parent >= 0 && depths[parent] >= depths[node])
+         --parent;
+      if (!check(pager_tree_parent(tree, node) == parent, name, trial, "parent", node))
+         return false;
+   }
+
+   return true;
+}
+
+static void check_tree(int trials)
+{
+   for (int trial = 0; trial < trials; ++trial)
+   {
+      int count = 1 + rand_below(trial % 4 ? 64 : 2000);
+      int *depths = (int*)malloc(sizeof(int) * count);
+      int *visible = (int*)malloc(sizeof(int) * count);
+      int *rows = (int*)malloc(sizeof(int) * count);
+      bool *collapsed = (bool*)calloc(count, sizeof(bool));
+
+      random_depths(depths, count);
+
+      // Nodes without children are never collapsed:
+      bool expanded = rand_below(2);
+      for (int node = 0; node + 1 < count; ++node)
+         collapsed[node] = !expanded && depths[node + 1] > depths[node];
+
+      PTREE *tree = pager_tree_create(depths, count, expanded, NULL, NULL);
+      bool ok = compare_tree(tree, depths, collapsed, count, visible, rows, trial);
+
+      for (int toggle = 0; ok && toggle < 50; ++toggle)
+      {
+         int node = rand_below(count);
+         bool collapse = !collapsed[node];
+         pager_tree_set_expanded(tree, node, !collapse);
+         if (node + 1 < count && depths[node + 1] > depths[node])
+            collapsed[node] = collapse;
+         ok = compare_tree(tree, depths, collapsed, count, visible, rows, trial);
+      }
+
+      pager_tree_destroy(tree);
+      free(depths);
+      free(visible);
+      free(rows);
+      free(collapsed);
+   }
+
+   printf("tree: %d trials\n", trials);
+}
+
+/** @} */
+
+/**
+ * @defgroup CHECK_SELECTION Selections
+ * @{
+ */
+
+/** @brief Rows covered by selection checks, spanning several containers */
+#define SELECTION_ROWS (5 * 65536 + 1234)
+
+typedef struct match_data {
+   int modulus;
+} MDATA;
+
+static bool match_multiple(int row_index, void *data)
+{
+   return row_index % ((MDATA*)data)->modulus == 0;
+}
+
+/**
+ * @brief Compare a selection with its flags, by counting and by
+ *        walking the selected rows.
+ */
+static bool compare_selection(const PSELECTION *sel, const bool *flags, int trial)
+{
+   static const char *name = "selection";
+   long count = 0;
+   int row = pager_selection_next(sel, -1);
+
+   for (int index = 0; index < SELECTION_ROWS; ++index)
+   {
+      if (!flags[index])
+         continue;
+
+      ++count;
+      if (!check(row == index, name, trial, "next selected row", index))
+         return false;
+      row = pager_selection_next(sel, row);
+   }
+
+   if (!check(row == -1, name, trial, "row past the last", row)
+       || !check(pager_selection_count(sel) == count, name, trial, "count", (int)count))
+      return false;
+
+   // Spot checks cover the containers' own lookups:
+   for (int probe = 0; probe < 2000; ++probe)
+   {
+      int index = rand_below(SELECTION_ROWS);
+      if (!check(pager_selection_has(sel, index) == flags[index], name, trial, "has", index))
+         return false;
+   }
+
+   return true;
+}
+
+static void check_selection(int trials)
+{
+   bool *flags = (bool*)malloc(SELECTION_ROWS);
+
+   for (int trial = 0; trial < trials; ++trial)
+   {
+      PSELECTION *sel = pager_selection_create();
+      memset(flags, 0, SELECTION_ROWS);
+
+      bool ok = true;
+      for (int change = 0; ok && change < 40; ++change)
+      {
+         int kind = rand_below(10);
+         int first = rand_below(SELECTION_ROWS);
+
+         // Lengths from single rows to several containers make the
+         // containers change between arrays, bitmaps and full:
+         static const int spans[] = { 1, 16, 3000, 5000, 70000, 200000 };
+         int last = first + rand_below(spans[rand_below(6)]);
+         if (last >= SELECTION_ROWS)
+            last = SELECTION_ROWS - 1;
+
+         if (kind < 6)
+         {
+            bool selected = kind < 4;
+            pager_selection_set_range(sel, first, last, selected);
+            memset(&flags[first], selected, last - first + 1);
+         }
+         else if (kind < 8)
+         {
+            for (int row = first; row <= last && row < first + 300; ++row)
+            {
+               pager_selection_toggle(sel, row);
+               flags[row] = !flags[row];
+            }
+         }
+         else if (kind < 9)
+         {
+            MDATA data = { 1 + rand_below(5) };
+            pager_selection_add_matching(sel, first, last, match_multiple, &data);
+            for (int row = first; row <= last; ++row)
+               if (match_multiple(row, &data))
+                  flags[row] = true;
+         }
+         else
+         {
+            pager_selection_clear(sel);
+            memset(flags, 0, SELECTION_ROWS);
+         }
+
+         ok = compare_selection(sel, flags, trial);
+      }
+
+      pager_selection_destroy(sel);
+   }
+
+   free(flags);
+   printf("selection: %d trials\n", trials);
+}
+
+/** @} */
+
+/**
+ * @defgroup CHECK_TEXT Line stores and compressed text
+ * @{
+ */
+
+/**
+ * @brief Make random text of lines of random lengths.
+ * @param "len"        [out] length of the text
+ * @param "line_count" [out] number of lines, counting a last line
+ *                     without a newline
+ * @param "long_lines" *true* to include lines longer than a chunk
+ *                     of a line store
+ */
+static char *random_text(size_t *len, int *line_count, bool long_lines)
+{
+   int lines = 1 + rand_below(20000);
+   size_t size = 0, used = 0;
+   char *text = NULL;
+
+   for (int line = 0; line < lines; ++line)
+   {
+      int kind = rand_below(1000);
+      size_t line_len = kind == 0 && long_lines ? 1024 * 1024 + rand_below(100000)
+         : kind < 100 ? 0
+         : (size_t)rand_below(kind < 900 ? 80 : 2000);
+
+      if (used + line_len + 1 > size)
+      {
+         size = (used + line_len + 1) * 2;
+         text = (char*)realloc(text, size);
+      }
+
+      for (size_t i = 0; i < line_len; ++i)
+         text[used++] = (char)(' ' + rand_below(95));
+      text[used++] = '\n';
+   }
+
+   // Sometimes leave the last line without its newline:
+   if (rand_below(2) && used > 1 && text[used - 2] != '\n')
+      --used;
+
+   *len = used;
+   *line_count = lines;
+   return text;
+}
+
+/**
+ * @brief Find the start of each line of text.
+ * @return offsets, with one more past the end of the last line
+ */
+static size_t *split_lines(const char *text, size_t len, int line_count)
+{
+   size_t *starts = (size_t*)malloc(sizeof(size_t) * (line_count + 1));
+   int line = 0;
+   starts[line++] = 0;
+   for (size_t i = 0; i < len && line < line_count; ++i)
+      if (text[i] == '\n')
+         starts[line++] = i + 1;
+
+   // As if the last line ended with a newline:
+   starts[line_count] = len && text[len - 1] == '\n' ? len : len + 1;
+   return starts;
+}
+
+/** @brief Length of a line, without its newline */
+static int line_length(const size_t *starts, size_t len, int line)
+{
+   size_t end = starts[line + 1] - 1;
+   if (end > len)
+      end = len;
+   return (int)(end - starts[line]);
+}
+
+static void check_lines(int trials)
+{
+   static const char *name = "lines";
+
+   for (int trial = 0; trial < trials; ++trial)
+   {
+      size_t len;
+      int line_count;
+      char *text = random_text(&len, &line_count, true);
+      size_t *starts = split_lines(text, len, line_count);
+
+      // Add the text in pieces that split lines anywhere:
+      PLINES *store = pager_lines_create();
+      for (size_t at = 0; at < len; )
+      {
+         size_t piece = 1 + rand_below(rand_below(2) ? 16 : 200000);
+         if (piece > len - at)
+            piece = len - at;
+         pager_lines_append(store, text + at, piece);
+         at += piece;
+      }
+      pager_lines_finish(store);
+
+      if (check(pager_lines_count(store) == line_count, name, trial, "line count", line_count))
+      {
+         for (int line = 0; line < line_count; ++line)
+         {
+            int got_len = -1;
+            const char *got = pager_lines_get(store, line, &got_len);
+            int want_len = line_length(starts, len, line);
+            if (!check(got && got_len == want_len
+                       && memcmp(got, text + starts[line], want_len) == 0,
+                       name, trial, "line text", line))
+               break;
+         }
+      }
+
+      pager_lines_destroy(store);
+      free(starts);
+      free(text);
+   }
+
+   printf("lines: %d trials\n", trials);
+}
+
+/**
+ * @brief Compress text to a file, in gzip or zlib format.
+ */
+static bool write_compressed(const char *path, const char *text, size_t len, bool gzip)
+{
+   z_stream strm;
+   memset(&strm, 0, sizeof(strm));
+   if (deflateInit2(&strm, 1 + rand_below(9), Z_DEFLATED, gzip ? 31 : 15,
+                    8, Z_DEFAULT_STRATEGY) != Z_OK)
+      return false;
+
+   size_t size = deflateBound(&strm, len);
+   unsigned char *out = (unsigned char*)malloc(size);
+
+   strm.next_in = (unsigned char*)text;
+   strm.avail_in = (uInt)len;
+   strm.next_out = out;
+   strm.avail_out = (uInt)size;
+   bool ok = deflate(&strm, Z_FINISH) == Z_STREAM_END;
+   deflateEnd(&strm);
+
+   FILE *f = fopen(path, "wb");
+   ok = ok && f && fwrite(out, 1, strm.total_out, f) == strm.total_out;
+   if (f && fclose(f))
+      ok = false;
+
+   free(out);
+   return ok;
+}
+
+/**
+ * @brief Read the lines of a compressed file in random order.
+ */
+static bool compare_gzip(PGZIP *gz, const char *text, size_t len,
+                         const size_t *starts, int line_count, int trial)
+{
+   static const char *name = "gzip";
+
+   if (!check(pager_gzip_row_count(gz) == line_count, name, trial, "line count", line_count))
+      return false;
+
+   int line = 0;
+   for (int probe = 0; probe < 600; ++probe)
+   {
+      // Mostly jumps, with runs of neighbours within blocks:
+      line = rand_below(4) ? rand_below(line_count) : (line + 1) % line_count;
+
+      int got_len = -1;
+      const char *got = pager_gzip_line(gz, line, &got_len);
+      int want_len = line_length(starts, len, line);
+      if (!check(got && got_len == want_len
+                 && memcmp(got, text + starts[line], want_len) == 0,
+                 name, trial, "line text", line))
+         return false;
+   }
+
+   return true;
+}
+
+static void check_gzip(int trials)
+{
+   char dir[64], path[128];
+   snprintf(dir, sizeof(dir), "/tmp/check_random.%d", (int)getpid());
+   snprintf(path, sizeof(path), "%s.gz", dir);
+
+   for (int trial = 0; trial < trials; ++trial)
+   {
+      size_t len;
+      int line_count;
+      char *text = random_text(&len, &line_count, false);
+      size_t *starts = split_lines(text, len, line_count);
+
+      // Small spacings make many checkpoints, at random bit offsets:
+      long spacing = 4096 + rand_below(65536);
+      bool cached = trial % 2;
+
+      pager_set_cache_dir(cached ? dir : NULL);
+
+      if (!check(write_compressed(path, text, len, rand_below(4) != 0),
+                 "gzip", trial, "compressing", 0))
+         break;
+
+      // A second open of a cached file maps the saved checkpoints:
+      for (int open = 0; open < (cached ? 2 : 1); ++open)
+      {
+         PGZIP *gz = pager_gzip_open(path, spacing);
+         if (!check(gz != NULL, "gzip", trial, "open", open))
+            break;
+
+         bool ok = compare_gzip(gz, text, len, starts, line_count, trial);
+         pager_gzip_close(gz);
+         if (!ok)
+            break;
+      }
+
+      unlink(path);
+      free(starts);
+      free(text);
+   }
+
+   pager_set_cache_dir(NULL);
+
+   // Remove the cached indexes with the directory:
+   DIR *cache = opendir(dir);
+   if (cache)
+   {
+      char file[sizeof(dir) + 256];
+      struct dirent *entry;
+      while ((entry = readdir(cache)))
+      {
+         if (entry->d_name[0] == '.')
+            continue;
+         snprintf(file, sizeof(file), "%s/%s", dir, entry->d_name);
+         unlink(file);
+      }
+      closedir(cache);
+      rmdir(dir);
+   }
+
+   printf("gzip: %d trials\n", trials);
+}
+
+/** @} */
+
+int main(int argc, const char **argv)
+{
+   unsigned long long seed = argc > 1 ? strtoull(argv[1], NULL, 0) : 1;
+   rand_state = seed ? seed : 1;
+   printf("seed %llu\n", seed);
+
+   check_tree(400);
+   check_selection(60);
+   check_lines(40);
+   check_gzip(30);
+
+   if (failures)
+      printf("%d checks failed\n", failures);
+
+   return failures ? 1 : 0;
+}
@@ -2,6 +2,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <assert.h>
+#include <time.h>    // for clock_gettime
 
 #include <curses.h>  // for tigetstr, tiparm
 #include <term.h>
@@ -9,6 +10,7 @@
 #include "export.h"
 #include "termstuff.h"
 #include "pager.h"
+#include "pager_private.h"
 
 bool pager_init_flag = false;
 
@@ -17,6 +19,7 @@ EXPORT void pager_init(void)
    if (!pager_init_flag)
    {
       ti_start_term();
+      ptrace_init();
       pager_init_flag = true;
    }
 }
@@ -26,12 +29,197 @@ EXPORT void pager_cleanup(void)
    if (pager_init_flag)
    {
       ti_cleanup_term();
+      ptrace_cleanup();
       pager_init_flag = false;
    }
 }
 
+/**
+ * @brief Make the terminal and statistics of @p parms current.
+ *
+ * Call this at the start of any public function that writes to
+ * the terminal on behalf of a @ref DPARMS.
+ */
+void pager_select(const DPARMS *parms)
+{
+   ti_select_term(parms->term, parms->stats);
+}
+
+/**
+ * @brief Call the printer of @p parms, timing it if collecting statistics.
+ */
+static int call_printer(const DPARMS *parms, int row_index, bool has_focus)
+{
+   int indicated = has_focus ? PAGER_INDICATED_FOCUS : 0;
+   if (parms->selection && pager_selection_has(parms->selection, row_index))
+      indicated |= PAGER_INDICATED_SELECTED;
+
+   // Built-in sources are drawn without a printer:
+   if (parms->source != PAGER_SOURCE_PRINTER)
+      return pager_write_builtin(parms, row_index, indicated);
+
+#ifdef PAGER_STATS
+   PSTATS *stats = parms->stats;
+   if (stats)
+   {
+      struct timespec start, end;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      int result = (*parms->printer)(row_index,
+                                     indicated,
+                                     parms->chars_count,
+                                     parms->data_source,
+                                     parms->data_extra);
+      clock_gettime(CLOCK_MONOTONIC, &end);
+
+      unsigned long ns = (end.tv_sec - start.tv_sec) * 1000000000UL
+         + end.tv_nsec - start.tv_nsec;
+      PSTAT_INC(stats, printer_calls);
+      PSTAT_ADD(stats, printer_ns_total, ns);
+      PSTAT_MAX(stats, printer_ns_max, ns);
+      return result;
+   }
+#endif
+
+   return (*parms->printer)(row_index,
+                            indicated,
+                            parms->chars_count,
+                            parms->data_source,
+                            parms->data_extra);
+}
+
+/**
+ * @brief Call the printer of @p parms, timing it if collecting
+ *        statistics and tracing it if tracing.
+ * @param "parms"     Active pager control data
+ * @param "row_index" index in data source for row to be printed
+ * @param "has_focus" flag to trigger printing line in standout mode
+ * @return the value returned by the printer
+ *
+ * The printer is told if the row has the focus or is selected,
+ * see @ref pager_indicated_flags.
+ */
+int pager_call_printer(const DPARMS *parms, int row_index, bool has_focus)
+{
+   PTRACE_BEGIN(trace);
+   int result = call_printer(parms, row_index, has_focus);
+   PTRACE_END(trace, "printer", "row", row_index);
+   return result;
+}
+
+/**
+ * @brief Add the highlighting of an indicated row to a style.
+ * @param "style"      style to which highlighting is added
+ * @param "indicated"  printer argument, see @ref pager_indicated_flags
+ *
+ * The focused row is reversed and selected rows are underlined.
+ */
+void pager_indicated_style(PSTYLE *style, int indicated)
+{
+   if (indicated & PAGER_INDICATED_FOCUS)
+      style->attrs |= PAGER_ATTR_REVERSE;
+   if (indicated & PAGER_INDICATED_SELECTED)
+      style->attrs |= PAGER_ATTR_UNDERLINE;
+}
+
+/**
+ * @brief Write text, writing control characters as spaces so they
+ *        can't disturb the screen.
+ */
+void pager_write_clean(const char *text, int len)
+{
+   const char *end = text + len;
+   const char *run = text;
+   for (const char *ptr = text; ptr < end; ++ptr)
+   {
+      if ((unsigned char)*ptr < ' ')
+      {
+         ti_write(run, ptr - run);
+         ti_write(" ", 1);
+         run = ptr + 1;
+      }
+   }
+   ti_write(run, end - run);
+}
+
+/**
+ * @brief Write a line of text for a stock printer.
+ * @param "text"       text to write, need not be NUL-terminated
+ * @param "len"        length of @p text
+ * @param "length"     most characters to write
+ * @param "indicated"  printer argument
+ * @return number of characters written
+ */
+int pager_print_text(const char *text, int len, int length, int indicated)
+{
+   PSPAN span = { text, len, { 0, 0, 0 } };
+   return pager_write_spans(&span, 1, length, indicated);
+}
+
+/**
+ * @defgroup STYLED_SPANS Styled text for printers
+ * @brief Printers describe a line as runs of styled text, and the
+ *        library writes the fewest style changes.
+ * @{
+ */
+
+/**
+ * @brief Write a line as runs of styled text.
+ * @param "spans"      runs of text, in order
+ * @param "count"      number of elements in @p spans
+ * @param "length"     the @p length argument of the printer
+ * @param "indicated"  the @p indicated argument of the printer
+ * @return @p length, the number of characters filled
+ *
+ * Call this from a printer instead of writing escape sequences.
+ * Only the changes of style from the text written before, even on
+ * an earlier line of the frame, are sent to the terminal.  The
+ * library highlights indicated rows, see @ref pager_indicated_style,
+ * so the printer needn't.  Text beyond @p length is cut off, and
+ * the rest of the line is cleared.  Control characters are written
+ * as spaces.
+ */
+EXPORT int pager_write_spans(const PSPAN *spans, int count, int length, int indicated)
+{
+   int written = 0;
+   for (int i = 0; i < count && written < length; ++i)
+   {
+      int len = spans[i].len;
+      if (len > length - written)
+         len = length - written;
+      if (len <= 0)
+         continue;
+
+      PSTYLE style = spans[i].style;
+      pager_indicated_style(&style, indicated);
+      ti_set_style(&style);
+
+      pager_write_clean(spans[i].text, len);
+      written += len;
+   }
+
+   if (written < length)
+   {
+      // A highlight reaches the edge, other lines are erased to it:
+      PSTYLE style = { 0, 0, 0 };
+      pager_indicated_style(&style, indicated);
+      if (style.attrs)
+      {
+         ti_set_style(&style);
+         ti_printf("%*s", length - written, "");
+      }
+      else
+         ti_erase_chars(length - written);
+   }
+
+   return length;
+}
+
+/** @} */
+
 EXPORT void pager_plot_row(DPARMS *parms, int row_index)
 {
+   pager_select(parms);
+
    // Calculate visible limits
    int first_screen_row = parms->index_row_top;
    int last_screen_row = first_screen_row + parms->line_count-1;
@@ -40,52 +228,250 @@ EXPORT void pager_plot_row(DPARMS *parms, int row_index)
    if (row_index>=first_screen_row && row_index <= last_screen_row)
    {
       int line = parms->line_top + row_index - parms->index_row_top;
+      pager_prepare_rows(parms, row_index, row_index);
+      ti_begin_frame();
       ti_set_cursor_position(line, parms->chars_left);
-      (parms->printer)(row_index,
-                        row_index == parms->index_row_focus,
-                        parms->chars_count,
-                        parms->data_source,
-                        parms->data_extra);
+      pager_call_printer(parms, row_index, row_index == parms->index_row_focus);
+      ti_end_frame();
+   }
+}
+
+
+/**
+ * @brief Mark rows whose content has changed, to be redrawn later.
+ * @param "parms"  pager showing the rows
+ * @param "first"  index of first changed row
+ * @param "last"   index of last changed row
+ *
+ * Nothing is written until @ref pager_plot_dirty, so call this for
+ * every change, then redraw the changed rows in a single write
+ * before reading the next keystroke.  Rows that aren't visible are
+ * ignored, since they will be drawn fresh when they come into view.
+ *
+ * Overlapping and adjacent ranges are merged.  If more than
+ * @ref PAGER_DIRTY_RANGES separate ranges are marked, the new range
+ * is merged with its nearest neighbor, redrawing the rows between.
+ */
+EXPORT void pager_invalidate_rows(DPARMS *parms, int first, int last)
+{
+   // Pages drawn ahead may show the rows even if this page doesn't:
+   pager_prerender_discard(parms, first, last);
+
+   int top = parms->index_row_top;
+   int bottom = top + parms->line_count - 1;
+
+   if (first < top)
+      first = top;
+   if (last > bottom)
+      last = bottom;
+   if (first > last)
+      return;
+
+   PRANGE *ranges = parms->dirty;
+   int count = parms->dirty_count;
+
+   // Skip the ranges ending before the new one, then absorb any it
+   // overlaps or touches:
+   int index = 0;
+   while (index < count && ranges[index].last < first - 1)
+      ++index;
+
+   int end = index;
+   for (; end < count && ranges[end].first <= last + 1; ++end)
+   {
+      if (ranges[end].first < first)
+         first = ranges[end].first;
+      if (ranges[end].last > last)
+         last = ranges[end].last;
    }
+
+   if (end > index)
+   {
+      // Replace the absorbed ranges with the new one:
+      memmove(&ranges[index + 1], &ranges[end], sizeof(PRANGE) * (count - end));
+      count -= end - index - 1;
+   }
+   else if (count < PAGER_DIRTY_RANGES)
+   {
+      memmove(&ranges[index + 1], &ranges[index], sizeof(PRANGE) * (count - index));
+      ++count;
+   }
+   else
+   {
+      // No room for another range, so widen the nearest:
+      if (index == count
+          || (index > 0 && first - ranges[index - 1].last < ranges[index].first - last))
+      {
+         --index;
+         first = ranges[index].first;
+      }
+      else
+         last = ranges[index].last;
+   }
+
+   ranges[index].first = first;
+   ranges[index].last = last;
+   parms->dirty_count = count;
+}
+
+/**
+ * @brief Redraw the rows marked by @ref pager_invalidate_rows.
+ *
+ * The rows are written in a single screen update.  Rows that have
+ * scrolled out of view since they were marked are skipped.
+ */
+EXPORT void pager_plot_dirty(DPARMS *parms)
+{
+   if (parms->dirty_count == 0)
+      return;
+
+   pager_select(parms);
+
+   int top = parms->index_row_top;
+   int bottom = top + parms->line_count - 1;
+   if (bottom >= parms->row_count)
+      bottom = parms->row_count - 1;
+
+   // One request for the rows of every range:
+   int first_dirty = parms->dirty[0].first;
+   int last_dirty = parms->dirty[parms->dirty_count - 1].last;
+   pager_prepare_rows(parms,
+                      first_dirty < top ? top : first_dirty,
+                      last_dirty > bottom ? bottom : last_dirty);
+
+   ti_begin_frame();
+
+   for (int i = 0; i < parms->dirty_count; ++i)
+   {
+      int first = parms->dirty[i].first < top ? top : parms->dirty[i].first;
+      int last = parms->dirty[i].last > bottom ? bottom : parms->dirty[i].last;
+
+      for (int row = first; row <= last; ++row)
+      {
+         ti_set_cursor_position(parms->line_top + row - top, parms->chars_left);
+         pager_call_printer(parms, row, row == parms->index_row_focus);
+      }
+   }
+
+   ti_end_frame();
+
+   parms->dirty_count = 0;
 }
 
+/**
+ * @brief Write every line of the page, without opening a frame.
+ * @param "parms"  pager whose page is written
+ * @param "stop"   if not NULL, writing stops when this becomes nonzero
+ * @return *true* if the whole page was written.
+ */
+bool pager_write_page(const DPARMS *parms, const int *stop)
+{
+   int left = parms->chars_left;
+   int line = parms->line_top;
+   int line_limit = line + parms->line_count;
+   int chars_count = parms->chars_count;
+
+   int row = parms->index_row_top;
+   int end_row = row + parms->line_count;
+   if (end_row >= parms->row_count)
+      end_row = parms->row_count-1;
+
+   pager_prepare_rows(parms, row, row + parms->line_count - 1);
+
+   for (; line < line_limit; ++row, ++line)
+   {
+      if (stop && __atomic_load_n(stop, __ATOMIC_RELAXED))
+         return false;
+
+      ti_set_cursor_position(line, left);
+
+      // Erase the line before requesting a reprint, unless it's
+      // from a built-in source, which always fills the line.
+      if (row > end_row || parms->source == PAGER_SOURCE_PRINTER)
+         ti_erase_chars(chars_count);
+
+      if (row <= end_row)
+         pager_call_printer(parms, row, row == parms->index_row_focus);
+      // allow erased line above to handle output to vacant rows (rows without data)
+   }
+
+   return true;
+}
 
 EXPORT void pager_plot(DPARMS *params)
 {
+   pager_select(params);
+
    // You gotta have called pager_init() before star
    assert(ti_values_initialized());
    // Critical but forgettable setting:
    assert(params->printer);
 
-   int left = params->chars_left;
-   int line = params->line_top;
-   int line_limit = line + params->line_count;
-   int chars_count = params->chars_count;
+   // Fill the page, and a page beyond, from a source of unknown length:
+   pager_extend_rows(params, params->index_row_top + params->line_count * 2);
 
-   int row = params->index_row_top;
-   int end_row = row + params->line_count;
-   if (end_row >= params->row_count)
-      end_row = params->row_count-1;
+   PSTAT_INC(params->stats, full_replots);
 
-   for (; line < line_limit; ++row, ++line)
+   // Every visible row is about to be redrawn:
+   params->dirty_count = 0;
+
+   // A page drawn ahead by the worker is written as it is:
+   if (params->prerender == NULL || !pager_prerender_take(params))
    {
-      ti_set_cursor_position(line, left);
+      ti_begin_frame();
+      pager_write_page(params, NULL);
+      ti_end_frame();
+   }
 
-      // Erase the line before requesting a reprint.
-      // This is probably not necessary, plan to delete it.
-      ti_printf("\x1b[%dX", chars_count);
+   // Draw the pages around this one while the user reads it:
+   if (params->prerender)
+      pager_prerender_schedule(params);
+}
 
-      if (row <= end_row)
+/**
+ * @brief Plot several panes as a single screen update.
+ * @param "panes"  array of pointers to @ref DPARMS, one for each pane
+ * @param "count"  number of elements in @p panes
+ *
+ * Each pane should occupy its own region of the screen, as set
+ * by @ref pager_set_margins.  The output of all the panes is
+ * collected and written to the terminal at once.
+ *
+ * This function also sets the @p side_by_side member of each pane
+ * so later scrolling actions won't disturb neighboring panes.
+ */
+EXPORT void pager_plot_panes(DPARMS **panes, int count)
+{
+   // Note which panes must share screen lines with another pane:
+   for (int i = 0; i < count; ++i)
+   {
+      DPARMS *pane = panes[i];
+      pane->side_by_side = false;
+      for (int j = 0; j < count; ++j)
       {
-         bool has_focus = row == params->index_row_focus;
-         (params->printer)(row,
-                           has_focus,
-                           chars_count,
-                           params->data_source,
-                           params->data_extra);
+         const DPARMS *other = panes[j];
+         if (j != i
+             && other->line_top <= pane->line_bottom
+             && other->line_bottom >= pane->line_top)
+         {
+            pane->side_by_side = true;
+            break;
+         }
       }
-      // allow erased line above to handle output to vacant rows (rows without data)
    }
+
+   if (count > 0)
+      pager_select(panes[0]);
+
+   ti_begin_frame();
+
+   for (int i = 0; i < count; ++i)
+      pager_plot(panes[i]);
+
+   if (count > 0)
+      pager_select(panes[0]);
+
+   ti_end_frame();
 }
 
 
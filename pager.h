@@ -2,6 +2,7 @@
 #define PAGER_H
 
 #include <stdbool.h>
+#include <stddef.h>     // size_t
 
 /**
  * @brief Return value from pager actions, indicating action to take
@@ -15,8 +16,59 @@ typedef enum action_return_values {
 typedef struct display_params DPARMS;
 typedef ARV (*PACTION)(DPARMS*);
 
+/** @brief Opaque pager context, see @ref PAGER_CONTEXT */
+typedef struct pager_context PCONTEXT;
+
+/** @brief Opaque terminal handle, see @ref TERMINAL_SESSIONS */
+typedef struct pager_term PTERM;
+
+/**
+ * @brief Rendering and I/O counters, see @ref pager_context_stats
+ *
+ * Counters are only collected when the library is built with
+ * `PAGER_STATS` defined, and only for a @ref DPARMS whose @p stats
+ * member is set.
+ */
+typedef struct pager_stats {
+   unsigned long frames;           ///< screen updates written
+   unsigned long bytes_written;    ///< bytes written to the terminal
+   unsigned long write_calls;      ///< `write` system calls
+   unsigned long printer_calls;    ///< calls to the printer function
+   unsigned long full_replots;     ///< pages drawn by @ref pager_plot
+   unsigned long scroll_updates;   ///< one-line moves made by scrolling
+   unsigned long printer_ns_total; ///< nanoseconds spent in the printer
+   unsigned long printer_ns_max;   ///< longest single printer call
+   unsigned long prerendered;      ///< pages written as drawn ahead,
+                                   ///  see @ref pager_prerender_start
+} PSTATS;
+
+/** @brief Opaque worker drawing pages ahead, see @ref PRERENDER */
+typedef struct pager_prerender PRENDER;
+
+/** @brief Set of selected rows, see @ref SELECTION */
+typedef struct pager_selection PSELECTION;
+
+/**
+ * @brief Flags passed in the @p indicated argument of a printer
+ *
+ * Printers that only test @p indicated for being nonzero will
+ * highlight selected rows as they do the focused row.  Printers
+ * using @ref pager_write_spans needn't test the flags at all.
+ */
+enum pager_indicated_flags {
+   PAGER_INDICATED_FOCUS = 1,     ///< the row has the focus
+   PAGER_INDICATED_SELECTED = 2   ///< the row is in the selection of the pager
+};
+
 /**
  * @brief The pager will call this function to print each line
+ *
+ * The printer should write its output with @ref ti_write_str,
+ * @ref ti_write or @ref ti_printf, which are sequenced with the
+ * pager's own output when a screen update is collected into a
+ * single write.
+ *
+ * The @p indicated argument holds @ref pager_indicated_flags.
  */
 typedef int (*pwb_print_line)(int row_index,
                               int indicated,
@@ -24,6 +76,210 @@ typedef int (*pwb_print_line)(int row_index,
                               void *data_source,
                               void *data_extra);
 
+/**
+ * @brief Text attributes of a @ref PSTYLE
+ */
+enum pager_attr_flags {
+   PAGER_ATTR_BOLD = 1,
+   PAGER_ATTR_UNDERLINE = 2,
+   PAGER_ATTR_REVERSE = 4
+};
+
+/** @brief Colour of a @ref PSTYLE for palette entry @p index, 0 to 255 */
+#define PAGER_COLOR(index) ((index) + 1)
+
+/**
+ * @brief Colours and attributes of a run of text
+ *
+ * A zeroed style is the terminal's default: a colour of 0 is the
+ * default colour, and others are made with @ref PAGER_COLOR.
+ */
+typedef struct pager_style {
+   short fg;                ///< foreground colour
+   short bg;                ///< background colour
+   int attrs;               ///< @ref pager_attr_flags
+} PSTYLE;
+
+/**
+ * @brief A run of text in one style, see @ref pager_write_spans
+ */
+typedef struct pager_span {
+   const char *text;        ///< text to write, need not be NUL-terminated
+   int len;                 ///< bytes of @p text
+   PSTYLE style;            ///< style of the text on a row that isn't indicated
+} PSPAN;
+
+/**
+ * @brief Make more rows of a source of unknown length available
+ * @param "data_source"  the @p data_source of the @ref DPARMS
+ * @param "known"        number of rows already available
+ * @param "wanted"       number of rows wanted, more than @p known
+ * @return the number of rows now available, fewer than @p wanted
+ *         only if the source has ended.
+ *
+ * During a background count, see @ref pager_focus_end, this is
+ * called by the counting thread, but never at the same time as by
+ * the UI thread.
+ */
+typedef int (*pager_extend)(void *data_source, int known, int wanted);
+
+/**
+ * @brief Get ready to draw rows, as by fetching them in one batch
+ * @param "data_source"  the @p data_source of the @ref DPARMS
+ * @param "first"        index of the first row about to be drawn
+ * @param "count"        number of rows about to be drawn
+ * @param "top"          index of the top row of the page shown
+ * @param "line_count"   number of rows the page shows
+ *
+ * Called once for each screen update, before the printer is called
+ * for any of the rows drawn, see @ref pager_set_prepare.
+ */
+typedef void (*pager_prepare)(void *data_source,
+                              int first,
+                              int count,
+                              int top,
+                              int line_count);
+
+/**
+ * @brief Show the progress of a background count, on the UI thread
+ * @param "parms"     pager whose rows are being counted
+ * @param "counted"   rows counted so far
+ * @param "finished"  *true* if the count has ended or was cancelled
+ */
+typedef void (*pager_progress)(DPARMS *parms, int counted, bool finished);
+
+/** @brief Opaque columnar table, see @ref TABLES */
+typedef struct pager_table PTABLE;
+
+/**
+ * @brief How the values of a table column are stored.
+ */
+typedef enum pager_column_type {
+   PCOL_STRING = 0,   ///< @p values is an array of `const char*`
+   PCOL_LONG,         ///< @p values is an array of `long`
+   PCOL_DOUBLE,       ///< @p values is an array of `double`
+   PCOL_CALLBACK      ///< @p text formats each value
+} PCOL_TYPE;
+
+/**
+ * @brief Format the value of a @ref PCOL_CALLBACK column.
+ * @return length of the whole value, even if it didn't fit in @p buff,
+ *         as returned by `snprintf`.
+ */
+typedef int (*pcol_text)(int row_index,
+                         char *buff,
+                         int bufflen,
+                         void *column_data);
+
+/**
+ * @brief Definition of a table column, see @ref pager_table_create
+ *
+ * Each column has its own array of values, indexed by row.  Leave
+ * @p width at 0 to have the column measured from a sample of rows.
+ */
+typedef struct pager_column {
+   const char *title;       ///< column heading, may be NULL
+   PCOL_TYPE type;          ///< type of elements in @p values
+   const void *values;      ///< array of values, one for each row
+   pcol_text text;          ///< formatter for @ref PCOL_CALLBACK
+   void *column_data;       ///< passed to @p text
+   int width;               ///< fixed width, or 0 to measure
+   int max_width;           ///< limit of a measured width, 0 for the default
+   int precision;           ///< digits after the point of @ref PCOL_DOUBLE
+   bool align_right;        ///< right-justify the values, as for numbers
+} PCOLUMN;
+
+/** @brief Opaque delimited-file source, see @ref CSV_SOURCE */
+typedef struct pager_csv PCSV;
+
+/** @brief Opaque JSON lines source, see @ref JSONL_SOURCE */
+typedef struct pager_jsonl PJSONL;
+
+/** @brief Opaque compressed-file source, see @ref GZIP_SOURCE */
+typedef struct pager_gzip PGZIP;
+/** @brief Opaque list of files paged as one, see @ref MULTI_FILE_SOURCE */
+typedef struct pager_multi PMULTI;
+
+/** @brief Opaque hex dump of a mapped file, see @ref HEX_SOURCE */
+typedef struct pager_hex PHEX;
+
+/** @brief Opaque cache of rows fetched in batches, see @ref ROW_FETCH */
+typedef struct pager_fetch PFETCH;
+
+/**
+ * @brief Functions of a source whose rows are fetched in batches,
+ *        as from a database or a remote server, see @ref ROW_FETCH
+ *
+ * Only @p get_rows and @p print_row are required.
+ */
+typedef struct pager_fetch_ops {
+   /**
+    * Fetch @p count rows from @p first into @p rows, returning the
+    * number fetched, fewer only at the end of the rows or on error.
+    * The rows are kept until given to @p free_rows.
+    */
+   int (*get_rows)(void *source, int first, int count, void **rows);
+   /**
+    * Release @p count rows fetched by @p get_rows, where those that
+    * weren't fetched are NULL.  May be NULL.
+    */
+   void (*free_rows)(void *source, void **rows, int count);
+   /** Number of rows, or -1 if it isn't known yet, may be NULL */
+   int (*row_count)(void *source);
+   /** Told which rows the page shows when that changes, may be NULL */
+   void (*show_rows)(void *source, int top, int count);
+   /** Draw a fetched row, as a @ref pwb_print_line function would */
+   int (*print_row)(void *row, int row_index, int indicated, int length, void *source);
+} PFETCHOPS;
+
+/** @brief Opaque store of lines, see @ref LINE_STORE */
+typedef struct pager_lines PLINES;
+
+/** @brief Opaque printer of coloured text, see @ref ANSI_TEXT */
+typedef struct pager_ansi PANSI;
+
+/** @brief Opaque ranking of rows matching a query, see @ref FUZZY_FILTER */
+typedef struct pager_filter PFILTER;
+
+/** @brief Opaque tree of collapsible nodes, see @ref TREE_VIEW */
+typedef struct pager_tree PTREE;
+
+/**
+ * @brief Get the raw text of a row, see @ref pager_ansi_create
+ * @param "data_source"  source of the rows
+ * @param "row_index"    row whose text is wanted
+ * @param "len"          [out] length of the text
+ * @return pointer to the text, which need not be NUL-terminated,
+ *         or NULL if there is none.
+ */
+typedef const char *(*pager_row_text)(void *data_source, int row_index, int *len);
+
+/**
+ * @brief Sources the library draws without a printer, see @ref STRING_ARRAYS
+ */
+enum pager_source_types {
+   PAGER_SOURCE_PRINTER = 0,  ///< rows are drawn by the printer
+   PAGER_SOURCE_STRINGS,      ///< @p data_source is an array of C strings
+   PAGER_SOURCE_COUNTED       ///< @p data_source is an array of @ref PSTRING
+};
+
+/**
+ * @brief A string that need not be NUL-terminated, see @ref pager_init_counted
+ */
+typedef struct pager_string {
+   const char *text;
+   int len;
+} PSTRING;
+
+/** @brief Most separate ranges of dirty rows kept by a @ref DPARMS */
+#define PAGER_DIRTY_RANGES 8
+
+/** @brief Inclusive range of rows */
+typedef struct pager_range {
+   int first;
+   int last;
+} PRANGE;
+
 /**
  * @brief Parameters needed to run the pager.
  *
@@ -65,6 +321,30 @@ struct display_params {
    int line_count;          ///< number of screen lines in region
    int chars_left;          ///< left margin
    int chars_count;         ///< number of characters to print per line
+
+   bool side_by_side;       ///< other panes share these screen lines,
+                            ///  set by @ref pager_plot_panes
+
+   PTERM *term;             ///< terminal on which to draw, NULL for the
+                            ///  process's terminal.  See @ref pager_set_term
+   PSTATS *stats;           ///< counters to update, NULL to not collect
+   PSELECTION *selection;   ///< rows to indicate as selected, may be NULL
+
+   pager_extend extend;     ///< asked for more rows while @p row_count is
+                            ///  not exact, see @ref pager_set_extend
+   pager_prepare prepare;   ///< told of the rows about to be drawn,
+                            ///  see @ref pager_set_prepare
+   PCONTEXT *context;       ///< context owning these parameters, if any
+
+   int dirty_count;         ///< ranges in @p dirty
+   PRANGE dirty[PAGER_DIRTY_RANGES]; ///< visible rows waiting to be redrawn,
+                                     ///  see @ref pager_invalidate_rows
+
+   PRENDER *prerender;      ///< worker drawing the pages around this one,
+                            ///  see @ref pager_prerender_start
+
+   int source;              ///< @ref pager_source_types, set by
+                            ///  @ref pager_init_strings to skip the printer
 };
 
 
@@ -81,12 +361,21 @@ void pager_init_dparms(DPARMS *parms,
 
 bool pager_set_margins(DPARMS *parms, int top, int right, int bottom, int left);
 void pager_calc_borders(DPARMS *parms);
+void pager_set_term(DPARMS *parms, PTERM *term);
+void pager_set_extend(DPARMS *parms, pager_extend extend);
+void pager_set_prepare(DPARMS *parms, pager_prepare prepare);
 
 void pager_init(void);
 void pager_cleanup(void);
 
+bool pager_set_cache_dir(const char *path);
+
 void pager_plot_row(DPARMS *params, int row_index);
 void pager_plot(DPARMS *params);
+void pager_plot_panes(DPARMS **panes, int count);
+
+void pager_invalidate_rows(DPARMS *parms, int first, int last);
+void pager_plot_dirty(DPARMS *parms);
 
 
 // void start_pager(DPARMS *parms);
@@ -127,6 +416,366 @@ ARV pager_scroll_home(DPARMS *parms);
  * @}
  */
 
+/**
+ * @defgroup PAGER_CONTEXT Thread-safe pager context
+ * @brief Functions found in `pager_context.c`
+ *
+ * The `pager_post_` functions may be called from any thread.  The
+ * others belong to the UI thread.
+ * @{
+ */
+PCONTEXT *pager_context_create(void *data_source,
+                               int row_count,
+                               pwb_print_line printer,
+                               void *data_extra);
+void pager_context_destroy(PCONTEXT *ctx);
+DPARMS *pager_context_dparms(PCONTEXT *ctx);
+int pager_context_wake_fd(const PCONTEXT *ctx);
+ARV pager_context_apply(PCONTEXT *ctx);
+void pager_context_enable_stats(PCONTEXT *ctx, bool enable);
+void pager_context_stats(const PCONTEXT *ctx, PSTATS *snapshot);
+void pager_context_set_progress(PCONTEXT *ctx, pager_progress progress);
+ARV pager_cancel_count(DPARMS *parms);
+
+bool pager_post_invalidate(PCONTEXT *ctx, int first, int last);
+bool pager_post_row_count(PCONTEXT *ctx, int row_count);
+bool pager_post_action(PCONTEXT *ctx, PACTION action);
+/** @} */
+
+/**
+ * @defgroup PRERENDER Pages drawn ahead on a worker thread
+ * @brief Functions found in `pager_prerender.c`
+ * @{
+ */
+bool pager_prerender_start(DPARMS *parms, size_t budget);
+void pager_prerender_stop(DPARMS *parms);
+void pager_prerender_discard(DPARMS *parms, int first, int last);
+/** @} */
+
+/**
+ * @brief Test function for @ref pager_selection_add_matching
+ */
+typedef bool (*psel_match)(int row_index, void *data);
+
+/**
+ * @defgroup SELECTION Multiple-row selection
+ * @brief Functions found in `pager_selection.c`
+ *
+ * Set the @p selection member of a @ref DPARMS to have selected
+ * rows indicated to its printer.
+ * @{
+ */
+PSELECTION *pager_selection_create(void);
+void pager_selection_destroy(PSELECTION *sel);
+void pager_selection_clear(PSELECTION *sel);
+long pager_selection_count(const PSELECTION *sel);
+bool pager_selection_has(const PSELECTION *sel, int row_index);
+bool pager_selection_set(PSELECTION *sel, int row_index, bool selected);
+bool pager_selection_set_range(PSELECTION *sel, int first, int last, bool selected);
+bool pager_selection_toggle(PSELECTION *sel, int row_index);
+bool pager_selection_add_matching(PSELECTION *sel,
+                                  int first,
+                                  int last,
+                                  psel_match match,
+                                  void *data);
+int pager_selection_next(const PSELECTION *sel, int after);
+
+ARV pager_toggle_selection(DPARMS *parms);
+/** @} */
+
+/**
+ * @defgroup LINE_STORE Line store for piped input
+ * @brief Functions found in `pager_lines.c`
+ *
+ * Use a @ref PLINES as the data source, and @ref pager_lines_printer
+ * as the printer, of a @ref DPARMS.
+ * @{
+ */
+PLINES *pager_lines_create(void);
+void pager_lines_destroy(PLINES *store);
+bool pager_lines_append(PLINES *store, const char *text, size_t len);
+bool pager_lines_finish(PLINES *store);
+bool pager_lines_read_fd(PLINES *store, int fd);
+bool pager_lines_read_file(PLINES *store, const char *path);
+int pager_lines_count(const PLINES *store);
+size_t pager_lines_memory(const PLINES *store);
+const char *pager_lines_get(const PLINES *store, int row_index, int *len);
+const char *pager_lines_text(void *data_source, int row_index, int *len);
+int pager_lines_printer(int row_index,
+                        int indicated,
+                        int length,
+                        void *data_source,
+                        void *data_extra);
+/** @} */
+
+/**
+ * @defgroup TABLES Columnar table rendering
+ * @brief Functions found in `pager_table.c`
+ *
+ * Use a @ref PTABLE as the data source, and @ref pager_table_printer
+ * as the printer, of a @ref DPARMS.
+ * @{
+ */
+PTABLE *pager_table_create(const PCOLUMN *defs, int column_count, int row_count);
+void pager_table_destroy(PTABLE *table);
+void pager_table_reset(PTABLE *table, int row_count);
+void pager_table_invalidate(PTABLE *table, int first, int last);
+int pager_table_column_width(const PTABLE *table, int column);
+int pager_table_printer(int row_index,
+                        int indicated,
+                        int length,
+                        void *data_source,
+                        void *data_extra);
+void pager_table_print_titles(const DPARMS *parms);
+
+ARV pager_table_left(DPARMS *parms);
+ARV pager_table_right(DPARMS *parms);
+/** @} */
+
+/**
+ * @defgroup CSV_SOURCE Delimited text files
+ * @brief Functions found in `pager_csv.c`
+ *
+ * Open a CSV or TSV file, then make table columns for the fields
+ * to be shown with @ref pager_csv_columns.
+ * @{
+ */
+PCSV *pager_csv_open(const char *path, char delimiter, bool has_header);
+void pager_csv_close(PCSV *csv);
+int pager_csv_row_count(const PCSV *csv);
+int pager_csv_field_count(PCSV *csv);
+bool pager_csv_columns(PCSV *csv, const int *fields, int count, PCOLUMN *defs);
+/** @} */
+
+/**
+ * @defgroup JSONL_SOURCE JSON lines files
+ * @brief Functions found in `pager_jsonl.c`
+ *
+ * Open a file of JSON lines, then make table columns for the fields
+ * to be shown with @ref pager_jsonl_columns.
+ * @{
+ */
+PJSONL *pager_jsonl_open(const char *path);
+void pager_jsonl_close(PJSONL *jsonl);
+int pager_jsonl_row_count(const PJSONL *jsonl);
+bool pager_jsonl_columns(PJSONL *jsonl, const char *const *paths, int count, PCOLUMN *defs);
+const char *pager_jsonl_text(void *data_source, int row_index, int *len);
+/** @} */
+
+/**
+ * @defgroup GZIP_SOURCE Compressed text files
+ * @brief Functions found in `pager_gzip.c`
+ *
+ * Use a @ref PGZIP as the data source, and @ref pager_gzip_printer
+ * as the printer, of a @ref DPARMS.
+ * @{
+ */
+PGZIP *pager_gzip_open(const char *path, long spacing);
+void pager_gzip_close(PGZIP *gz);
+int pager_gzip_row_count(const PGZIP *gz);
+const char *pager_gzip_line(PGZIP *gz, int row_index, int *len);
+const char *pager_gzip_text(void *data_source, int row_index, int *len);
+int pager_gzip_printer(int row_index,
+                       int indicated,
+                       int length,
+                       void *data_source,
+                       void *data_extra);
+/** @} */
+
+/**
+ * @defgroup MULTI_FILE_SOURCE Files paged as one
+ * @brief Functions found in `pager_multi.c`
+ *
+ * Use a @ref PMULTI as the data source, @ref pager_multi_printer as
+ * the printer, and @ref pager_multi_extend as the extend function,
+ * see @ref pager_set_extend, of a @ref DPARMS.
+ * @{
+ */
+PMULTI *pager_multi_open(const char *const *paths, int count, int max_open);
+void pager_multi_close(PMULTI *multi);
+int pager_multi_extend(void *data_source, int known, int wanted);
+int pager_multi_row_count(const PMULTI *multi);
+int pager_multi_file(const PMULTI *multi, int row_index, int *line);
+const char *pager_multi_path(const PMULTI *multi, int file);
+const char *pager_multi_line(PMULTI *multi, int row_index, int *len);
+const char *pager_multi_text(void *data_source, int row_index, int *len);
+int pager_multi_printer(int row_index,
+                        int indicated,
+                        int length,
+                        void *data_source,
+                        void *data_extra);
+/** @} */
+
+/**
+ * @defgroup HEX_SOURCE Hex dumps of binary files
+ * @brief Functions found in `pager_hex.c`
+ *
+ * Use a @ref PHEX as the data source, with @ref pager_hex_row_count
+ * rows and @ref pager_hex_printer as the printer, of a @ref DPARMS.
+ * @{
+ */
+PHEX *pager_hex_open(const char *path, int width);
+void pager_hex_close(PHEX *hex);
+int pager_hex_row_count(const PHEX *hex);
+size_t pager_hex_offset(const PHEX *hex, int row_index);
+int pager_hex_row(const PHEX *hex, size_t offset);
+ARV pager_hex_seek(DPARMS *parms, size_t offset);
+int pager_hex_printer(int row_index,
+                      int indicated,
+                      int length,
+                      void *data_source,
+                      void *data_extra);
+/** @} */
+
+/**
+ * @defgroup ROW_FETCH Rows fetched in batches
+ * @brief Functions found in `pager_fetch.c`
+ *
+ * Use @ref pager_init_fetch to page a @ref PFETCH.
+ * @{
+ */
+PFETCH *pager_fetch_create(const PFETCHOPS *ops, void *source, int capacity);
+void pager_fetch_destroy(PFETCH *fetch);
+void pager_init_fetch(DPARMS *parms, PFETCH *fetch);
+void *pager_fetch_row(PFETCH *fetch, int row_index);
+void pager_fetch_discard(PFETCH *fetch, int first, int last);
+void pager_fetch_prepare(void *data_source, int first, int count, int top, int line_count);
+int pager_fetch_extend(void *data_source, int known, int wanted);
+int pager_fetch_printer(int row_index,
+                        int indicated,
+                        int length,
+                        void *data_source,
+                        void *data_extra);
+/** @} */
+
+/**
+ * @defgroup STRING_ARRAYS Arrays of strings
+ * @brief Functions found in `pager_strings.c`
+ * @{
+ */
+void pager_init_strings(DPARMS *parms, const char **strings, int count);
+void pager_init_counted(DPARMS *parms, const PSTRING *strings, int count);
+int pager_strings_printer(int row_index,
+                          int indicated,
+                          int length,
+                          void *data_source,
+                          void *data_extra);
+int pager_counted_printer(int row_index,
+                          int indicated,
+                          int length,
+                          void *data_source,
+                          void *data_extra);
+/** @} */
+
+/**
+ * @defgroup STYLED_SPANS Styled text for printers
+ * @brief Functions found in `pager.c`
+ * @{
+ */
+int pager_write_spans(const PSPAN *spans, int count, int length, int indicated);
+/** @} */
+
+/**
+ * @defgroup ANSI_TEXT Text with colour escape sequences
+ * @brief Functions found in `pager_ansi.c`
+ *
+ * Use a @ref PANSI as the data source, and @ref pager_ansi_printer
+ * as the printer, of a @ref DPARMS.
+ * @{
+ */
+PANSI *pager_ansi_create(pager_row_text text, void *data_source);
+void pager_ansi_destroy(PANSI *ansi);
+void pager_ansi_invalidate(PANSI *ansi, int first, int last);
+int pager_ansi_printer(int row_index,
+                       int indicated,
+                       int length,
+                       void *data_source,
+                       void *data_extra);
+
+ARV pager_ansi_left(DPARMS *parms);
+ARV pager_ansi_right(DPARMS *parms);
+/** @} */
+
+/**
+ * @defgroup FUZZY_FILTER Fuzzy filtering of rows
+ * @brief Functions found in `pager_filter.c`
+ *
+ * Use a @ref PFILTER as the data source, and @ref pager_filter_printer
+ * as the printer, of a @ref PCONTEXT.
+ * @{
+ */
+PFILTER *pager_filter_create(pager_row_text text, void *data_source, int row_count, int threads);
+void pager_filter_destroy(PFILTER *filter);
+void pager_filter_set_context(PFILTER *filter, PCONTEXT *ctx);
+bool pager_filter_set_query(PFILTER *filter, const char *query);
+int pager_filter_count(PFILTER *filter, bool *finished);
+int pager_filter_row(PFILTER *filter, int rank);
+int pager_filter_printer(int row_index,
+                         int indicated,
+                         int length,
+                         void *data_source,
+                         void *data_extra);
+/** @} */
+
+/**
+ * @defgroup TREE_VIEW Collapsible trees
+ * @brief Functions found in `pager_tree.c`
+ *
+ * Use a @ref PTREE as the data source, and @ref pager_tree_printer
+ * as the printer, of a @ref DPARMS.
+ * @{
+ */
+PTREE *pager_tree_create(const int *depths,
+                         int count,
+                         bool expanded,
+                         pwb_print_line printer,
+                         void *data_source);
+void pager_tree_destroy(PTREE *tree);
+int pager_tree_row_count(const PTREE *tree);
+int pager_tree_node(const PTREE *tree, int row_index);
+int pager_tree_row(const PTREE *tree, int node);
+int pager_tree_depth(const PTREE *tree, int node);
+int pager_tree_parent(const PTREE *tree, int node);
+bool pager_tree_has_children(const PTREE *tree, int node);
+bool pager_tree_is_expanded(const PTREE *tree, int node);
+void pager_tree_set_expanded(PTREE *tree, int node, bool expanded);
+int pager_tree_printer(int row_index,
+                       int indicated,
+                       int length,
+                       void *data_source,
+                       void *data_extra);
+
+ARV pager_tree_toggle(DPARMS *parms);
+ARV pager_tree_expand(DPARMS *parms);
+ARV pager_tree_collapse(DPARMS *parms);
+/** @} */
+
+/**
+ * @defgroup TRACING Timeline of frames, printer calls and writes
+ * @brief Functions found in `pager_trace.c`
+ * @{
+ */
+bool pager_trace_start(int capacity, const char *path);
+void pager_trace_stop(void);
+bool pager_trace_dump(const char *path);
+unsigned long pager_trace_begin(void);
+void pager_trace_end(unsigned long start, const char *name, int arg);
+/** @} */
+
+/**
+ * @defgroup TERMINAL_SESSIONS Terminals other than the process's own
+ * @brief Functions found in `termstuff.c`
+ * @{
+ */
+PTERM *pager_term_open(int fd_in, int fd_out, const char *term_name);
+void pager_term_close(PTERM *term);
+void pager_term_init(PTERM *term);
+void pager_term_cleanup(PTERM *term);
+void pager_term_set_size(PTERM *term, int rows, int cols);
+int pager_term_pending(const PTERM *term);
+void pager_term_flush(PTERM *term);
+/** @} */
+
 /**
  * @defgroup termstuff utility functions
  * @{
@@ -135,6 +784,10 @@ void ti_set_cursor_position(int row, int col);
 void ti_hide_cursor(void);
 void ti_show_cursor(void);
 
+void ti_begin_frame(void);
+void ti_end_frame(void);
+
+void ti_write(const char *str, int len);
 void ti_write_str(const char *str);
 int ti_printf(const char *fmt, ...);
 /** @} */
@@ -3,6 +3,7 @@
 
 #include "export.h"
 #include "pager.h"
+#include "pager_private.h"
 #include "termstuff.h"
 
 /**
@@ -48,12 +49,38 @@ int get_line_index_from_row_index(const DPARMS *parms, int row_index)
 void print_indexed_row(const DPARMS *parms, int row_index, bool has_focus)
 {
    int line = get_line_index_from_row_index(parms, row_index);
+   pager_select(parms);
+   pager_prepare_rows(parms, row_index, row_index);
+   ti_begin_frame();
    ti_set_cursor_position(line, parms->chars_left);
-   (*parms->printer)(row_index,
-                     has_focus,
-                     parms->chars_count,
-                     parms->data_source,
-                     parms->data_extra);
+   pager_call_printer(parms, row_index, has_focus);
+   ti_end_frame();
+}
+
+/**
+ * @brief Confine terminal scrolling to the pane before scrolling it.
+ * @param "parms"     Active pager control data
+ * @return *true* if the pane can be scrolled, *false* if the terminal
+ *         can't scroll the pane without disturbing its neighbors, in
+ *         which case the pane must be replotted.
+ *
+ * A pane that shares its screen lines with other panes can only be
+ * scrolled if the terminal supports left/right margins.
+ */
+bool prepare_scroll_region(const DPARMS *parms)
+{
+   if (!ti_can_scroll())
+      return false;
+
+   if (!parms->side_by_side)
+      ti_clear_side_limits();
+   else if (ti_can_scroll_sides())
+      ti_set_side_limits(parms->chars_left, parms->chars_count);
+   else
+      return false;
+
+   ti_set_scroll_limit(parms->line_top, parms->line_count - 1);
+   return true;
 }
 
 /** @} */
@@ -80,25 +107,43 @@ EXPORT ARV pager_focus_up_one(DPARMS *parms)
    // We shouldn't have to check if the focus should be on a valid row:
    assert(parms->index_row_focus < parms->row_count);
 
+   ARV arv = ARV_CONTINUE;
+
    if (parms->index_row_focus > 0)
    {
+      pager_select(parms);
+      ti_begin_frame();
       print_indexed_row(parms, parms->index_row_focus, 0);
 
       --parms->index_row_focus;
       if (parms->index_row_focus < parms->index_row_top)
       {
-         ti_scroll_reverse();
          --parms->index_row_top;
+
+         if (prepare_scroll_region(parms))
+         {
+            ti_set_cursor_position(parms->line_top, parms->chars_left);
+            ti_scroll_reverse();
+            PSTAT_INC(parms->stats, scroll_updates);
+         }
+         else
+            arv = ARV_REPLOT_DATA;
       }
 
-      print_indexed_row(parms, parms->index_row_focus, 1);
+      if (arv == ARV_CONTINUE)
+         print_indexed_row(parms, parms->index_row_focus, 1);
+
+      ti_end_frame();
    }
 
-   return ARV_CONTINUE;
+   return arv;
 }
 
 EXPORT ARV pager_focus_down_one(DPARMS *parms)
 {
+   // Read ahead of the focus in a source of unknown length:
+   pager_extend_rows(parms, parms->index_row_focus + parms->line_count + 1);
+
    // Skip if no rows to which to move
    if (parms->row_count == 0)
       return ARV_CONTINUE;
@@ -106,11 +151,15 @@ EXPORT ARV pager_focus_down_one(DPARMS *parms)
    // We shouldn't have to check if the focus should be on a valid row:
    assert(parms->index_row_focus >= 0);
 
+   ARV arv = ARV_CONTINUE;
    int table_last_index = parms->row_count - 1;
 
    // If there remains table rows below the focus
    if (parms->index_row_focus < table_last_index)
    {
+      pager_select(parms);
+      ti_begin_frame();
+
       // Change registered focus after unindicating current focus
       print_indexed_row(parms, parms->index_row_focus, 0);
       ++parms->index_row_focus;
@@ -118,21 +167,32 @@ EXPORT ARV pager_focus_down_one(DPARMS *parms)
       int screen_last_index = get_index_bottom_line(parms);
       if (parms->index_row_focus > screen_last_index)
       {
-         int row = parms->line_top + parms->line_count - 1;
-         int col = parms->chars_left + parms->chars_count;
-         ti_set_cursor_position(row, col);
-         ti_scroll_forward();
          ++parms->index_row_top;
+
+         if (prepare_scroll_region(parms))
+         {
+            int row = parms->line_top + parms->line_count - 1;
+            ti_set_cursor_position(row, parms->chars_left);
+            ti_scroll_forward();
+            PSTAT_INC(parms->stats, scroll_updates);
+         }
+         else
+            arv = ARV_REPLOT_DATA;
       }
 
-      print_indexed_row(parms, parms->index_row_focus, 1);
+      if (arv == ARV_CONTINUE)
+         print_indexed_row(parms, parms->index_row_focus, 1);
+
+      ti_end_frame();
    }
 
-   return ARV_CONTINUE;
+   return arv;
 }
 
 EXPORT ARV pager_focus_down_page(DPARMS *parms)
 {
+   pager_extend_rows(parms, parms->index_row_focus + parms->line_count * 2);
+
    // Skip if no rows to which to move
    if (parms->row_count == 0)
       return ARV_CONTINUE;
@@ -200,8 +260,20 @@ EXPORT ARV pager_focus_up_page(DPARMS *parms)
    return ARV_CONTINUE;
 }
 
+/**
+ * @brief Move the focus to the last row.
+ *
+ * If the length of the source is unknown, see @ref pager_set_extend,
+ * the rest of the rows are counted first.  With a @ref PCONTEXT,
+ * they are counted in the background, the view remains usable, and
+ * the focus moves when the count is applied.  The count can be
+ * stopped with @ref pager_cancel_count.
+ */
 EXPORT ARV pager_focus_end(DPARMS *parms)
 {
+   if (parms->extend && !pager_count_rows(parms))
+      return ARV_CONTINUE;
+
    // Skip if no rows to which to move
    if (parms->row_count == 0)
       return ARV_CONTINUE;
@@ -0,0 +1,514 @@
+#include <stdlib.h>     // malloc/free
+#include <string.h>
+#include <assert.h>
+
+#include "export.h"
+#include "pager.h"
+#include "pager_private.h"
+
+/** @brief Slots in the parsed row cache, a power of 2 */
+#define ANSI_ROW_SLOTS 1024
+
+/** @brief Columns between tab stops */
+#define ANSI_TAB_WIDTH 8
+
+/**
+ * @brief Column at which a style starts in a parsed row.
+ */
+typedef struct ansi_run {
+   int start;
+   PSTYLE style;
+} ARUN;
+
+/**
+ * @brief A row with its escape sequences parsed out.
+ *
+ * The text holds only what is displayed, one byte to a column,
+ * so it can be cut at any column.
+ */
+typedef struct ansi_row {
+   int row;                 ///< row of parsed text, -1 if empty
+   char *text;              ///< displayed text, tabs expanded
+   int len;                 ///< columns of @p text
+   int text_size;           ///< bytes allocated to @p text
+   ARUN *runs;              ///< styles of @p text, in order of @p start
+   int run_count;
+   int runs_size;           ///< elements allocated to @p runs
+} AROW;
+
+struct pager_ansi {
+   pager_row_text text;     ///< gets the raw text of a row
+   void *data_source;       ///< passed to @p text
+   int column_first;        ///< leftmost column shown
+   AROW *rows;              ///< cache of parsed rows
+   PSPAN *spans;            ///< spans of the row being written
+   int spans_size;          ///< elements allocated to @p spans
+};
+
+/**
+ * @brief Palette index of a 24-bit colour in the 6x6x6 colour cube.
+ */
+static int cube_color(int red, int green, int blue)
+{
+   return 16 + 36 * ((red * 5 + 127) / 255)
+      + 6 * ((green * 5 + 127) / 255)
+      + (blue * 5 + 127) / 255;
+}
+
+/**
+ * @brief Read an extended colour, `5;n` or `2;r;g;b`, after 38 or 48.
+ * @return the colour as a @ref PSTYLE value, or -1 if malformed.
+ *
+ * @p index is left on the last parameter read.
+ */
+static int extended_color(const int *params, int count, int *index)
+{
+   int i = *index;
+   if (i + 2 < count && params[i + 1] == 5)
+   {
+      *index = i + 2;
+      return PAGER_COLOR(params[i + 2] & 0xff);
+   }
+
+   if (i + 4 < count && params[i + 1] == 2)
+   {
+      *index = i + 4;
+      return PAGER_COLOR(cube_color(params[i + 2] & 0xff,
+                                    params[i + 3] & 0xff,
+                                    params[i + 4] & 0xff));
+   }
+
+   *index = count;
+   return -1;
+}
+
+/**
+ * @brief Apply the parameters of an SGR sequence to a style.
+ *
+ * Attributes a @ref PSTYLE can't show, like italics, are ignored.
+ */
+static void apply_sgr(PSTYLE *style, const int *params, int count)
+{
+   static const PSTYLE plain = { 0, 0, 0 };
+
+   // No parameters is a reset:
+   if (count == 0)
+      *style = plain;
+
+   for (int i = 0; i < count; ++i)
+   {
+      int code = params[i];
+      if (code == 0)
+         *style = plain;
+      else if (code == 1)
+         style->attrs |= PAGER_ATTR_BOLD;
+      else if (code == 4)
+         style->attrs |= PAGER_ATTR_UNDERLINE;
+      else if (code == 7)
+         style->attrs |= PAGER_ATTR_REVERSE;
+      else if (code == 22)
+         style->attrs &= ~PAGER_ATTR_BOLD;
+      else if (code == 24)
+         style->attrs &= ~PAGER_ATTR_UNDERLINE;
+      else if (code == 27)
+         style->attrs &= ~PAGER_ATTR_REVERSE;
+      else if (code >= 30 && code <= 37)
+         style->fg = PAGER_COLOR(code - 30);
+      else if (code >= 90 && code <= 97)
+         style->fg = PAGER_COLOR(code - 90 + 8);
+      else if (code == 39)
+         style->fg = 0;
+      else if (code >= 40 && code <= 47)
+         style->bg = PAGER_COLOR(code - 40);
+      else if (code >= 100 && code <= 107)
+         style->bg = PAGER_COLOR(code - 100 + 8);
+      else if (code == 49)
+         style->bg = 0;
+      else if (code == 38 || code == 48)
+      {
+         int color = extended_color(params, count, &i);
+         if (color >= 0)
+         {
+            if (code == 38)
+               style->fg = color;
+            else
+               style->bg = color;
+         }
+      }
+   }
+}
+
+/**
+ * @brief Make room in a parsed row for @p len columns and @p runs runs.
+ */
+static bool reserve_row(AROW *slot, int len, int runs)
+{
+   if (len > slot->text_size)
+   {
+      int size = slot->text_size ? slot->text_size : 128;
+      while (size < len)
+         size *= 2;
+
+      char *text = (char*)realloc(slot->text, size);
+      if (text == NULL)
+         return false;
+
+      slot->text = text;
+      slot->text_size = size;
+   }
+
+   if (runs > slot->runs_size)
+   {
+      int size = slot->runs_size ? slot->runs_size * 2 : 8;
+      while (size < runs)
+         size *= 2;
+
+      ARUN *grown = (ARUN*)realloc(slot->runs, sizeof(ARUN) * size);
+      if (grown == NULL)
+         return false;
+
+      slot->runs = grown;
+      slot->runs_size = size;
+   }
+
+   return true;
+}
+
+/**
+ * @brief Skip an escape sequence, applying it if it sets the style.
+ * @return pointer to the byte after the sequence.
+ *
+ * CSI sequences other than SGR, OSC strings and other escapes are
+ * dropped, since they would move the cursor or change the terminal.
+ */
+static const char *parse_escape(const char *ptr, const char *end, PSTYLE *style)
+{
+   // ptr is at the ESC:
+   if (++ptr >= end)
+      return end;
+
+   if (*ptr == '[')
+   {
+      int params[32];
+      int count = 0, value = 0;
+      bool has_value = false;
+
+      for (++ptr; ptr < end; ++ptr)
+      {
+         unsigned char chr = (unsigned char)*ptr;
+         if (chr >= '0' && chr <= '9')
+         {
+            // Stop growing a value far past any meaningful parameter:
+            if (value < 65536)
+               value = value * 10 + (chr - '0');
+            has_value = true;
+         }
+         else if (chr == ';' || chr == ':')
+         {
+            if (count < 32)
+               params[count++] = value;
+            value = 0;
+            has_value = false;
+         }
+         else if (chr >= 0x40 && chr <= 0x7e)
+         {
+            if ((has_value || count > 0) && count < 32)
+               params[count++] = value;
+            if (chr == 'm')
+               apply_sgr(style, params, count);
+            return ptr + 1;
+         }
+      }
+      return end;
+   }
+
+   if (*ptr == ']')
+   {
+      // An OSC string ends with BEL or ESC backslash:
+      for (++ptr; ptr < end; ++ptr)
+      {
+         if (*ptr == '\a')
+            return ptr + 1;
+         if (*ptr == '\x1b' && ptr + 1 < end && ptr[1] == '\\')
+            return ptr + 2;
+      }
+      return end;
+   }
+
+   // Other escapes, like ESC ( B that ends `tput sgr0`, have
+   // intermediate bytes before their final byte:
+   while (ptr < end && *ptr >= 0x20 && *ptr <= 0x2f)
+      ++ptr;
+
+   return ptr < end ? ptr + 1 : end;
+}
+
+/**
+ * @brief Parse a row into displayed text and style runs.
+ */
+static bool parse_row(AROW *slot, const char *raw, int raw_len)
+{
+   const char *ptr = raw;
+   const char *end = raw + raw_len;
+
+   PSTYLE style = { 0, 0, 0 };
+   slot->len = 0;
+   slot->run_count = 0;
+
+   while (ptr < end)
+   {
+      if (*ptr == '\x1b')
+      {
+         ptr = parse_escape(ptr, end, &style);
+         continue;
+      }
+
+      int columns = 1;
+      if (*ptr == '\t')
+         columns = ANSI_TAB_WIDTH - slot->len % ANSI_TAB_WIDTH;
+
+      // Start a run where the style changes:
+      const ARUN *last = slot->run_count ? &slot->runs[slot->run_count - 1] : NULL;
+      bool new_run = last == NULL
+         || last->style.fg != style.fg
+         || last->style.bg != style.bg
+         || last->style.attrs != style.attrs;
+
+      if (!reserve_row(slot, slot->len + columns, slot->run_count + 1))
+         return false;
+
+      if (new_run)
+      {
+         ARUN *run = &slot->runs[slot->run_count++];
+         run->start = slot->len;
+         run->style = style;
+      }
+
+      if (*ptr == '\t')
+         memset(slot->text + slot->len, ' ', columns);
+      else
+         slot->text[slot->len] = *ptr;
+
+      slot->len += columns;
+      ++ptr;
+   }
+
+   return true;
+}
+
+/**
+ * @brief Get a parsed row, parsing it if it isn't cached.
+ * @return the row, or NULL if out of memory.
+ */
+static const AROW *get_row(PANSI *ansi, int row_index)
+{
+   AROW *slot = &ansi->rows[row_index & (ANSI_ROW_SLOTS - 1)];
+   if (slot->row == row_index)
+      return slot;
+
+   slot->row = -1;
+
+   int len = 0;
+   const char *raw = (*ansi->text)(ansi->data_source, row_index, &len);
+   if (raw == NULL)
+      len = 0;
+
+   if (!parse_row(slot, raw, len))
+      return NULL;
+
+   slot->row = row_index;
+   return slot;
+}
+
+/**
+ * @brief Widest parsed row visible in a pager.
+ */
+static int visible_width(PANSI *ansi, const DPARMS *parms)
+{
+   int width = 0;
+   int end = parms->index_row_top + parms->line_count;
+   if (end > parms->row_count)
+      end = parms->row_count;
+
+   for (int row = parms->index_row_top; row < end; ++row)
+   {
+      const AROW *parsed = get_row(ansi, row);
+      if (parsed && parsed->len > width)
+         width = parsed->len;
+   }
+
+   return width;
+}
+
+/**
+ * @defgroup ANSI_TEXT Text with colour escape sequences
+ * @brief Functions found in `pager_ansi.c`
+ *
+ * Like `less -R`, escape sequences that set colours and attributes
+ * are shown rather than printed.  Each row is parsed once into the
+ * text to display and the style of each run of it, and kept in a
+ * cache, so cutting the text at the screen edge, shifting it
+ * sideways and highlighting the focus work on display columns
+ * without parsing the row again.
+ * @{
+ */
+
+/**
+ * @brief Show the rows of a source with their colours.
+ * @param "text"         gets the raw text of a row from @p data_source,
+ *                       for example @ref pager_lines_text
+ * @param "data_source"  source of the rows
+ * @return new printer state, or NULL if out of memory.  Release it
+ *         with @ref pager_ansi_destroy.
+ *
+ * Use the returned @ref PANSI as the data source, and
+ * @ref pager_ansi_printer as the printer, of a @ref DPARMS.  The row
+ * count is that of @p data_source.
+ */
+EXPORT PANSI *pager_ansi_create(pager_row_text text, void *data_source)
+{
+   PANSI *ansi = (PANSI*)malloc(sizeof(PANSI));
+   if (ansi == NULL)
+      return NULL;
+
+   memset(ansi, 0, sizeof(PANSI));
+   ansi->text = text;
+   ansi->data_source = data_source;
+
+   ansi->rows = (AROW*)calloc(ANSI_ROW_SLOTS, sizeof(AROW));
+   if (ansi->rows == NULL)
+   {
+      free(ansi);
+      return NULL;
+   }
+
+   for (int i = 0; i < ANSI_ROW_SLOTS; ++i)
+      ansi->rows[i].row = -1;
+
+   return ansi;
+}
+
+/**
+ * @brief Release the cached rows.  The source is not affected.
+ */
+EXPORT void pager_ansi_destroy(PANSI *ansi)
+{
+   for (int i = 0; i < ANSI_ROW_SLOTS; ++i)
+   {
+      free(ansi->rows[i].text);
+      free(ansi->rows[i].runs);
+   }
+
+   free(ansi->rows);
+   free(ansi->spans);
+   free(ansi);
+}
+
+/**
+ * @brief Drop cached rows whose text has changed.
+ */
+EXPORT void pager_ansi_invalidate(PANSI *ansi, int first, int last)
+{
+   for (int i = 0; i < ANSI_ROW_SLOTS; ++i)
+   {
+      AROW *slot = &ansi->rows[i];
+      if (slot->row >= first && slot->row <= last)
+         slot->row = -1;
+   }
+}
+
+/**
+ * @brief @ref pwb_print_line function for text with escape sequences.
+ *
+ * The @p data_source must be a @ref PANSI.  The row is written from
+ * the current horizontal position, see @ref pager_ansi_right.
+ */
+EXPORT int pager_ansi_printer(int row_index,
+                              int indicated,
+                              int length,
+                              void *data_source,
+                              void *data_extra)
+{
+   PANSI *ansi = (PANSI*)data_source;
+   const AROW *parsed = get_row(ansi, row_index);
+   if (parsed == NULL)
+      return pager_write_spans(NULL, 0, length, indicated);
+
+   if (parsed->run_count > ansi->spans_size)
+   {
+      int size = ansi->spans_size ? ansi->spans_size : 16;
+      while (size < parsed->run_count)
+         size *= 2;
+
+      PSPAN *spans = (PSPAN*)realloc(ansi->spans, sizeof(PSPAN) * size);
+      if (spans == NULL)
+         return pager_write_spans(NULL, 0, length, indicated);
+
+      ansi->spans = spans;
+      ansi->spans_size = size;
+   }
+
+   // Cut the runs to the visible columns:
+   int left = ansi->column_first;
+   int right = left + length;
+   int count = 0;
+
+   for (int i = 0; i < parsed->run_count; ++i)
+   {
+      int start = parsed->runs[i].start;
+      int end = i + 1 < parsed->run_count ? parsed->runs[i + 1].start : parsed->len;
+
+      if (start < left)
+         start = left;
+      if (end > right)
+         end = right;
+      if (start >= end)
+         continue;
+
+      PSPAN *span = &ansi->spans[count++];
+      span->text = parsed->text + start;
+      span->len = end - start;
+      span->style = parsed->runs[i].style;
+   }
+
+   return pager_write_spans(ansi->spans, count, length, indicated);
+}
+
+/**
+ * @brief Shift the view half a screen to the right.
+ *
+ * Stops when the widest visible row is fully shown.
+ */
+EXPORT ARV pager_ansi_right(DPARMS *parms)
+{
+   assert(parms->printer == pager_ansi_printer);
+   PANSI *ansi = (PANSI*)parms->data_source;
+
+   int width = visible_width(ansi, parms);
+   if (ansi->column_first + parms->chars_count >= width)
+      return ARV_CONTINUE;
+
+   int step = parms->chars_count / 2;
+   ansi->column_first += step > 0 ? step : 1;
+   return ARV_REPLOT_DATA;
+}
+
+/**
+ * @brief Shift the view half a screen to the left.
+ */
+EXPORT ARV pager_ansi_left(DPARMS *parms)
+{
+   assert(parms->printer == pager_ansi_printer);
+   PANSI *ansi = (PANSI*)parms->data_source;
+
+   if (ansi->column_first == 0)
+      return ARV_CONTINUE;
+
+   int step = parms->chars_count / 2;
+   ansi->column_first -= step > 0 ? step : 1;
+   if (ansi->column_first < 0)
+      ansi->column_first = 0;
+   return ARV_REPLOT_DATA;
+}
+
+/** @} */
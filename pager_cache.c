@@ -0,0 +1,481 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>     // for getenv(), malloc/free
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>     // for getpid(), unlink(), pread(), pwrite()
+#include <fcntl.h>
+#include <sys/stat.h>   // for mkdir()
+
+#include "export.h"
+#include "pager.h"
+#include "pager_cache.h"
+
+/**
+ * @brief Directory in which cache files are saved, empty if disabled.
+ *
+ * The cache is disabled until enabled either by calling
+ * @ref pager_set_cache_dir or by setting environment variable
+ * `PAGER_CACHE_DIR`.
+ */
+static char cache_dir[512] = "";
+static bool cache_dir_checked = false;
+
+/**
+ * @brief Set directory for cached terminal profiles and file indexes.
+ * @param "path"  directory to use, or NULL to disable the cache.
+ * @return *true* if the directory is usable, *false* if not (cache disabled)
+ *
+ * The directory will be created if it doesn't exist.
+ */
+EXPORT bool pager_set_cache_dir(const char *path)
+{
+   cache_dir_checked = true;
+   cache_dir[0] = '\0';
+
+   if (path == NULL || *path == '\0')
+      return false;
+
+   if (strlen(path) >= sizeof(cache_dir))
+      return false;
+
+   if (mkdir(path, 0775) && errno != EEXIST)
+      return false;
+
+   strcpy(cache_dir, path);
+   return true;
+}
+
+/**
+ * @brief Return the cache directory, NULL if caching is disabled.
+ */
+const char *pcache_dir(void)
+{
+   if (!cache_dir_checked)
+      pager_set_cache_dir(getenv("PAGER_CACHE_DIR"));
+
+   return cache_dir[0] ? cache_dir : NULL;
+}
+
+/**
+ * @brief Build the path of a cache file.
+ * @param "buff"    buffer to which the path will be written
+ * @param "bufflen" size of @p buff
+ * @param "kind"    prefix identifying the type of cached data
+ * @param "key"     identifying name of the cached data
+ * @return *true* if the path was built, *false* if caching is
+ *         disabled, @p key is unsafe, or the path doesn't fit.
+ */
+bool pcache_path(char *buff, int bufflen, const char *kind, const char *key)
+{
+   const char *dir = pcache_dir();
+   if (dir == NULL || key == NULL || *key == '\0')
+      return false;
+
+   // Refuse keys that could escape the cache directory:
+   if (strchr(key, '/') || strcmp(key, "..") == 0)
+      return false;
+
+   int len = snprintf(buff, bufflen, "%s/%s-%s", dir, kind, key);
+   return len > 0 && len < bufflen;
+}
+
+/** @brief Identifies a cached index file */
+#define INDEX_MAGIC "libpager-index"
+
+/** @brief Changes when the layout of cached indexes changes */
+#define INDEX_VERSION 1
+
+/** @brief Bytes hashed at each end of the indexed part of a file */
+#define INDEX_SAMPLE 4096
+
+/**
+ * @brief Start of a cached index file, identifying the indexed file.
+ *
+ * The cache file is named for the device and inode of the file, and
+ * the rest tells if the file is unchanged, has grown, or was replaced.
+ */
+typedef struct index_header {
+   char magic[16];
+   uint32_t version;
+   uint32_t word_size;      ///< sizeof(size_t) of the writer
+   uint64_t device;
+   uint64_t inode;
+   uint64_t size;           ///< bytes of the file indexed
+   int64_t mtime_sec;
+   int64_t mtime_nsec;
+   uint64_t fingerprint;    ///< hash of the first and last bytes indexed
+   uint64_t payload;        ///< bytes of index following the header
+} INDEXHEADER;
+
+/**
+ * @brief Build the path of the cached index of a file.
+ */
+static bool index_path(char *buff, int bufflen, const char *kind, const MFILE *file)
+{
+   char key[64];
+   snprintf(key, sizeof(key), "%llx-%llx",
+            (unsigned long long)file->device,
+            (unsigned long long)file->inode);
+
+   return pcache_path(buff, bufflen, kind, key);
+}
+
+/**
+ * @brief Hash the first and last bytes of the first @p size bytes of
+ *        a file, to notice a file that was rewritten rather than grown.
+ */
+static uint64_t fingerprint(const MFILE *file, size_t size)
+{
+   uint64_t hash = 14695981039346656037ull;   // FNV-1a
+   size_t sample = size < INDEX_SAMPLE ? size : INDEX_SAMPLE;
+   if (sample == 0)
+      return hash;
+
+   const unsigned char *ranges[2] = {
+      (const unsigned char*)file->data,
+      (const unsigned char*)file->data + size - sample
+   };
+
+   for (int i = 0; i < 2; ++i)
+      for (size_t j = 0; j < sample; ++j)
+      {
+         hash ^= ranges[i][j];
+         hash *= 1099511628211ull;
+      }
+
+   return hash;
+}
+
+/**
+ * @brief Map the cached index of a file.
+ * @param "index"  [out] the mapped index
+ * @param "kind"   type of index, naming the cache file
+ * @param "file"   the indexed file
+ * @return *true* if an index was found for the file as it is, or as
+ *         it was before it grew, *false* if not or caching is disabled.
+ *
+ * A file of the size indexed but changed since is not matched, so its
+ * index is rebuilt.
+ *
+ * If the file has grown, @p index->complete is *false* and the index
+ * covers the first @p index->indexed bytes of the file, so only the
+ * rest need be indexed.  Release the index with @ref pcache_index_close.
+ */
+bool pcache_index_open(PCINDEX *index, const char *kind, const MFILE *file)
+{
+   memset(index, 0, sizeof(PCINDEX));
+
+   char path[512];
+   if (!index_path(path, sizeof(path), kind, file) || !mfile_open(&index->map, path))
+      return false;
+
+   const INDEXHEADER *header = (const INDEXHEADER*)index->map.data;
+
+   // A file of the same size that was changed may have been edited
+   // anywhere, so only a larger file counts as grown:
+   if (index->map.size < sizeof(INDEXHEADER)
+       || strcmp(header->magic, INDEX_MAGIC) != 0
+       || header->version != INDEX_VERSION
+       || header->word_size != sizeof(size_t)
+       || header->device != (uint64_t)file->device
+       || header->inode != (uint64_t)file->inode
+       || header->payload != index->map.size - sizeof(INDEXHEADER)
+       || header->size > file->size
+       || (header->size == file->size
+           && (header->mtime_sec != (int64_t)file->mtime.tv_sec
+               || header->mtime_nsec != (int64_t)file->mtime.tv_nsec))
+       || fingerprint(file, header->size) != header->fingerprint)
+   {
+      pcache_index_close(index);
+      return false;
+   }
+
+   index->data = index->map.data + sizeof(INDEXHEADER);
+   index->size = header->payload;
+   index->indexed = header->size;
+   index->complete = header->size == file->size;
+
+   return true;
+}
+
+/**
+ * @brief Unmap a cached index opened with @ref pcache_index_open.
+ */
+void pcache_index_close(PCINDEX *index)
+{
+   mfile_close(&index->map);
+   memset(index, 0, sizeof(PCINDEX));
+}
+
+/**
+ * @brief Fill the header of the index of a file as it is now.
+ */
+static void fill_header(INDEXHEADER *header, const MFILE *file, size_t payload)
+{
+   memset(header, 0, sizeof(INDEXHEADER));
+   strcpy(header->magic, INDEX_MAGIC);
+   header->version = INDEX_VERSION;
+   header->word_size = sizeof(size_t);
+   header->device = file->device;
+   header->inode = file->inode;
+   header->size = file->size;
+   header->mtime_sec = file->mtime.tv_sec;
+   header->mtime_nsec = file->mtime.tv_nsec;
+   header->fingerprint = fingerprint(file, file->size);
+   header->payload = payload;
+}
+
+/**
+ * @brief Save the index of a file in the cache.
+ * @param "kind"   type of index, naming the cache file
+ * @param "file"   the indexed file, all of which is indexed
+ * @param "parts"  pieces of the index, saved one after the other
+ * @param "count"  number of elements in @p parts
+ * @return *true* if saved, *false* if caching is disabled or the
+ *         file couldn't be written.
+ *
+ * The index is written to a temporary file that then replaces the
+ * old one, so a mapping of the old index remains valid.
+ */
+bool pcache_index_save(const char *kind, const MFILE *file, const PCPART *parts, int count)
+{
+   char path[512], temp[540];
+   if (!index_path(path, sizeof(path), kind, file))
+      return false;
+
+   snprintf(temp, sizeof(temp), "%s.%d", path, (int)getpid());
+
+   size_t payload = 0;
+   for (int i = 0; i < count; ++i)
+      payload += parts[i].len;
+
+   INDEXHEADER header;
+   fill_header(&header, file, payload);
+
+   FILE *f = fopen(temp, "w");
+   if (f == NULL)
+      return false;
+
+   bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+   for (int i = 0; ok && i < count; ++i)
+      ok = parts[i].len == 0 || fwrite(parts[i].data, parts[i].len, 1, f) == 1;
+
+   if (fclose(f))
+      ok = false;
+
+   if (ok && rename(temp, path) == 0)
+      return true;
+
+   unlink(temp);
+   return false;
+}
+
+static bool write_at(int fd, const void *data, size_t len, off_t offset)
+{
+   const char *ptr = (const char*)data;
+   while (len > 0)
+   {
+      ssize_t written = pwrite(fd, ptr, len, offset);
+      if (written < 0)
+      {
+         if (errno == EINTR)
+            continue;
+         return false;
+      }
+
+      ptr += written;
+      len -= written;
+      offset += written;
+   }
+
+   return true;
+}
+
+/**
+ * @brief Copy bytes from one file to the same place in another.
+ */
+static bool copy_at(int from, int to, off_t offset, size_t len)
+{
+   char buff[65536];
+   while (len > 0)
+   {
+      size_t want = len < sizeof(buff) ? len : sizeof(buff);
+      ssize_t got = pread(from, buff, want, offset);
+      if (got < 0 && errno == EINTR)
+         continue;
+      if (got <= 0 || !write_at(to, buff, got, offset))
+         return false;
+
+      offset += got;
+      len -= got;
+   }
+
+   return true;
+}
+
+/**
+ * @brief Extend the cached index of a file that has grown.
+ * @param "kind"    type of index, naming the cache file
+ * @param "file"    the indexed file, all of which is now indexed
+ * @param "offset"  where in the saved index to write @p parts,
+ *                  replacing what follows
+ * @param "parts"   pieces of the index, saved one after the other
+ * @param "count"   number of elements in @p parts
+ * @return *true* if saved, *false* if caching is disabled or the
+ *         file couldn't be written.
+ *
+ * The saved index before @p offset is copied rather than rebuilt, so
+ * growing a large file costs little more than indexing what was
+ * added.  As in @ref pcache_index_save, the index is written to a
+ * temporary file that then replaces the old one, so another process
+ * can keep using its mapping of the old index.
+ */
+bool pcache_index_extend(const char *kind, const MFILE *file, size_t offset,
+                         const PCPART *parts, int count)
+{
+   char path[512], temp[540];
+   if (!index_path(path, sizeof(path), kind, file))
+      return false;
+
+   snprintf(temp, sizeof(temp), "%s.%d", path, (int)getpid());
+
+   int old = open(path, O_RDONLY);
+   if (old < 0)
+      return false;
+
+   int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+   if (fd < 0)
+   {
+      close(old);
+      return false;
+   }
+
+   off_t at = sizeof(INDEXHEADER) + offset;
+   bool ok = copy_at(old, fd, sizeof(INDEXHEADER), offset);
+   close(old);
+
+   for (int i = 0; ok && i < count; ++i)
+   {
+      ok = write_at(fd, parts[i].data, parts[i].len, at);
+      at += parts[i].len;
+   }
+
+   INDEXHEADER header;
+   fill_header(&header, file, at - sizeof(INDEXHEADER));
+   ok = ok && write_at(fd, &header, sizeof(header), 0);
+
+   if (close(fd))
+      ok = false;
+
+   if (ok && rename(temp, path) == 0)
+      return true;
+
+   unlink(temp);
+   return false;
+}
+
+/**
+ * @brief Use a cached array of offsets if it covers the whole file.
+ */
+static bool map_offsets(PCOFFSETS *offsets, PCINDEX *index)
+{
+   if (!index->complete)
+      return false;
+
+   offsets->index = *index;
+   offsets->starts = (size_t*)index->data;
+   offsets->count = (int)(index->size / sizeof(size_t));
+   return true;
+}
+
+/**
+ * @brief Load the offsets of the records of a file, using its cached
+ *        index if there is one, and save the index to the cache.
+ * @param "offsets"  [out] the offsets, to be released with
+ *                   @ref pcache_offsets_release
+ * @param "kind"     type of index, naming the cache file
+ * @param "file"     the file whose records are found
+ * @param "scan"     finds the records of @p file
+ * @param "source"   passed to @p scan
+ * @return *true* if loaded, *false* if out of memory.
+ *
+ * The index of an unchanged file is used where it is mapped.  If the
+ * file has grown, only its new records are found, from the start of
+ * the last saved record, which may have grown too.  They are added
+ * to the cached index, which is then mapped again.
+ */
+bool pcache_offsets_load(PCOFFSETS *offsets, const char *kind, const MFILE *file,
+                         pcache_scan scan, void *source)
+{
+   memset(offsets, 0, sizeof(PCOFFSETS));
+
+   PCINDEX index;
+   int count = 0;
+
+   if (!pcache_index_open(&index, kind, file))
+   {
+      offsets->starts = (*scan)(source, NULL, &count);
+      if (offsets->starts == NULL)
+         return false;
+
+      offsets->count = count;
+      PCPART part = { offsets->starts, sizeof(size_t) * count };
+      pcache_index_save(kind, file, &part, 1);
+      return true;
+   }
+
+   if (map_offsets(offsets, &index))
+      return true;
+
+   const size_t *saved = (const size_t*)index.data;
+   int saved_count = (int)(index.size / sizeof(size_t));
+   size_t *starts = NULL;
+   size_t offset = 0;
+
+   if (saved_count > 0 && (starts = (size_t*)malloc(sizeof(size_t))))
+   {
+      starts[0] = saved[saved_count - 1];
+      offset = sizeof(size_t) * (saved_count - 1);
+      count = 1;
+   }
+
+   pcache_index_close(&index);
+
+   size_t *added = (*scan)(source, starts, &count);
+   if (added == NULL)
+      return false;
+
+   PCPART part = { added, sizeof(size_t) * count };
+   bool mapped = pcache_index_extend(kind, file, offset, &part, 1)
+      && pcache_index_open(&index, kind, file);
+
+   if (mapped && !map_offsets(offsets, &index))
+   {
+      pcache_index_close(&index);
+      mapped = false;
+   }
+
+   free(added);
+   if (mapped)
+      return true;
+
+   // Without the cache, scan the whole file:
+   count = 0;
+   offsets->starts = (*scan)(source, NULL, &count);
+   offsets->count = count;
+   return offsets->starts != NULL;
+}
+
+/**
+ * @brief Release offsets loaded by @ref pcache_offsets_load.
+ */
+void pcache_offsets_release(PCOFFSETS *offsets)
+{
+   if (offsets->index.map.data)
+      pcache_index_close(&offsets->index);
+   else
+      free(offsets->starts);
+
+   memset(offsets, 0, sizeof(PCOFFSETS));
+}
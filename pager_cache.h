@@ -0,0 +1,62 @@
+#ifndef PAGER_CACHE_H
+#define PAGER_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "pager_mfile.h"
+
+const char *pcache_dir(void);
+bool pcache_path(char *buff, int bufflen, const char *kind, const char *key);
+
+/**
+ * @brief An index of a file saved in the cache, mapped into memory.
+ */
+typedef struct pcache_index {
+   MFILE map;               ///< the mapped cache file
+   const char *data;        ///< saved index, following the header
+   size_t size;             ///< bytes of @p data
+   size_t indexed;          ///< bytes of the file covered by the index
+   bool complete;           ///< *false* if the file has grown since
+} PCINDEX;
+
+/**
+ * @brief A piece of an index to be saved, see @ref pcache_index_save.
+ */
+typedef struct pcache_part {
+   const void *data;
+   size_t len;
+} PCPART;
+
+bool pcache_index_open(PCINDEX *index, const char *kind, const MFILE *file);
+void pcache_index_close(PCINDEX *index);
+bool pcache_index_save(const char *kind, const MFILE *file, const PCPART *parts, int count);
+bool pcache_index_extend(const char *kind, const MFILE *file, size_t offset,
+                         const PCPART *parts, int count);
+
+/**
+ * @brief Find the offsets of the records of a file.
+ * @param "source"  passed to @ref pcache_offsets_load
+ * @param "starts"  offsets found before the file grew, allocated with
+ *                  malloc, or NULL to scan the whole file.  Scanning
+ *                  resumes at the last.
+ * @param "count"   [in,out] number of offsets in @p starts
+ * @return the offsets, in @p starts enlarged or a new array, or NULL
+ *         if out of memory, when @p starts has been released.
+ */
+typedef size_t *(*pcache_scan)(void *source, size_t *starts, int *count);
+
+/**
+ * @brief Offsets of the records of a file, see @ref pcache_offsets_load.
+ */
+typedef struct pcache_offsets {
+   size_t *starts;          ///< offset of each record
+   int count;               ///< records in the file
+   PCINDEX index;           ///< cached index holding @p starts, if mapped
+} PCOFFSETS;
+
+bool pcache_offsets_load(PCOFFSETS *offsets, const char *kind, const MFILE *file,
+                         pcache_scan scan, void *source);
+void pcache_offsets_release(PCOFFSETS *offsets);
+
+#endif
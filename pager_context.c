@@ -0,0 +1,586 @@
+#include <stdlib.h>     // malloc/free
+#include <string.h>
+#include <unistd.h>     // pipe(), read(), write()
+#include <fcntl.h>
+#include <limits.h>     // INT_MAX
+#include <pthread.h>
+#include <assert.h>
+
+#include "export.h"
+#include "termstuff.h"
+#include "pager.h"
+#include "pager_private.h"
+
+/**
+ * @brief Command posted to a pager context from any thread.
+ *
+ * Commands are linked into an intrusive multi-producer,
+ * single-consumer queue (after Dmitry Vyukov's design): producers
+ * atomically exchange the @p head pointer and link the previous
+ * head to the new node, and the UI thread alone consumes from
+ * @p tail.  Neither side takes a lock, so producers never wait on
+ * the UI thread or on terminal I/O.
+ */
+typedef enum pager_command_type {
+   PCMD_STUB = 0,
+   PCMD_INVALIDATE,
+   PCMD_ROW_COUNT,
+   PCMD_ACTION,
+   PCMD_COUNT
+} PCMD_TYPE;
+
+/** @brief State of a background count, in the @p last of a PCMD_COUNT */
+enum pager_count_state {
+   PCOUNT_RUNNING = 0,
+   PCOUNT_DONE,
+   PCOUNT_CANCELLED
+};
+
+typedef struct pager_command {
+   struct pager_command *next;
+   PCMD_TYPE type;
+   int first;               ///< first row, or new row count
+   int last;                ///< last row of an invalidation, or count state
+   PACTION action;          ///< navigation action to run on the UI thread
+} PCMD;
+
+struct pager_context {
+   DPARMS parms;
+   PSTATS stats;
+
+   PCMD *head;              ///< most recently posted command (producers)
+   PCMD *tail;              ///< oldest unconsumed command (UI thread)
+   PCMD stub;               ///< placeholder keeping the queue non-empty
+
+   int wake_fds[2];         ///< pipe to wake a UI thread waiting on input
+   int wake_pending;        ///< set when a wake byte is in the pipe
+
+   pthread_mutex_t extend_lock;  ///< held while calling the extend function
+   int extended;            ///< rows made available, guarded by @p extend_lock
+
+   pthread_t count_thread;
+   pager_extend count_extend;    ///< extend function used by the count thread
+   bool counting;           ///< count thread started and not yet joined
+   bool end_pending;        ///< move the focus to the end when counted
+   int count_cancel;        ///< set to stop the count thread
+   pager_progress progress; ///< shows the progress of a count, may be NULL
+};
+
+/**
+ * @brief Link a command into the queue.  Safe from any thread.
+ */
+static void queue_push(PCONTEXT *ctx, PCMD *cmd)
+{
+   __atomic_store_n(&cmd->next, NULL, __ATOMIC_RELAXED);
+   PCMD *prev = __atomic_exchange_n(&ctx->head, cmd, __ATOMIC_ACQ_REL);
+   __atomic_store_n(&prev->next, cmd, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Unlink the oldest command.  Only for the UI thread.
+ * @return the command, or NULL if the queue is empty or a producer
+ *         has not yet finished linking its command.
+ */
+static PCMD *queue_pop(PCONTEXT *ctx)
+{
+   PCMD *tail = ctx->tail;
+   PCMD *next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+   if (tail == &ctx->stub)
+   {
+      if (next == NULL)
+         return NULL;
+
+      ctx->tail = tail = next;
+      next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+   }
+
+   if (next)
+   {
+      ctx->tail = next;
+      return tail;
+   }
+
+   // tail is the last node, unless a producer is mid-push:
+   if (tail != __atomic_load_n(&ctx->head, __ATOMIC_ACQUIRE))
+      return NULL;
+
+   // Re-add the stub so the last real node can be released:
+   queue_push(ctx, &ctx->stub);
+
+   next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+   if (next)
+   {
+      ctx->tail = next;
+      return tail;
+   }
+
+   return NULL;
+}
+
+/**
+ * @brief Allocate and post a command, then wake the UI thread.
+ */
+static bool post_command(PCONTEXT *ctx, PCMD_TYPE type, int first, int last, PACTION action)
+{
+   PCMD *cmd = (PCMD*)malloc(sizeof(PCMD));
+   if (cmd == NULL)
+      return false;
+
+   cmd->type = type;
+   cmd->first = first;
+   cmd->last = last;
+   cmd->action = action;
+   queue_push(ctx, cmd);
+
+   // Only the first post since the last apply needs to signal:
+   if (__atomic_exchange_n(&ctx->wake_pending, 1, __ATOMIC_ACQ_REL) == 0)
+   {
+      char byte = 1;
+      if (write(ctx->wake_fds[1], &byte, 1) < 0)
+         __atomic_store_n(&ctx->wake_pending, 0, __ATOMIC_RELEASE);
+   }
+
+   return true;
+}
+
+/**
+ * @brief Thread that calls the extend function until the source ends.
+ *
+ * Each step is posted as a PCMD_COUNT, so the UI thread can show
+ * the progress while the rows are counted.
+ */
+static void *count_rows(void *arg)
+{
+   PCONTEXT *ctx = (PCONTEXT*)arg;
+   void *data_source = ctx->parms.data_source;
+   int state = PCOUNT_RUNNING;
+   int rows = 0;
+
+   while (state == PCOUNT_RUNNING)
+   {
+      if (__atomic_load_n(&ctx->count_cancel, __ATOMIC_ACQUIRE))
+      {
+         state = PCOUNT_CANCELLED;
+         break;
+      }
+
+      pthread_mutex_lock(&ctx->extend_lock);
+      int known = ctx->extended;
+      int wanted = known > INT_MAX - PAGER_COUNT_STEP ? INT_MAX : known + PAGER_COUNT_STEP;
+      rows = wanted > known ? (*ctx->count_extend)(data_source, known, wanted) : known;
+      if (rows < known)
+         rows = known;
+      ctx->extended = rows;
+      pthread_mutex_unlock(&ctx->extend_lock);
+
+      if (rows < wanted || rows == INT_MAX)
+         state = PCOUNT_DONE;
+      else
+         post_command(ctx, PCMD_COUNT, rows, PCOUNT_RUNNING, NULL);
+   }
+
+   // The final state must arrive, or the thread won't be joined:
+   while (!post_command(ctx, PCMD_COUNT, rows, state, NULL))
+      usleep(1000);
+
+   return NULL;
+}
+
+/**
+ * @brief Wait for the count thread after it has finished.
+ */
+static void join_count(PCONTEXT *ctx)
+{
+   if (ctx->counting)
+   {
+      pthread_join(ctx->count_thread, NULL);
+      ctx->counting = false;
+   }
+}
+
+/**
+ * @brief Apply a step of a background count.  UI thread only.
+ * @return *true* if the pager must be replotted.
+ */
+static bool apply_count(PCONTEXT *ctx, int rows, int state, bool *exit_requested)
+{
+   DPARMS *parms = &ctx->parms;
+   bool replot = false;
+
+   // Replot only if the new rows fill empty lines:
+   if (rows > parms->row_count)
+   {
+      replot = parms->row_count < parms->index_row_top + parms->line_count;
+      parms->row_count = rows;
+   }
+
+   if (state != PCOUNT_RUNNING)
+   {
+      join_count(ctx);
+
+      if (state == PCOUNT_DONE)
+         parms->extend = NULL;
+   }
+
+   if (ctx->progress)
+      (*ctx->progress)(parms, rows, state != PCOUNT_RUNNING);
+
+   if (state == PCOUNT_DONE && ctx->end_pending)
+   {
+      ctx->end_pending = false;
+      switch(pager_focus_end(parms))
+      {
+         case ARV_REPLOT_DATA: replot = true; break;
+         case ARV_EXIT: *exit_requested = true; break;
+         default: break;
+      }
+   }
+   else if (state == PCOUNT_CANCELLED && ctx->end_pending)
+   {
+      // pager_focus_end was called again after cancelling:
+      ctx->end_pending = pager_context_count(ctx);
+   }
+
+   return replot;
+}
+
+/**
+ * @brief Extend the rows from the UI thread, see pager_extend_rows().
+ *
+ * If the count thread is calling the extend function, the rows it
+ * is adding will soon be posted, so the UI thread doesn't wait.
+ */
+void pager_context_extend(PCONTEXT *ctx, int wanted)
+{
+   DPARMS *parms = &ctx->parms;
+
+   if (pthread_mutex_trylock(&ctx->extend_lock))
+      return;
+
+   int known = ctx->extended > parms->row_count ? ctx->extended : parms->row_count;
+   int rows = known;
+   if (wanted > known)
+   {
+      rows = (*parms->extend)(parms->data_source, known, wanted);
+      if (rows < known)
+         rows = known;
+   }
+   ctx->extended = rows;
+   pthread_mutex_unlock(&ctx->extend_lock);
+
+   if (rows > parms->row_count)
+      parms->row_count = rows;
+
+   // A running count will find the end itself:
+   if (rows < wanted && !ctx->counting)
+      parms->extend = NULL;
+}
+
+/**
+ * @brief Start counting the rows in the background.  UI thread only.
+ * @return *true* if the count is running, *false* if a thread
+ *         couldn't be started.
+ *
+ * The focus moves to the last row when the count is done.
+ */
+bool pager_context_count(PCONTEXT *ctx)
+{
+   if (!ctx->counting)
+   {
+      if (ctx->extended < ctx->parms.row_count)
+         ctx->extended = ctx->parms.row_count;
+
+      ctx->count_extend = ctx->parms.extend;
+      __atomic_store_n(&ctx->count_cancel, 0, __ATOMIC_RELEASE);
+
+      if (pthread_create(&ctx->count_thread, NULL, count_rows, ctx))
+         return false;
+
+      ctx->counting = true;
+   }
+
+   ctx->end_pending = true;
+   return true;
+}
+
+/**
+ * @defgroup PAGER_CONTEXT Thread-safe pager context
+ * @brief A pager context owns a @ref DPARMS and a command queue.
+ *
+ * Any thread can post commands to the context.  The UI thread
+ * applies them in a batch, with @ref pager_context_apply, before
+ * drawing each frame.
+ * @{
+ */
+
+/**
+ * @brief Create a pager context.  Call @ref pager_init first.
+ * @param "data_source" pointer to datasource to be used for content
+ * @param "row_count"   number of records/rows in data source
+ * @param "printer"     function to be used for printing lines
+ * @param "data_extra"  optional, application-specific data
+ * @return new context, or NULL if out of memory.  Release the
+ *         context with @ref pager_context_destroy.
+ */
+EXPORT PCONTEXT *pager_context_create(void *data_source,
+                                      int row_count,
+                                      pwb_print_line printer,
+                                      void *data_extra)
+{
+   PCONTEXT *ctx = (PCONTEXT*)malloc(sizeof(PCONTEXT));
+   if (ctx == NULL)
+      return NULL;
+
+   memset(ctx, 0, sizeof(PCONTEXT));
+
+   if (pipe(ctx->wake_fds))
+   {
+      free(ctx);
+      return NULL;
+   }
+
+   fcntl(ctx->wake_fds[0], F_SETFL, O_NONBLOCK);
+   fcntl(ctx->wake_fds[1], F_SETFL, O_NONBLOCK);
+
+   ctx->head = ctx->tail = &ctx->stub;
+   pthread_mutex_init(&ctx->extend_lock, NULL);
+
+   pager_init_dparms(&ctx->parms, data_source, row_count, printer, data_extra);
+   ctx->parms.context = ctx;
+
+   return ctx;
+}
+
+/**
+ * @brief Release a context and any commands left in its queue.
+ *
+ * No other thread may post to the context once this is called.
+ * A background count is cancelled.
+ */
+EXPORT void pager_context_destroy(PCONTEXT *ctx)
+{
+   __atomic_store_n(&ctx->count_cancel, 1, __ATOMIC_RELEASE);
+   join_count(ctx);
+   pthread_mutex_destroy(&ctx->extend_lock);
+
+   PCMD *cmd;
+   while ((cmd = queue_pop(ctx)))
+      free(cmd);
+
+   close(ctx->wake_fds[0]);
+   close(ctx->wake_fds[1]);
+   free(ctx);
+}
+
+/**
+ * @brief Access the display parameters of the context.
+ *
+ * Only the UI thread should use the returned pointer, for example
+ * to set margins or to pass to a @ref PACTION.
+ */
+EXPORT DPARMS *pager_context_dparms(PCONTEXT *ctx)
+{
+   return &ctx->parms;
+}
+
+/**
+ * @brief File descriptor that becomes readable when commands are posted.
+ *
+ * Add this to the `poll` or `select` set of the UI thread to wake
+ * it when other threads post commands.
+ */
+EXPORT int pager_context_wake_fd(const PCONTEXT *ctx)
+{
+   return ctx->wake_fds[0];
+}
+
+/**
+ * @brief Post notice that rows have changed.  Safe from any thread.
+ * @param "ctx"    context to be notified
+ * @param "first"  index of first changed row
+ * @param "last"   index of last changed row
+ * @return *true* if posted, *false* if out of memory
+ *
+ * This is the thread-safe form of @ref pager_invalidate_rows.  The
+ * rows are marked when the commands are applied, and redrawn with
+ * the rest of the update.
+ */
+EXPORT bool pager_post_invalidate(PCONTEXT *ctx, int first, int last)
+{
+   return post_command(ctx, PCMD_INVALIDATE, first, last, NULL);
+}
+
+/**
+ * @brief Post a new row count.  Safe from any thread.
+ *
+ * Pages drawn ahead are discarded when the count is applied, as the
+ * rows may have changed as well as their number.
+ */
+EXPORT bool pager_post_row_count(PCONTEXT *ctx, int row_count)
+{
+   return post_command(ctx, PCMD_ROW_COUNT, row_count, 0, NULL);
+}
+
+/**
+ * @brief Post a navigation action to be run on the UI thread.
+ *        Safe from any thread.
+ * @param "ctx"     context to be notified
+ * @param "action"  any @ref PACTION, for example @ref pager_focus_down_page
+ */
+EXPORT bool pager_post_action(PCONTEXT *ctx, PACTION action)
+{
+   return post_command(ctx, PCMD_ACTION, 0, 0, action);
+}
+
+/**
+ * @brief Apply posted commands and update the screen.  UI thread only.
+ * @return ARV_EXIT if a posted action returned it, otherwise
+ *         ARV_CONTINUE, since the screen will already be updated.
+ *
+ * Commands are applied in a batch, so however many rows were
+ * invalidated, the screen is updated with one write.
+ */
+EXPORT ARV pager_context_apply(PCONTEXT *ctx)
+{
+   DPARMS *parms = &ctx->parms;
+   bool replot = false;
+   bool exit_requested = false;
+
+   // Drain, then clear the wake flag so later posts signal again.  A
+   // command posted between the two finds the flag set and doesn't
+   // write, but is still popped below:
+   char buff[64];
+   while (read(ctx->wake_fds[0], buff, sizeof(buff)) > 0)
+      ;
+   __atomic_store_n(&ctx->wake_pending, 0, __ATOMIC_RELEASE);
+
+   // Collect the output of every action into a single write:
+   pager_select(parms);
+   ti_begin_frame();
+
+   PCMD *cmd;
+   while ((cmd = queue_pop(ctx)))
+   {
+      switch(cmd->type)
+      {
+         case PCMD_INVALIDATE:
+            pager_invalidate_rows(parms, cmd->first, cmd->last);
+            break;
+
+         case PCMD_ROW_COUNT:
+            // New rows, like a filter's new ranking, may reorder those
+            // drawn ahead even if their number is unchanged:
+            pager_prerender_discard(parms, 0, INT_MAX);
+            parms->row_count = cmd->first < 0 ? 0 : cmd->first;
+            if (parms->index_row_focus >= parms->row_count)
+               parms->index_row_focus = parms->row_count ? parms->row_count - 1 : 0;
+            if (parms->index_row_top > parms->index_row_focus)
+               parms->index_row_top = parms->index_row_focus;
+            replot = true;
+            break;
+
+         case PCMD_ACTION:
+         {
+            PTRACE_BEGIN(trace);
+            ARV result = (*cmd->action)(parms);
+            PTRACE_END(trace, "action", "result", result);
+
+            switch(result)
+            {
+               case ARV_REPLOT_DATA: replot = true; break;
+               case ARV_EXIT: exit_requested = true; break;
+               default: break;
+            }
+            break;
+         }
+
+         case PCMD_COUNT:
+            if (apply_count(ctx, cmd->first, cmd->last, &exit_requested))
+               replot = true;
+            break;
+
+         default:
+            break;
+      }
+
+      free(cmd);
+   }
+
+   if (replot)
+      pager_plot(parms);
+   else
+      pager_plot_dirty(parms);
+
+   ti_end_frame();
+
+   return exit_requested ? ARV_EXIT : ARV_CONTINUE;
+}
+
+/**
+ * @brief Start or stop collecting statistics for the context.  UI thread only.
+ *
+ * Statistics are only available if the library was built with
+ * `PAGER_STATS` defined.  Counting resumes where it stopped.
+ */
+EXPORT void pager_context_enable_stats(PCONTEXT *ctx, bool enable)
+{
+   ctx->parms.stats = enable ? &ctx->stats : NULL;
+}
+
+/**
+ * @brief Set a function to show the progress of a background count.
+ *        UI thread only.
+ *
+ * The function is called by @ref pager_context_apply, within the
+ * screen update, as each block of rows is counted.  It might write
+ * the count in a margin of the pager.
+ */
+EXPORT void pager_context_set_progress(PCONTEXT *ctx, pager_progress progress)
+{
+   ctx->progress = progress;
+}
+
+/**
+ * @brief Action that stops a background count.  UI thread only.
+ *
+ * Counted rows remain available, and the focus stays where it is.
+ * The length of the source remains unknown, so a later
+ * @ref pager_focus_end counts on from where this stopped.
+ */
+EXPORT ARV pager_cancel_count(DPARMS *parms)
+{
+   PCONTEXT *ctx = parms->context;
+   if (ctx && ctx->counting)
+   {
+      ctx->end_pending = false;
+      __atomic_store_n(&ctx->count_cancel, 1, __ATOMIC_RELEASE);
+   }
+
+   return ARV_CONTINUE;
+}
+
+/**
+ * @brief Copy the statistics of the context.  Safe from any thread.
+ * @param "ctx"       context whose statistics are wanted
+ * @param "snapshot"  struct to which the counters are copied
+ *
+ * Each counter is read atomically, though the set may straddle an
+ * update in progress.  Compare successive snapshots to measure an
+ * interval.
+ */
+EXPORT void pager_context_stats(const PCONTEXT *ctx, PSTATS *snapshot)
+{
+   const PSTATS *stats = &ctx->stats;
+   snapshot->frames = __atomic_load_n(&stats->frames, __ATOMIC_RELAXED);
+   snapshot->bytes_written = __atomic_load_n(&stats->bytes_written, __ATOMIC_RELAXED);
+   snapshot->write_calls = __atomic_load_n(&stats->write_calls, __ATOMIC_RELAXED);
+   snapshot->printer_calls = __atomic_load_n(&stats->printer_calls, __ATOMIC_RELAXED);
+   snapshot->full_replots = __atomic_load_n(&stats->full_replots, __ATOMIC_RELAXED);
+   snapshot->scroll_updates = __atomic_load_n(&stats->scroll_updates, __ATOMIC_RELAXED);
+   snapshot->printer_ns_total = __atomic_load_n(&stats->printer_ns_total, __ATOMIC_RELAXED);
+   snapshot->printer_ns_max = __atomic_load_n(&stats->printer_ns_max, __ATOMIC_RELAXED);
+   snapshot->prerendered = __atomic_load_n(&stats->prerendered, __ATOMIC_RELAXED);
+}
+
+/** @} */
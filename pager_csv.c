@@ -0,0 +1,448 @@
+#include <stdlib.h>     // malloc/free
+#include <string.h>
+#include <assert.h>
+
+#include "export.h"
+#include "pager.h"
+#include "pager_mfile.h"
+#include "pager_cache.h"
+
+/** @brief Records indexed before the first enlargement of the index */
+#define CSV_INDEX_START 4096
+
+/**
+ * @brief Extent of one field of the split record.
+ */
+typedef struct csv_field {
+   const char *begin;
+   const char *end;
+} CSVFIELD;
+
+/**
+ * @brief Identifies the projected field read by a table column.
+ */
+typedef struct csv_column {
+   PCSV *csv;
+   int field;
+   char *title;             ///< copy of the header field, may be NULL
+} CSVCOL;
+
+struct pager_csv {
+   MFILE mfile;
+   char delimiter;
+   bool has_header;
+
+   PCOFFSETS records;       ///< offset of each record, including a header
+
+   CSVCOL *columns;         ///< projected fields, see pager_csv_columns()
+   int column_count;
+
+   int split_record;        ///< record held in @p fields, -1 if none
+   int split_count;         ///< fields of @p split_record that have been split
+   CSVFIELD *fields;        ///< field extents of @p split_record
+   int fields_size;         ///< elements allocated to @p fields
+};
+
+/**
+ * @brief @ref pcache_scan function recording the offset of each
+ *        record, ignoring newlines in quotes.
+ * @param "source"  source whose file is indexed
+ * @param "starts"  offsets of the records of the file before it grew,
+ *                  allocated with malloc, or NULL to index the whole file
+ * @param "found"   [in,out] number of offsets in @p starts
+ *
+ * Only quotes and newlines are examined, with @ref mfile_find_either
+ * skipping over the bytes between them.  A doubled quote inside
+ * a quoted field toggles the quoted state twice, so it needs no
+ * special treatment.
+ *
+ * The last record of the smaller file may have grown too, so
+ * indexing resumes at its start, where no field is quoted.
+ */
+static size_t *index_records(void *source, size_t *starts, int *found)
+{
+   PCSV *csv = (PCSV*)source;
+   int count = *found;
+
+   const char *data = csv->mfile.data;
+   const char *end = data + csv->mfile.size;
+   const char *ptr = data;
+
+   if (count > 0)
+      ptr = data + starts[--count];
+
+   int size = CSV_INDEX_START;
+   while (size < count + 1)
+      size *= 2;
+
+   size_t *sized = (size_t*)realloc(starts, sizeof(size_t) * size);
+   if (sized == NULL)
+   {
+      free(starts);
+      return NULL;
+   }
+   starts = sized;
+
+   bool quoted = false;
+
+   mfile_advise_sequential(&csv->mfile, true);
+
+   if (ptr < end)
+      starts[count++] = ptr - data;
+
+   while (ptr < end)
+   {
+      if (quoted)
+         ptr = mfile_find_either(ptr, end, '"', '"');
+      else
+         ptr = mfile_find_either(ptr, end, '"', '\n');
+
+      if (ptr == end)
+         break;
+
+      if (*ptr++ == '"')
+         quoted = !quoted;
+      else if (ptr < end)
+      {
+         if (count >= size)
+         {
+            size_t *grown = (size_t*)realloc(starts, sizeof(size_t) * size * 2);
+            if (grown == NULL)
+            {
+               free(starts);
+               return NULL;
+            }
+            starts = grown;
+            size *= 2;
+         }
+
+         starts[count++] = ptr - data;
+      }
+   }
+
+   mfile_advise_sequential(&csv->mfile, false);
+
+   *found = count;
+   return starts;
+}
+
+/**
+ * @brief Offset of the end of a record.
+ */
+static size_t record_end(const PCSV *csv, int record)
+{
+   return record + 1 < csv->records.count ? csv->records.starts[record + 1] : csv->mfile.size;
+}
+
+/**
+ * @brief Split a record up to and including field @p last.
+ * @return pointer to the field extents, or NULL if out of memory.
+ *
+ * Fields are only split as far as they are needed, and the most
+ * recent record is kept split, so drawing several fields of a row
+ * reads the record once.  Fields beyond the end of the record
+ * are empty.
+ */
+static const CSVFIELD *split_record(PCSV *csv, int record, int last)
+{
+   if (last >= csv->fields_size)
+   {
+      int size = csv->fields_size ? csv->fields_size : 16;
+      while (size <= last)
+         size *= 2;
+
+      CSVFIELD *fields = (CSVFIELD*)realloc(csv->fields, sizeof(CSVFIELD) * size);
+      if (fields == NULL)
+         return NULL;
+
+      csv->fields = fields;
+      csv->fields_size = size;
+   }
+
+   const char *end = csv->mfile.data + record_end(csv, record);
+   const char *ptr = csv->mfile.data + csv->records.starts[record];
+
+   if (record == csv->split_record)
+   {
+      if (last < csv->split_count)
+         return csv->fields;
+
+      // Continue after the fields already split:
+      ptr = csv->fields[csv->split_count - 1].end;
+   }
+   else
+   {
+      csv->split_record = record;
+      csv->split_count = 0;
+   }
+
+   // Exclude the line ending:
+   if (end > ptr && end[-1] == '\n')
+      --end;
+   if (end > ptr && end[-1] == '\r')
+      --end;
+
+   char delimiter = csv->delimiter;
+
+   for (int index = csv->split_count; index <= last; ++index)
+   {
+      // Step over the delimiter ending the previous field:
+      if (index > 0 && ptr < end)
+         ++ptr;
+
+      CSVFIELD *field = &csv->fields[index];
+      field->begin = ptr;
+
+      if (ptr < end && *ptr == '"')
+      {
+         // Skip the quoted part, where a delimiter is content:
+         ++ptr;
+         while ((ptr = mfile_find_either(ptr, end, '"', '"')) < end)
+         {
+            ++ptr;
+            if (ptr < end && *ptr == '"')
+               ++ptr;
+            else
+               break;
+         }
+      }
+
+      ptr = mfile_find_either(ptr, end, delimiter, delimiter);
+      field->end = ptr;
+   }
+
+   csv->split_count = last + 1;
+   return csv->fields;
+}
+
+/**
+ * @brief Copy a field, removing quotes and replacing control characters.
+ * @return the length of the whole value, as with `snprintf`.
+ */
+static int copy_field(const CSVFIELD *field, char *buff, int bufflen)
+{
+   const char *ptr = field->begin;
+   const char *end = field->end;
+   bool quoted = ptr < end && *ptr == '"';
+   int len = 0;
+
+   if (quoted)
+      ++ptr;
+
+   for (; ptr < end; ++ptr)
+   {
+      char chr = *ptr;
+      if (quoted && chr == '"')
+      {
+         // A doubled quote is a literal quote, otherwise quoting ends:
+         if (ptr + 1 < end && ptr[1] == '"')
+            ++ptr;
+         else
+         {
+            quoted = false;
+            continue;
+         }
+      }
+
+      // Newlines and tabs in a field would disturb the screen:
+      if ((unsigned char)chr < ' ')
+         chr = ' ';
+
+      if (len + 1 < bufflen)
+         buff[len] = chr;
+      ++len;
+   }
+
+   if (bufflen > 0)
+      buff[len < bufflen ? len : bufflen - 1] = '\0';
+
+   return len;
+}
+
+/**
+ * @brief @ref pcol_text function for projected fields.
+ */
+static int csv_field_text(int row_index, char *buff, int bufflen, void *column_data)
+{
+   const CSVCOL *column = (const CSVCOL*)column_data;
+   PCSV *csv = column->csv;
+
+   int record = row_index + (csv->has_header ? 1 : 0);
+   const CSVFIELD *fields = split_record(csv, record, column->field);
+   if (fields == NULL)
+      return copy_field(&(CSVFIELD){ NULL, NULL }, buff, bufflen);
+
+   return copy_field(&fields[column->field], buff, bufflen);
+}
+
+/**
+ * @brief Release the projected columns.
+ */
+static void free_columns(PCSV *csv)
+{
+   for (int i = 0; i < csv->column_count; ++i)
+      free(csv->columns[i].title);
+
+   free(csv->columns);
+   csv->columns = NULL;
+   csv->column_count = 0;
+}
+
+/**
+ * @defgroup CSV_SOURCE Delimited text files
+ * @brief Functions found in `pager_csv.c`
+ *
+ * A CSV or TSV file is mapped into memory and indexed by record.
+ * Fields are only split when a row is drawn, and only as far as the
+ * last projected field.  Draw the file with the table engine, using
+ * columns made by @ref pager_csv_columns.
+ *
+ * If a cache directory is set, see @ref pager_set_cache_dir, the
+ * index is saved there, and reopening the file maps the saved index
+ * instead of reading the file.  If the file has only grown, just the
+ * new records are indexed.
+ * @{
+ */
+
+/**
+ * @brief Map and index a delimited file.
+ * @param "path"        file to open
+ * @param "delimiter"   field separator, `','` for CSV or `'\t'` for TSV
+ * @param "has_header"  *true* if the first record holds column titles
+ * @return new source, or NULL if the file can't be read or out of
+ *         memory.  Release the source with @ref pager_csv_close.
+ *
+ * Records end with a newline that is not inside a quoted field.
+ */
+EXPORT PCSV *pager_csv_open(const char *path, char delimiter, bool has_header)
+{
+   PCSV *csv = (PCSV*)malloc(sizeof(PCSV));
+   if (csv == NULL)
+      return NULL;
+
+   memset(csv, 0, sizeof(PCSV));
+   csv->delimiter = delimiter;
+   csv->has_header = has_header;
+   csv->split_record = -1;
+
+   if (!mfile_open(&csv->mfile, path))
+   {
+      free(csv);
+      return NULL;
+   }
+
+   if (!pcache_offsets_load(&csv->records, "csv", &csv->mfile, index_records, csv))
+   {
+      mfile_close(&csv->mfile);
+      free(csv);
+      return NULL;
+   }
+
+   return csv;
+}
+
+/**
+ * @brief Unmap the file and release the source.
+ *
+ * Destroy any table using the columns of the source first.
+ */
+EXPORT void pager_csv_close(PCSV *csv)
+{
+   free_columns(csv);
+   free(csv->fields);
+   pcache_offsets_release(&csv->records);
+   mfile_close(&csv->mfile);
+   free(csv);
+}
+
+/**
+ * @brief Number of rows in the file, not counting a header.
+ */
+EXPORT int pager_csv_row_count(const PCSV *csv)
+{
+   int count = csv->records.count;
+   if (csv->has_header && count > 0)
+      --count;
+   return count;
+}
+
+/**
+ * @brief Number of fields in the first record of the file.
+ */
+EXPORT int pager_csv_field_count(PCSV *csv)
+{
+   if (csv->records.count == 0)
+      return 0;
+
+   // Split the record a field at a time until reaching its end:
+   const char *end = csv->mfile.data + record_end(csv, 0);
+   int count = 1;
+   for (;;)
+   {
+      const CSVFIELD *fields = split_record(csv, 0, count - 1);
+      if (fields == NULL)
+         return 0;
+
+      const char *field_end = fields[count - 1].end;
+      if (field_end >= end || *field_end != csv->delimiter)
+         break;
+
+      ++count;
+   }
+
+   return count;
+}
+
+/**
+ * @brief Make table columns showing selected fields of the file.
+ * @param "csv"     source whose fields are to be shown
+ * @param "fields"  zero-based numbers of the fields, in display order
+ * @param "count"   number of elements in @p fields and @p defs
+ * @param "defs"    [out] column definitions for @ref pager_table_create
+ * @return *true* if done, *false* if out of memory.
+ *
+ * Fields that are not projected are skipped over without being
+ * copied.  The columns are titled from the header, if the file has
+ * one, and refer to the source, which must outlive the table.
+ * Calling this again replaces the earlier columns, so destroy a
+ * table made from them first.
+ */
+EXPORT bool pager_csv_columns(PCSV *csv, const int *fields, int count, PCOLUMN *defs)
+{
+   free_columns(csv);
+
+   csv->columns = (CSVCOL*)calloc(count, sizeof(CSVCOL));
+   if (csv->columns == NULL)
+      return false;
+
+   csv->column_count = count;
+
+   for (int i = 0; i < count; ++i)
+   {
+      CSVCOL *column = &csv->columns[i];
+      column->csv = csv;
+      column->field = fields[i];
+
+      if (csv->has_header && csv->records.count > 0)
+      {
+         const CSVFIELD *split = split_record(csv, 0, fields[i]);
+         if (split)
+         {
+            int len = copy_field(&split[fields[i]], NULL, 0);
+            column->title = (char*)malloc(len + 1);
+            if (column->title)
+               copy_field(&split[fields[i]], column->title, len + 1);
+         }
+      }
+
+      memset(&defs[i], 0, sizeof(PCOLUMN));
+      defs[i].title = column->title;
+      defs[i].type = PCOL_CALLBACK;
+      defs[i].text = csv_field_text;
+      defs[i].column_data = column;
+   }
+
+   return true;
+}
+
+/** @} */
@@ -0,0 +1,308 @@
+#include <stdlib.h>     // malloc/free
+#include <string.h>
+
+#include "export.h"
+#include "pager.h"
+#include "pager_private.h"
+
+/** @brief Rows kept if @ref pager_fetch_create isn't given a capacity */
+#define FETCH_DEFAULT_CAPACITY 256
+
+struct pager_fetch {
+   PFETCHOPS ops;
+   void *source;
+
+   void **rows;             ///< fetched rows, NULL where none was fetched
+   int first;               ///< index of the row in @p rows[0]
+   int count;               ///< rows in @p rows
+   int capacity;            ///< elements allocated to @p rows
+
+   int shown_top;           ///< page last given to @p ops.show_rows
+   int shown_count;
+};
+
+/**
+ * @brief Give rows back to the source.
+ */
+static void free_rows(PFETCH *fetch, void **rows, int count)
+{
+   if (fetch->ops.free_rows && count > 0)
+      (*fetch->ops.free_rows)(fetch->source, rows, count);
+}
+
+/**
+ * @brief Fetch rows into @p rows, marking those not fetched.
+ */
+static void get_rows(PFETCH *fetch, int first, int count, void **rows)
+{
+   int got = (*fetch->ops.get_rows)(fetch->source, first, count, rows);
+   if (got < 0)
+      got = 0;
+
+   for (int i = got; i < count; ++i)
+      rows[i] = NULL;
+}
+
+/**
+ * @brief Make sure the rows from @p first to @p first + @p count - 1
+ *        are fetched, fetching those missing in one request.
+ * @return *false* if out of memory.
+ *
+ * Rows already fetched are kept if the new rows follow or precede
+ * them, as when the view scrolls, while those furthest from the new
+ * rows are released to stay within the capacity.
+ */
+static bool fetch_rows(PFETCH *fetch, int first, int count)
+{
+   int end = first + count;
+   int have_end = fetch->first + fetch->count;
+
+   if (first >= fetch->first && end <= have_end)
+      return true;
+
+   if (count > fetch->capacity)
+   {
+      void **rows = (void**)realloc(fetch->rows, sizeof(void*) * count);
+      if (rows == NULL)
+         return false;
+
+      fetch->rows = rows;
+      fetch->capacity = count;
+   }
+
+   if (fetch->count > 0 && first >= fetch->first && first <= have_end)
+   {
+      // Scrolling down: fetch what follows, dropping rows at the top
+      int drop = end - fetch->first - fetch->capacity;
+      if (drop > 0)
+      {
+         free_rows(fetch, fetch->rows, drop);
+         memmove(fetch->rows, fetch->rows + drop, sizeof(void*) * (fetch->count - drop));
+         fetch->first += drop;
+         fetch->count -= drop;
+      }
+
+      get_rows(fetch, have_end, end - have_end, fetch->rows + fetch->count);
+      fetch->count = end - fetch->first;
+   }
+   else if (fetch->count > 0 && end >= fetch->first && end <= have_end)
+   {
+      // Scrolling up: fetch what precedes, dropping rows at the bottom
+      int drop = have_end - first - fetch->capacity;
+      if (drop > 0)
+      {
+         fetch->count -= drop;
+         free_rows(fetch, fetch->rows + fetch->count, drop);
+      }
+
+      int added = fetch->first - first;
+      memmove(fetch->rows + added, fetch->rows, sizeof(void*) * fetch->count);
+      get_rows(fetch, first, added, fetch->rows);
+      fetch->first = first;
+      fetch->count += added;
+   }
+   else
+   {
+      free_rows(fetch, fetch->rows, fetch->count);
+      get_rows(fetch, first, count, fetch->rows);
+      fetch->first = first;
+      fetch->count = count;
+   }
+
+   return true;
+}
+
+/**
+ * @defgroup ROW_FETCH Rows fetched in batches
+ * @brief Functions found in `pager_fetch.c`
+ *
+ * A printer that reads its row from a database or server makes a
+ * request for every row drawn.  A @ref PFETCH instead fetches the
+ * rows of each screen update in one request, through the
+ * @p get_rows function of a @ref PFETCHOPS, and hands each row to
+ * the @p print_row function.
+ *
+ * Fetched rows are kept, up to the capacity, so scrolling a row
+ * fetches only the row scrolled into view.
+ *
+ * The @p print_row function and the kept rows are used from the UI
+ * thread, so, as with tables, don't draw a @ref PFETCH ahead with
+ * @ref pager_prerender_start.
+ * @{
+ */
+
+/**
+ * @brief Make a cache of rows to be fetched in batches.
+ * @param "ops"       functions of the source, copied
+ * @param "source"    passed to the functions of @p ops
+ * @param "capacity"  most rows kept, or 0 for 256.  More are kept
+ *                    if a screen update draws more.
+ * @return new cache, or NULL if out of memory.  Release the cache
+ *         with @ref pager_fetch_destroy.
+ */
+EXPORT PFETCH *pager_fetch_create(const PFETCHOPS *ops, void *source, int capacity)
+{
+   PFETCH *fetch = (PFETCH*)calloc(1, sizeof(PFETCH));
+   if (fetch == NULL)
+      return NULL;
+
+   if (capacity <= 0)
+      capacity = FETCH_DEFAULT_CAPACITY;
+
+   fetch->rows = (void**)malloc(sizeof(void*) * capacity);
+   if (fetch->rows == NULL)
+   {
+      free(fetch);
+      return NULL;
+   }
+
+   fetch->ops = *ops;
+   fetch->source = source;
+   fetch->capacity = capacity;
+   fetch->shown_count = -1;
+   return fetch;
+}
+
+/**
+ * @brief Release the cache, giving its rows back to the source.
+ */
+EXPORT void pager_fetch_destroy(PFETCH *fetch)
+{
+   free_rows(fetch, fetch->rows, fetch->count);
+   free(fetch->rows);
+   free(fetch);
+}
+
+/**
+ * @brief Prepare a pager to show the rows of a @ref PFETCH.
+ * @param "parms"  pager to initialize, as with @ref pager_init_dparms
+ * @param "fetch"  cache of the rows to show
+ *
+ * The rows are counted with the @p row_count function of the
+ * source.  If there is none, or the count isn't known, the pager
+ * asks for rows as it needs them, see @ref pager_fetch_extend.
+ */
+EXPORT void pager_init_fetch(DPARMS *parms, PFETCH *fetch)
+{
+   int count = fetch->ops.row_count ? (*fetch->ops.row_count)(fetch->source) : -1;
+
+   pager_init_dparms(parms, fetch, count < 0 ? 0 : count, pager_fetch_printer, NULL);
+   pager_set_prepare(parms, pager_fetch_prepare);
+   if (count < 0)
+      pager_set_extend(parms, pager_fetch_extend);
+}
+
+/**
+ * @brief Get a fetched row, fetching it alone if it isn't kept.
+ * @return the row, or NULL if it couldn't be fetched.
+ *
+ * The row remains valid until rows far from it are fetched.
+ */
+EXPORT void *pager_fetch_row(PFETCH *fetch, int row_index)
+{
+   if (row_index < 0 || !fetch_rows(fetch, row_index, 1))
+      return NULL;
+
+   return fetch->rows[row_index - fetch->first];
+}
+
+/**
+ * @brief Release kept rows that have changed, to be fetched again.
+ * @param "fetch"  cache holding the rows
+ * @param "first"  index of first changed row
+ * @param "last"   index of last changed row
+ *
+ * Call this with @ref pager_invalidate_rows when rows of the source
+ * change.
+ */
+EXPORT void pager_fetch_discard(PFETCH *fetch, int first, int last)
+{
+   int have_end = fetch->first + fetch->count;
+   if (last < fetch->first || first >= have_end)
+      return;
+
+   // Keep the rows above the change, since the view usually shows them:
+   if (first <= fetch->first)
+      first = fetch->first;
+
+   free_rows(fetch, fetch->rows + (first - fetch->first), have_end - first);
+   fetch->count = first - fetch->first;
+}
+
+/**
+ * @brief @ref pager_prepare function fetching the rows of a screen
+ *        update in one request.
+ */
+EXPORT void pager_fetch_prepare(void *data_source, int first, int count, int top, int line_count)
+{
+   PFETCH *fetch = (PFETCH*)data_source;
+
+   if (fetch->ops.show_rows
+       && (top != fetch->shown_top || line_count != fetch->shown_count))
+   {
+      (*fetch->ops.show_rows)(fetch->source, top, line_count);
+      fetch->shown_top = top;
+      fetch->shown_count = line_count;
+   }
+
+   fetch_rows(fetch, first, count);
+}
+
+/**
+ * @brief @ref pager_extend function for sources that can't count
+ *        their rows in advance.
+ *
+ * The rows are fetched to learn if they exist, then released at
+ * once, in requests of at most 65536 rows.  During a background count, see @ref pager_focus_end, the
+ * @p get_rows and @p free_rows functions are called by the count
+ * thread, and must be safe to call while the UI thread draws.
+ */
+EXPORT int pager_fetch_extend(void *data_source, int known, int wanted)
+{
+   PFETCH *fetch = (PFETCH*)data_source;
+
+   int step = wanted - known < PAGER_COUNT_STEP ? wanted - known : PAGER_COUNT_STEP;
+   void **rows = (void**)malloc(sizeof(void*) * step);
+   if (rows == NULL)
+      return known;
+
+   while (known < wanted)
+   {
+      int count = wanted - known < step ? wanted - known : step;
+      int got = (*fetch->ops.get_rows)(fetch->source, known, count, rows);
+      if (got <= 0)
+         break;
+
+      free_rows(fetch, rows, got);
+      known += got;
+      if (got < count)
+         break;
+   }
+
+   free(rows);
+   return known;
+}
+
+/**
+ * @brief @ref pwb_print_line function for a @ref PFETCH, handing the
+ *        fetched row to the @p print_row function of the source.
+ *
+ * A row that wasn't fetched by @ref pager_fetch_prepare is fetched
+ * alone.  A row that couldn't be fetched is left blank.
+ */
+EXPORT int pager_fetch_printer(int row_index,
+                               int indicated,
+                               int length,
+                               void *data_source,
+                               void *data_extra)
+{
+   PFETCH *fetch = (PFETCH*)data_source;
+
+   void *row = pager_fetch_row(fetch, row_index);
+   if (row == NULL)
+      return pager_write_spans(NULL, 0, length, indicated);
+
+   return (*fetch->ops.print_row)(row, row_index, indicated, length, fetch->source);
+}
+
+/** @} */
@@ -0,0 +1,649 @@
+#include <stdlib.h>     // malloc/free, qsort
+#include <string.h>
+#include <unistd.h>     // sysconf
+#include <pthread.h>
+
+#include "export.h"
+#include "pager.h"
+#include "pager_private.h"
+
+/** @brief Longest query, in bytes */
+#define FILTER_QUERY_MAX 256
+
+/** @brief Fewest rows scored by a worker between publishing results */
+#define FILTER_BLOCK_MIN 4096
+
+/** @brief Most worker threads */
+#define FILTER_THREADS_MAX 16
+
+/** @brief Rows scored between checks for a newer query */
+#define FILTER_CANCEL_STEP 256
+
+/**
+ * @defgroup FILTER_SCORES Weights of a fuzzy match
+ *
+ * A matched character is worth #SCORE_MATCH, more at the start of a
+ * word or continuing a run of matches, and the characters skipped
+ * between matches cost a little each.
+ * @{
+ */
+#define SCORE_MATCH        16
+#define SCORE_GAP_START    -3
+#define SCORE_GAP_EXTEND   -1
+#define BONUS_BOUNDARY      8
+#define BONUS_CAMEL         7
+#define BONUS_CONSECUTIVE   4
+#define BONUS_FIRST_CHAR    2   ///< multiplies the bonus of the first character
+/** @} */
+
+/**
+ * @brief A row matching the query, ranked by score.
+ */
+typedef struct filter_match {
+   int row;
+   int score;
+   int len;                 ///< length of the row, the shorter ranks higher
+} FMATCH;
+
+struct pager_filter {
+   pager_row_text text;     ///< gets the text of a row of @p data_source
+   void *data_source;
+   int row_count;
+   PCONTEXT *context;       ///< notified of new results, may be NULL
+
+   pthread_t *threads;
+   int thread_count;
+   pthread_mutex_t lock;    ///< protects the members below
+   pthread_cond_t wake;     ///< signals a new query, or stopping
+   bool stopping;
+
+   char query[FILTER_QUERY_MAX];
+   int query_len;
+   unsigned generation;     ///< advanced with each query, read atomically
+
+   int *candidates;         ///< rows to score, NULL for every row
+   int candidate_count;
+   int block_size;
+   int block_count;
+   int next_block;          ///< next block to be scored
+   int blocks_done;         ///< blocks whose matches are in @p matches
+   int blocks_failed;       ///< blocks dropped for want of memory
+
+   FMATCH *matches;         ///< matches found so far, best first
+   int match_count;
+   int matches_size;        ///< elements allocated to @p matches
+   FMATCH *spare;           ///< merge buffer, swapped with @p matches
+   int spare_size;
+};
+
+static char fold_case(char chr)
+{
+   return chr >= 'A' && chr <= 'Z' ? chr + ('a' - 'A') : chr;
+}
+
+static bool is_word_char(char chr)
+{
+   return (chr >= 'a' && chr <= 'z') || (chr >= 'A' && chr <= 'Z') || (chr >= '0' && chr <= '9');
+}
+
+/**
+ * @brief Bonus for matching the character at @p index.
+ */
+static int boundary_bonus(const char *text, int index)
+{
+   if (index == 0 || !is_word_char(text[index - 1]))
+      return is_word_char(text[index]) ? BONUS_BOUNDARY : 0;
+
+   char prev = text[index - 1];
+   char chr = text[index];
+   if (prev >= 'a' && prev <= 'z' && chr >= 'A' && chr <= 'Z')
+      return BONUS_CAMEL;
+   if (!(prev >= '0' && prev <= '9') && chr >= '0' && chr <= '9')
+      return BONUS_CAMEL;
+
+   return 0;
+}
+
+/**
+ * @brief Score the best short match of a query in a text.
+ * @param "text"       text to search
+ * @param "len"        length of @p text
+ * @param "query"      characters to find in order, not necessarily together
+ * @param "query_len"  length of @p query, more than 0
+ * @param "fold"       *true* to ignore case
+ * @param "positions"  [out] if not NULL, where each character of
+ *                     @p query matched
+ * @return the score, or -1 if @p query isn't found.
+ *
+ * Like `fzf`, the first match is found scanning forward, then
+ * shortened by scanning back from its end, and the characters of
+ * the shortened match are scored.
+ */
+static int score_text(const char *text, int len,
+                      const char *query, int query_len,
+                      bool fold, int *positions)
+{
+   int qi = 0, end = -1;
+   for (int i = 0; i < len; ++i)
+   {
+      char chr = fold ? fold_case(text[i]) : text[i];
+      if (chr == query[qi] && ++qi == query_len)
+      {
+         end = i;
+         break;
+      }
+   }
+
+   if (end < 0)
+      return -1;
+
+   int start = end;
+   qi = query_len - 1;
+   for (int i = end; i >= 0; --i)
+   {
+      char chr = fold ? fold_case(text[i]) : text[i];
+      if (chr == query[qi] && qi-- == 0)
+      {
+         start = i;
+         break;
+      }
+   }
+
+   int score = 0, prev = -1, run_bonus = 0;
+   qi = 0;
+   for (int i = start; i <= end; ++i)
+   {
+      char chr = fold ? fold_case(text[i]) : text[i];
+      if (chr == query[qi])
+      {
+         int bonus = boundary_bonus(text, i);
+         if (prev == i - 1 && qi > 0)
+         {
+            // A run keeps the bonus of its first character:
+            if (run_bonus > bonus)
+               bonus = run_bonus;
+            if (bonus < BONUS_CONSECUTIVE)
+               bonus = BONUS_CONSECUTIVE;
+         }
+         else
+            run_bonus = bonus;
+
+         score += SCORE_MATCH + (qi == 0 ? bonus * BONUS_FIRST_CHAR : bonus);
+         if (positions)
+            positions[qi] = i;
+
+         prev = i;
+         ++qi;
+      }
+      else
+         score += prev == i - 1 ? SCORE_GAP_START : SCORE_GAP_EXTEND;
+   }
+
+   return score;
+}
+
+/**
+ * @brief Rank matches: higher score, then shorter row, then earlier row.
+ */
+static int compare_matches(const void *left, const void *right)
+{
+   const FMATCH *lm = (const FMATCH*)left;
+   const FMATCH *rm = (const FMATCH*)right;
+
+   if (lm->score != rm->score)
+      return lm->score > rm->score ? -1 : 1;
+   if (lm->len != rm->len)
+      return lm->len < rm->len ? -1 : 1;
+   return lm->row < rm->row ? -1 : (lm->row > rm->row);
+}
+
+static int compare_ints(const void *left, const void *right)
+{
+   int l = *(const int*)left, r = *(const int*)right;
+   return l < r ? -1 : (l > r);
+}
+
+/**
+ * @brief Test if a query ignores case, which it does unless it
+ *        has a capital letter.
+ */
+static bool query_folds(const char *query, int len)
+{
+   for (int i = 0; i < len; ++i)
+      if (query[i] >= 'A' && query[i] <= 'Z')
+         return false;
+
+   return true;
+}
+
+/**
+ * @brief Test if every match of @p wider is a match of @p narrower.
+ *
+ * It is if @p wider is a subsequence of @p narrower, as when
+ * characters are typed onto a query.
+ */
+static bool query_narrows(const char *wider, int wider_len, const char *narrower, int narrower_len)
+{
+   int wi = 0;
+   for (int i = 0; i < narrower_len && wi < wider_len; ++i)
+      if (narrower[i] == wider[wi])
+         ++wi;
+
+   return wi == wider_len;
+}
+
+/**
+ * @brief Merge sorted matches of a block into the published matches.
+ * @return *false* if out of memory.
+ */
+static bool merge_matches(PFILTER *filter, const FMATCH *block, int count)
+{
+   int total = filter->match_count + count;
+   if (total > filter->spare_size)
+   {
+      int size = filter->spare_size ? filter->spare_size : 1024;
+      while (size < total)
+         size *= 2;
+
+      FMATCH *spare = (FMATCH*)realloc(filter->spare, sizeof(FMATCH) * size);
+      if (spare == NULL)
+         return false;
+
+      filter->spare = spare;
+      filter->spare_size = size;
+   }
+
+   const FMATCH *left = filter->matches, *left_end = left + filter->match_count;
+   const FMATCH *right = block, *right_end = block + count;
+   FMATCH *out = filter->spare;
+
+   while (left < left_end && right < right_end)
+      *out++ = compare_matches(right, left) < 0 ? *right++ : *left++;
+   while (left < left_end)
+      *out++ = *left++;
+   while (right < right_end)
+      *out++ = *right++;
+
+   FMATCH *temp = filter->matches;
+   int temp_size = filter->matches_size;
+   filter->matches = filter->spare;
+   filter->matches_size = filter->spare_size;
+   filter->match_count = total;
+   filter->spare = temp;
+   filter->spare_size = temp_size;
+   return true;
+}
+
+/**
+ * @brief Worker thread, scoring blocks of rows against the query.
+ */
+static void *score_rows(void *arg)
+{
+   PFILTER *filter = (PFILTER*)arg;
+
+   char query[FILTER_QUERY_MAX];
+   int *rows = NULL;
+   FMATCH *found = NULL;
+   int size = 0;
+
+   pthread_mutex_lock(&filter->lock);
+   for (;;)
+   {
+      while (!filter->stopping && filter->next_block >= filter->block_count)
+         pthread_cond_wait(&filter->wake, &filter->lock);
+
+      if (filter->stopping)
+         break;
+
+      // Take a block, with copies of what a new query would replace:
+      unsigned generation = filter->generation;
+      int block = filter->next_block++;
+      int first = block * filter->block_size;
+      int count = filter->candidate_count - first;
+      if (count > filter->block_size)
+         count = filter->block_size;
+
+      if (count > size)
+      {
+         int *grown_rows = (int*)realloc(rows, sizeof(int) * count);
+         if (grown_rows)
+            rows = grown_rows;
+         FMATCH *grown = (FMATCH*)realloc(found, sizeof(FMATCH) * count);
+         if (grown)
+            found = grown;
+         if (grown_rows == NULL || grown == NULL)
+         {
+            ++filter->blocks_failed;
+            continue;
+         }
+         size = count;
+      }
+
+      for (int i = 0; i < count; ++i)
+         rows[i] = filter->candidates ? filter->candidates[first + i] : first + i;
+
+      int query_len = filter->query_len;
+      memcpy(query, filter->query, query_len);
+      pthread_mutex_unlock(&filter->lock);
+
+      bool fold = query_folds(query, query_len);
+      int found_count = 0;
+      bool cancelled = false;
+
+      for (int i = 0; i < count; ++i)
+      {
+         if (i % FILTER_CANCEL_STEP == 0
+             && __atomic_load_n(&filter->generation, __ATOMIC_RELAXED) != generation)
+         {
+            cancelled = true;
+            break;
+         }
+
+         int len = 0;
+         const char *text = (*filter->text)(filter->data_source, rows[i], &len);
+         int score = text ? score_text(text, len, query, query_len, fold, NULL) : -1;
+         if (score >= 0)
+         {
+            FMATCH *match = &found[found_count++];
+            match->row = rows[i];
+            match->score = score;
+            match->len = len;
+         }
+      }
+
+      if (!cancelled)
+         qsort(found, found_count, sizeof(FMATCH), compare_matches);
+
+      pthread_mutex_lock(&filter->lock);
+      if (!cancelled && generation == filter->generation)
+      {
+         if (merge_matches(filter, found, found_count))
+            ++filter->blocks_done;
+         else
+            ++filter->blocks_failed;
+
+         if (filter->context)
+            pager_post_row_count(filter->context, filter->match_count);
+      }
+   }
+   pthread_mutex_unlock(&filter->lock);
+
+   free(rows);
+   free(found);
+   return NULL;
+}
+
+/**
+ * @defgroup FUZZY_FILTER Fuzzy filtering of rows
+ * @brief Functions found in `pager_filter.c`
+ *
+ * As in `fzf`, the rows of a source are filtered to those containing
+ * the characters of a query in order, ranked best first.  Rows are
+ * scored in blocks by a pool of threads, and each block's matches
+ * are merged into the ranking as soon as they are scored, so the
+ * best matches found so far can be shown while the rest are scored.
+ * A new query abandons the blocks of the previous one.  If the new
+ * query only narrows the previous one, as when a character is typed,
+ * and the previous one was finished, only its matches are scored.
+ * @{
+ */
+
+/**
+ * @brief Prepare to filter the rows of a source.
+ * @param "text"         gets the text of a row from @p data_source,
+ *                       for example @ref pager_lines_text
+ * @param "data_source"  source of the rows
+ * @param "row_count"    number of rows in @p data_source
+ * @param "threads"      threads to score rows with, 0 for one per core
+ * @return new filter, showing every row, or NULL if out of memory or
+ *         the threads couldn't be started.  Release it with
+ *         @ref pager_filter_destroy.
+ *
+ * @p text is called by several threads at once, so it must be safe
+ * to do so, as @ref pager_lines_text is.
+ */
+EXPORT PFILTER *pager_filter_create(pager_row_text text, void *data_source, int row_count, int threads)
+{
+   if (threads <= 0)
+   {
+      long cores = sysconf(_SC_NPROCESSORS_ONLN);
+      threads = cores > 0 ? (int)cores : 1;
+   }
+   if (threads > FILTER_THREADS_MAX)
+      threads = FILTER_THREADS_MAX;
+
+   PFILTER *filter = (PFILTER*)calloc(1, sizeof(PFILTER));
+   if (filter == NULL)
+      return NULL;
+
+   filter->text = text;
+   filter->data_source = data_source;
+   filter->row_count = row_count;
+
+   filter->threads = (pthread_t*)malloc(sizeof(pthread_t) * threads);
+   if (filter->threads == NULL)
+   {
+      free(filter);
+      return NULL;
+   }
+
+   pthread_mutex_init(&filter->lock, NULL);
+   pthread_cond_init(&filter->wake, NULL);
+
+   for (; filter->thread_count < threads; ++filter->thread_count)
+      if (pthread_create(&filter->threads[filter->thread_count], NULL, score_rows, filter))
+         break;
+
+   if (filter->thread_count == 0)
+   {
+      pager_filter_destroy(filter);
+      return NULL;
+   }
+
+   return filter;
+}
+
+/**
+ * @brief Stop the threads and release the filter.
+ */
+EXPORT void pager_filter_destroy(PFILTER *filter)
+{
+   pthread_mutex_lock(&filter->lock);
+   filter->stopping = true;
+   __atomic_add_fetch(&filter->generation, 1, __ATOMIC_RELAXED);
+   pthread_cond_broadcast(&filter->wake);
+   pthread_mutex_unlock(&filter->lock);
+
+   for (int i = 0; i < filter->thread_count; ++i)
+      pthread_join(filter->threads[i], NULL);
+
+   pthread_cond_destroy(&filter->wake);
+   pthread_mutex_destroy(&filter->lock);
+
+   free(filter->threads);
+   free(filter->candidates);
+   free(filter->matches);
+   free(filter->spare);
+   free(filter);
+}
+
+/**
+ * @brief Post the number of matches to a context as they are found.
+ * @param "filter"  filter whose results are shown by @p ctx
+ * @param "ctx"     context made with the filter as its data source
+ *                  and @ref pager_filter_printer as its printer
+ *
+ * The context is replotted with the new ranking each time matches
+ * are added, when the UI thread calls @ref pager_context_apply.
+ */
+EXPORT void pager_filter_set_context(PFILTER *filter, PCONTEXT *ctx)
+{
+   pthread_mutex_lock(&filter->lock);
+   filter->context = ctx;
+   pthread_mutex_unlock(&filter->lock);
+}
+
+/**
+ * @brief Start filtering with a new query, abandoning the last one.
+ * @param "filter"  filter to change
+ * @param "query"   characters to find, in order.  An empty query
+ *                  matches every row in source order.  Capital
+ *                  letters make the query match case.
+ * @return *true* if started, *false* if out of memory.
+ *
+ * This returns at once, and the matches are found in the background.
+ */
+EXPORT bool pager_filter_set_query(PFILTER *filter, const char *query)
+{
+   int len = (int)strnlen(query, FILTER_QUERY_MAX - 1);
+
+   pthread_mutex_lock(&filter->lock);
+
+   // A finished query that the new one narrows limits the rows to score,
+   // unless a dropped block left its matches incomplete:
+   bool finished = filter->query_len == 0
+      || (filter->blocks_done == filter->block_count && filter->blocks_failed == 0);
+   bool narrows = filter->query_len > 0 && finished
+      && query_narrows(filter->query, filter->query_len, query, len);
+
+   int *candidates = NULL;
+   int count = filter->row_count;
+
+   if (narrows)
+   {
+      count = filter->match_count;
+      candidates = (int*)malloc(sizeof(int) * (count ? count : 1));
+      if (candidates == NULL)
+      {
+         pthread_mutex_unlock(&filter->lock);
+         return false;
+      }
+
+      // Scoring in row order keeps the blocks' reads together:
+      for (int i = 0; i < count; ++i)
+         candidates[i] = filter->matches[i].row;
+      qsort(candidates, count, sizeof(int), compare_ints);
+   }
+
+   __atomic_add_fetch(&filter->generation, 1, __ATOMIC_RELAXED);
+   memcpy(filter->query, query, len);
+   filter->query_len = len;
+
+   free(filter->candidates);
+   filter->candidates = candidates;
+   filter->candidate_count = count;
+   filter->match_count = 0;
+   filter->blocks_done = filter->blocks_failed = filter->next_block = 0;
+
+   if (len == 0)
+      filter->block_size = filter->block_count = 0;
+   else
+   {
+      int size = count / (filter->thread_count * 8);
+      filter->block_size = size < FILTER_BLOCK_MIN ? FILTER_BLOCK_MIN : size;
+      filter->block_count = (count + filter->block_size - 1) / filter->block_size;
+      pthread_cond_broadcast(&filter->wake);
+   }
+
+   if (filter->context)
+      pager_post_row_count(filter->context, len ? 0 : filter->row_count);
+
+   pthread_mutex_unlock(&filter->lock);
+   return true;
+}
+
+/**
+ * @brief Number of matches found so far.
+ * @param "filter"    filter to read
+ * @param "finished"  [out] if not NULL, set to *true* if every row
+ *                    has been scored.  Rows of a block dropped for
+ *                    want of memory count as scored, without matches.
+ */
+EXPORT int pager_filter_count(PFILTER *filter, bool *finished)
+{
+   pthread_mutex_lock(&filter->lock);
+   int count = filter->query_len ? filter->match_count : filter->row_count;
+   if (finished)
+      *finished = filter->blocks_done + filter->blocks_failed == filter->block_count;
+   pthread_mutex_unlock(&filter->lock);
+   return count;
+}
+
+/**
+ * @brief Get the source row of a match.
+ * @param "filter"  filter to read
+ * @param "rank"    position of the match, 0 for the best
+ * @return index of the row in the source, or -1 if @p rank is out
+ *         of range.
+ */
+EXPORT int pager_filter_row(PFILTER *filter, int rank)
+{
+   int row = -1;
+
+   pthread_mutex_lock(&filter->lock);
+   if (filter->query_len == 0)
+   {
+      if (rank >= 0 && rank < filter->row_count)
+         row = rank;
+   }
+   else if (rank >= 0 && rank < filter->match_count)
+      row = filter->matches[rank].row;
+   pthread_mutex_unlock(&filter->lock);
+
+   return row;
+}
+
+/**
+ * @brief @ref pwb_print_line function for the matches of a filter.
+ *
+ * The @p data_source must be a @ref PFILTER.  Rows are shown best
+ * first, with the matched characters in bold.
+ */
+EXPORT int pager_filter_printer(int row_index,
+                                int indicated,
+                                int length,
+                                void *data_source,
+                                void *data_extra)
+{
+   PFILTER *filter = (PFILTER*)data_source;
+
+   char query[FILTER_QUERY_MAX];
+   int positions[FILTER_QUERY_MAX];
+
+   pthread_mutex_lock(&filter->lock);
+   int query_len = filter->query_len;
+   memcpy(query, filter->query, query_len);
+   pthread_mutex_unlock(&filter->lock);
+
+   int row = pager_filter_row(filter, row_index);
+   int len = 0;
+   const char *text = row < 0 ? NULL : (*filter->text)(filter->data_source, row, &len);
+   if (text == NULL)
+      return pager_write_spans(NULL, 0, length, indicated);
+
+   if (query_len == 0
+       || score_text(text, len, query, query_len, query_folds(query, query_len), positions) < 0)
+      return pager_print_text(text, len, length, indicated);
+
+   // Alternate plain and bold spans around the matched characters:
+   PSPAN spans[FILTER_QUERY_MAX * 2 + 1];
+   static const PSTYLE bold = { 0, 0, PAGER_ATTR_BOLD };
+   int count = 0, done = 0;
+
+   for (int i = 0; i < query_len; ++i)
+   {
+      int at = positions[i];
+      if (at > done)
+         spans[count++] = (PSPAN){ text + done, at - done, { 0, 0, 0 } };
+
+      spans[count++] = (PSPAN){ text + at, 1, bold };
+      done = at + 1;
+   }
+
+   if (done < len)
+      spans[count++] = (PSPAN){ text + done, len - done, { 0, 0, 0 } };
+
+   return pager_write_spans(spans, count, length, indicated);
+}
+
+/** @} */
@@ -0,0 +1,822 @@
+#include <stdlib.h>     // malloc/free
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <zlib.h>
+
+#include "export.h"
+#include "pager.h"
+#include "pager_private.h"
+#include "pager_mfile.h"
+#include "pager_cache.h"
+
+/** @brief Uncompressed bytes between checkpoints, unless set otherwise */
+#define GZIP_DEFAULT_SPACING (1024 * 1024)
+
+/** @brief Largest checkpoint spacing, so block offsets fit in an int */
+#define GZIP_MAX_SPACING (256 * 1024 * 1024)
+
+/** @brief Size of the deflate history kept with each checkpoint */
+#define GZIP_WINDOW 32768
+
+/** @brief Most compressed bytes handed to zlib at once (avail_in is 32 bits) */
+#define GZIP_INPUT_CHUNK (1024 * 1024 * 1024)
+
+/** @brief Most bytes read past a block to finish its last line */
+#define GZIP_LINE_LIMIT 65536
+
+/**
+ * @brief A place from which decompression can resume.
+ *
+ * After zlib's example `zran.c`: checkpoints are made at deflate
+ * block boundaries, which may fall within a byte, so the unused
+ * bits of the previous byte are kept with the 32K of history that
+ * the following blocks may refer to.
+ */
+typedef struct gz_point {
+   size_t out;              ///< uncompressed offset
+   size_t in;               ///< offset of first compressed byte to read
+   int bits;                ///< bits of the byte before @p in still unread
+   int line;                ///< index of the first line starting at or after @p out
+   bool line_start;         ///< a line starts at @p out
+   bool cached;             ///< @p window is in the mapped index, not allocated
+   unsigned char *window;   ///< history before @p out, NULL for the start
+} GZPOINT;
+
+/**
+ * @brief A checkpoint in the cached index, followed by its window.
+ *
+ * The cached index is the checkpoint spacing, as a `uint64_t`,
+ * followed by the checkpoints in order, so that the index of a file
+ * that grows can be extended from its last checkpoint.
+ */
+typedef struct gz_saved_point {
+   uint64_t out;
+   uint64_t in;
+   int32_t bits;
+   int32_t line;
+   int32_t line_start;
+   int32_t has_window;
+} GZSAVED;
+
+/**
+ * @brief Uncompressed text from one checkpoint to the next.
+ *
+ * A block holds the lines that start between its checkpoint and
+ * the next, with the end of the last line read from past the next
+ * checkpoint.
+ */
+typedef struct gz_block {
+   int point;               ///< index of the checkpoint, -1 if unused
+   char *text;
+   size_t len;
+   size_t size;             ///< bytes allocated to @p text
+   int *starts;             ///< offsets of the lines in @p text
+   int starts_size;         ///< elements allocated to @p starts
+   unsigned long used;      ///< when last used, to replace the oldest block
+} GZBLOCK;
+
+struct pager_gzip {
+   MFILE mfile;
+   bool gzip;               ///< input is gzip rather than zlib, may have several members
+   size_t spacing;
+
+   GZPOINT *points;         ///< checkpoints, the last marking the end of the text
+   int point_count;
+   int points_size;         ///< elements allocated to @p points
+
+   int row_count;
+   size_t size;             ///< uncompressed size
+
+   GZBLOCK blocks[2];       ///< two blocks to cover a page that spans a checkpoint
+   unsigned long clock;
+
+   PCINDEX index;           ///< cached index holding some windows, if mapped
+   size_t index_end;        ///< offset in @p index of its last checkpoint
+};
+
+/**
+ * @brief Decompression state, feeding zlib from the mapped file.
+ */
+typedef struct gz_reader {
+   z_stream strm;
+   const unsigned char *in;     ///< next byte not yet given to zlib
+   const unsigned char *in_end;
+   bool gzip;
+   bool raw;                    ///< resumed without headers, see resume_reader()
+   bool done;                   ///< end of input or error
+} GZREADER;
+
+static bool start_reader(GZREADER *reader, const PGZIP *gz)
+{
+   memset(reader, 0, sizeof(GZREADER));
+   reader->in = (const unsigned char*)gz->mfile.data;
+   reader->in_end = reader->in + gz->mfile.size;
+   reader->gzip = gz->gzip;
+
+   // Detect and skip a gzip or zlib header:
+   return inflateInit2(&reader->strm, 47) == Z_OK;
+}
+
+/**
+ * @brief Prepare to decompress from a checkpoint.
+ */
+static bool resume_reader(GZREADER *reader, const PGZIP *gz, const GZPOINT *point)
+{
+   if (point->window == NULL)
+      return start_reader(reader, gz);
+
+   memset(reader, 0, sizeof(GZREADER));
+   const unsigned char *data = (const unsigned char*)gz->mfile.data;
+   reader->in = data + point->in;
+   reader->in_end = data + gz->mfile.size;
+   reader->gzip = gz->gzip;
+   reader->raw = true;
+
+   if (inflateInit2(&reader->strm, -15) != Z_OK)
+      return false;
+
+   if ((point->bits
+        && inflatePrime(&reader->strm, point->bits, data[point->in - 1] >> (8 - point->bits)) != Z_OK)
+       || inflateSetDictionary(&reader->strm, point->window, GZIP_WINDOW) != Z_OK)
+   {
+      inflateEnd(&reader->strm);
+      return false;
+   }
+
+   return true;
+}
+
+/**
+ * @brief Offset in the file of the next compressed byte.
+ */
+static size_t reader_offset(const GZREADER *reader, const PGZIP *gz)
+{
+   return reader->in - reader->strm.avail_in - (const unsigned char*)gz->mfile.data;
+}
+
+/**
+ * @brief Inflate into the output set in the reader's stream.
+ * @return result of `inflate`, with the end of a gzip member that
+ *         is followed by another member reported as Z_OK.
+ *
+ * The end of the input is flagged with @p done.
+ */
+static int reader_inflate(GZREADER *reader, int flush)
+{
+   z_stream *strm = &reader->strm;
+
+   if (strm->avail_in == 0 && reader->in < reader->in_end)
+   {
+      size_t chunk = reader->in_end - reader->in;
+      if (chunk > GZIP_INPUT_CHUNK)
+         chunk = GZIP_INPUT_CHUNK;
+
+      strm->next_in = (Bytef*)reader->in;
+      strm->avail_in = (uInt)chunk;
+      reader->in += chunk;
+   }
+
+   int ret = inflate(strm, flush);
+
+   if (ret == Z_STREAM_END)
+   {
+      const unsigned char *next = reader->in - strm->avail_in;
+
+      // Raw inflation leaves the gzip trailer to be skipped:
+      if (reader->raw)
+         next += 8;
+
+      if (reader->gzip && next < reader->in_end)
+      {
+         reader->in = next;
+         strm->avail_in = 0;
+         reader->raw = false;
+         inflateReset2(strm, 47);
+         return Z_OK;
+      }
+
+      reader->done = true;
+   }
+   else if (ret == Z_BUF_ERROR && strm->avail_in == 0 && reader->in >= reader->in_end)
+      reader->done = true;      // truncated input
+   else if (ret != Z_OK)
+      reader->done = true;
+
+   return ret;
+}
+
+/**
+ * @brief Append a checkpoint.
+ */
+static GZPOINT *add_point(PGZIP *gz)
+{
+   if (gz->point_count >= gz->points_size)
+   {
+      int size = gz->points_size ? gz->points_size * 2 : 64;
+      GZPOINT *points = (GZPOINT*)realloc(gz->points, sizeof(GZPOINT) * size);
+      if (points == NULL)
+         return NULL;
+
+      gz->points = points;
+      gz->points_size = size;
+   }
+
+   GZPOINT *point = &gz->points[gz->point_count++];
+   memset(point, 0, sizeof(GZPOINT));
+   return point;
+}
+
+/**
+ * @brief Count newlines in @p len bytes.
+ */
+static long count_newlines(const unsigned char *ptr, size_t len)
+{
+   const unsigned char *end = ptr + len;
+   long count = 0;
+   while ((ptr = (const unsigned char*)memchr(ptr, '\n', end - ptr)))
+   {
+      ++count;
+      ++ptr;
+   }
+   return count;
+}
+
+/**
+ * @brief Decompress the input once, counting lines and making
+ *        checkpoints.
+ *
+ * If there are checkpoints already, from an index of the file before
+ * it grew, decompression resumes at the last of them.
+ */
+static bool build_points(PGZIP *gz)
+{
+   GZREADER reader;
+   unsigned char *window = (unsigned char*)malloc(GZIP_WINDOW);
+   if (window == NULL)
+      return false;
+
+   size_t total = 0, last = 0;
+   long newlines = 0;
+   bool after_newline = true;
+   bool ok;
+
+   if (gz->point_count > 0)
+   {
+      const GZPOINT *point = &gz->points[gz->point_count - 1];
+      ok = resume_reader(&reader, gz, point);
+
+      total = last = point->out;
+      after_newline = point->line_start;
+      newlines = point->line - 1 + after_newline;
+
+      // Output continues the history of the checkpoint:
+      if (point->window)
+         memcpy(window, point->window, GZIP_WINDOW);
+   }
+   else
+   {
+      // The first checkpoint, at the start of the input:
+      ok = start_reader(&reader, gz);
+      GZPOINT *first = ok ? add_point(gz) : NULL;
+      if (first)
+         first->line_start = true;
+      else if (ok)
+      {
+         inflateEnd(&reader.strm);
+         ok = false;
+      }
+   }
+
+   if (!ok)
+   {
+      free(window);
+      return false;
+   }
+
+   z_stream *strm = &reader.strm;
+   strm->avail_out = 0;
+
+   mfile_advise_sequential(&gz->mfile, true);
+
+   while (ok && !reader.done)
+   {
+      // Use the window as a circular buffer for the output:
+      if (strm->avail_out == 0)
+      {
+         strm->next_out = window;
+         strm->avail_out = GZIP_WINDOW;
+      }
+
+      unsigned char *out = strm->next_out;
+      int ret = reader_inflate(&reader, Z_BLOCK);
+      size_t produced = strm->next_out - out;
+
+      if (produced)
+      {
+         newlines += count_newlines(out, produced);
+         after_newline = out[produced-1] == '\n';
+         total += produced;
+      }
+
+      if (ret != Z_OK && ret != Z_STREAM_END)
+      {
+         // Keep what was decompressed from a truncated file:
+         if (ret != Z_BUF_ERROR)
+            ok = false;
+         break;
+      }
+
+      // At the end of a block that isn't the last:
+      if (ret == Z_OK
+          && (strm->data_type & 128) && !(strm->data_type & 64)
+          && total - last >= gz->spacing)
+      {
+         GZPOINT *point = add_point(gz);
+         if (point == NULL || (point->window = (unsigned char*)malloc(GZIP_WINDOW)) == NULL)
+         {
+            ok = false;
+            break;
+         }
+
+         point->out = total;
+         point->in = reader_offset(&reader, gz);
+         point->bits = strm->data_type & 7;
+         point->line = (int)(1 + newlines - after_newline);
+         point->line_start = after_newline;
+
+         int left = strm->avail_out;
+         if (left)
+            memcpy(point->window, window + GZIP_WINDOW - left, left);
+         if (left < GZIP_WINDOW)
+            memcpy(point->window + left, window, GZIP_WINDOW - left);
+
+         last = total;
+      }
+   }
+
+   mfile_advise_sequential(&gz->mfile, false);
+   inflateEnd(strm);
+   free(window);
+
+   if (!ok)
+      return false;
+
+   gz->size = total;
+   gz->row_count = total ? (int)(1 + newlines - after_newline) : 0;
+
+   // Close the last block with a checkpoint at the end:
+   GZPOINT *end = add_point(gz);
+   if (end == NULL)
+      return false;
+
+   end->out = total;
+   end->line = gz->row_count;
+   end->line_start = true;
+   return true;
+}
+
+/**
+ * @brief Read the checkpoints of the cached index.
+ * @return *false* if the index doesn't hold checkpoints made with
+ *         the same spacing.
+ *
+ * The windows are used where they are mapped.
+ */
+static bool read_points(PGZIP *gz)
+{
+   const char *data = gz->index.data;
+   const char *end = data + gz->index.size;
+   if (gz->index.size < sizeof(uint64_t) || *(const uint64_t*)data != gz->spacing)
+      return false;
+
+   const char *ptr = data + sizeof(uint64_t);
+   while (ptr < end)
+   {
+      const GZSAVED *saved = (const GZSAVED*)ptr;
+      GZPOINT *point = NULL;
+      if ((size_t)(end - ptr) < sizeof(GZSAVED)
+          || (saved->has_window && (size_t)(end - ptr) < sizeof(GZSAVED) + GZIP_WINDOW)
+          || (point = add_point(gz)) == NULL)
+      {
+         gz->point_count = 0;
+         return false;
+      }
+
+      gz->index_end = ptr - data;
+      ptr += sizeof(GZSAVED);
+
+      point->out = saved->out;
+      point->in = saved->in;
+      point->bits = saved->bits;
+      point->line = saved->line;
+      point->line_start = saved->line_start;
+
+      if (saved->has_window)
+      {
+         point->window = (unsigned char*)ptr;
+         point->cached = true;
+         ptr += GZIP_WINDOW;
+      }
+   }
+
+   // The last checkpoint marks the end of the text:
+   if (gz->point_count < 2)
+   {
+      gz->point_count = 0;
+      return false;
+   }
+
+   const GZPOINT *last = &gz->points[gz->point_count - 1];
+   gz->size = last->out;
+   gz->row_count = last->line;
+   return true;
+}
+
+/**
+ * @brief Save the checkpoints from @p first on to the cache.
+ * @param "gz"      source whose checkpoints are saved
+ * @param "first"   0 to save all of them, or the index of the first
+ *                  made since the file grew
+ * @param "offset"  where in the cached index to save from @p first
+ */
+static void save_points(const PGZIP *gz, int first, size_t offset)
+{
+   int count = gz->point_count - first;
+   GZSAVED *saved = (GZSAVED*)calloc(count, sizeof(GZSAVED));
+   PCPART *parts = (PCPART*)malloc(sizeof(PCPART) * (count * 2 + 1));
+   if (saved == NULL || parts == NULL)
+   {
+      free(saved);
+      free(parts);
+      return;
+   }
+
+   uint64_t spacing = gz->spacing;
+   int part_count = 0;
+   if (first == 0)
+      parts[part_count++] = (PCPART){ &spacing, sizeof(spacing) };
+
+   for (int i = 0; i < count; ++i)
+   {
+      const GZPOINT *point = &gz->points[first + i];
+      saved[i].out = point->out;
+      saved[i].in = point->in;
+      saved[i].bits = point->bits;
+      saved[i].line = point->line;
+      saved[i].line_start = point->line_start;
+      saved[i].has_window = point->window != NULL;
+
+      parts[part_count++] = (PCPART){ &saved[i], sizeof(GZSAVED) };
+      if (point->window)
+         parts[part_count++] = (PCPART){ point->window, GZIP_WINDOW };
+   }
+
+   if (first == 0)
+      pcache_index_save("gzip", &gz->mfile, parts, part_count);
+   else
+      pcache_index_extend("gzip", &gz->mfile, offset, parts, part_count);
+
+   free(parts);
+   free(saved);
+}
+
+/**
+ * @brief Make the checkpoints, using the cached index if there is
+ *        one, and save them to the cache.
+ *
+ * The checkpoints of an unchanged file are read from the cache.
+ * If the file has grown, they are extended from the last of them,
+ * so only the end of the file is decompressed, and only the new
+ * checkpoints are added to the cache.
+ */
+static bool load_points(PGZIP *gz)
+{
+   int first = 0;
+
+   if (pcache_index_open(&gz->index, "gzip", &gz->mfile))
+   {
+      if (read_points(gz))
+      {
+         if (gz->index.complete)
+            return true;
+
+         // Replace the end marker, resuming at the checkpoint before it:
+         first = --gz->point_count;
+      }
+      else
+         pcache_index_close(&gz->index);
+   }
+
+   if (!build_points(gz))
+      return false;
+
+   save_points(gz, first, gz->index_end);
+   return true;
+}
+
+/**
+ * @brief Ensure @p block->text can hold @p size bytes.
+ */
+static bool reserve_text(GZBLOCK *block, size_t size)
+{
+   if (size <= block->size)
+      return true;
+
+   size_t newsize = block->size ? block->size : 4096;
+   while (newsize < size)
+      newsize *= 2;
+
+   char *text = (char*)realloc(block->text, newsize);
+   if (text == NULL)
+      return false;
+
+   block->text = text;
+   block->size = newsize;
+   return true;
+}
+
+/**
+ * @brief Decompress @p len bytes, or less at the end of input, into
+ *        the end of the block.
+ */
+static void inflate_into(GZREADER *reader, GZBLOCK *block, size_t len)
+{
+   z_stream *strm = &reader->strm;
+
+   while (len > 0 && !reader->done)
+   {
+      uInt avail = len > GZIP_INPUT_CHUNK ? GZIP_INPUT_CHUNK : (uInt)len;
+      strm->next_out = (Bytef*)block->text + block->len;
+      strm->avail_out = avail;
+
+      reader_inflate(reader, Z_NO_FLUSH);
+
+      size_t produced = avail - strm->avail_out;
+      block->len += produced;
+      len -= produced;
+   }
+}
+
+/**
+ * @brief Decompress the lines starting between a checkpoint and the next.
+ */
+static bool load_block(PGZIP *gz, GZBLOCK *block, int index)
+{
+   const GZPOINT *point = &gz->points[index];
+   const GZPOINT *next = &gz->points[index + 1];
+   size_t span = next->out - point->out;
+
+   block->point = -1;
+   block->len = 0;
+
+   GZREADER reader;
+   if (!reserve_text(block, span + 1) || !resume_reader(&reader, gz, point))
+      return false;
+
+   inflate_into(&reader, block, span);
+
+   // Read on to the end of the last line:
+   while ((block->len == 0 || block->text[block->len - 1] != '\n')
+          && block->len - span < GZIP_LINE_LIMIT
+          && !reader.done)
+   {
+      size_t len = block->len;
+      if (!reserve_text(block, len + 4096))
+         break;
+
+      inflate_into(&reader, block, 4096);
+
+      const char *newline = memchr(block->text + len, '\n', block->len - len);
+      if (newline)
+      {
+         block->len = newline + 1 - block->text;
+         break;
+      }
+   }
+
+   inflateEnd(&reader.strm);
+
+   // Record where each line owned by the block starts:
+   int count = next->line - point->line;
+   if (count > block->starts_size)
+   {
+      int *starts = (int*)realloc(block->starts, sizeof(int) * count);
+      if (starts == NULL)
+         return false;
+
+      block->starts = starts;
+      block->starts_size = count;
+   }
+
+   int line = 0;
+   if (point->line_start && count > 0)
+      block->starts[line++] = 0;
+
+   const char *ptr = block->text;
+   const char *end = block->text + (span < block->len ? span : block->len);
+   while (line < count && (ptr = memchr(ptr, '\n', end - ptr)))
+   {
+      ++ptr;
+      if (ptr >= end)
+         break;
+      block->starts[line++] = ptr - block->text;
+   }
+
+   // A damaged file may have fewer lines than counted:
+   while (line < count)
+      block->starts[line++] = block->len;
+
+   block->point = index;
+   return true;
+}
+
+/**
+ * @brief Find the block holding a row, decompressing it if necessary.
+ */
+static GZBLOCK *get_block(PGZIP *gz, int row_index)
+{
+   // Find the last checkpoint at or before the row:
+   int low = 0, high = gz->point_count - 2;
+   while (low < high)
+   {
+      int mid = (low + high + 1) / 2;
+      if (gz->points[mid].line <= row_index)
+         low = mid;
+      else
+         high = mid - 1;
+   }
+
+   GZBLOCK *block = NULL;
+   for (int i = 0; i < 2; ++i)
+   {
+      if (gz->blocks[i].point == low)
+      {
+         block = &gz->blocks[i];
+         break;
+      }
+   }
+
+   if (block == NULL)
+   {
+      block = gz->blocks[0].used <= gz->blocks[1].used ? &gz->blocks[0] : &gz->blocks[1];
+      if (!load_block(gz, block, low))
+         return NULL;
+   }
+
+   block->used = ++gz->clock;
+   return block;
+}
+
+/**
+ * @defgroup GZIP_SOURCE Compressed text files
+ * @brief Functions found in `pager_gzip.c`
+ *
+ * A gzip or zlib file is decompressed once when opened to count
+ * its lines and make checkpoints.  Afterwards, rows are read by
+ * decompressing from the nearest checkpoint.
+ *
+ * If a cache directory is set, see @ref pager_set_cache_dir, the
+ * checkpoints are saved there, and reopening the file maps them
+ * instead of decompressing it.  If the file has only grown, only
+ * what follows the last checkpoint is decompressed.
+ * @{
+ */
+
+/**
+ * @brief Open a gzip or zlib compressed text file.
+ * @param "path"     file to open
+ * @param "spacing"  uncompressed bytes between checkpoints, or 0 for
+ *                   the default of 1 MiB
+ * @return new source, or NULL if the file can't be read or
+ *         decompressed.  Release the source with @ref pager_gzip_close.
+ *
+ * Each checkpoint keeps 32 KiB of history, so checkpoints take
+ * 32 KiB for every @p spacing bytes of text.  Reading a row
+ * decompresses at most about @p spacing bytes, and two such blocks
+ * are kept.  A larger spacing saves memory, while a smaller spacing
+ * makes jumps faster.
+ */
+EXPORT PGZIP *pager_gzip_open(const char *path, long spacing)
+{
+   PGZIP *gz = (PGZIP*)malloc(sizeof(PGZIP));
+   if (gz == NULL)
+      return NULL;
+
+   memset(gz, 0, sizeof(PGZIP));
+   gz->blocks[0].point = gz->blocks[1].point = -1;
+
+   if (spacing <= 0)
+      spacing = GZIP_DEFAULT_SPACING;
+   else if (spacing > GZIP_MAX_SPACING)
+      spacing = GZIP_MAX_SPACING;
+   gz->spacing = spacing;
+
+   if (!mfile_open(&gz->mfile, path))
+   {
+      free(gz);
+      return NULL;
+   }
+
+   const unsigned char *data = (const unsigned char*)gz->mfile.data;
+   gz->gzip = gz->mfile.size >= 2 && data[0] == 0x1f && data[1] == 0x8b;
+
+   if (!load_points(gz))
+   {
+      pager_gzip_close(gz);
+      return NULL;
+   }
+
+   return gz;
+}
+
+/**
+ * @brief Release the source and unmap the file.
+ */
+EXPORT void pager_gzip_close(PGZIP *gz)
+{
+   for (int i = 0; i < gz->point_count; ++i)
+      if (!gz->points[i].cached)
+         free(gz->points[i].window);
+   free(gz->points);
+
+   if (gz->index.map.data)
+      pcache_index_close(&gz->index);
+
+   for (int i = 0; i < 2; ++i)
+   {
+      free(gz->blocks[i].text);
+      free(gz->blocks[i].starts);
+   }
+
+   mfile_close(&gz->mfile);
+   free(gz);
+}
+
+/**
+ * @brief Number of lines in the uncompressed text.
+ */
+EXPORT int pager_gzip_row_count(const PGZIP *gz)
+{
+   return gz->row_count;
+}
+
+/**
+ * @brief Get the text of a line.
+ * @param "gz"         source holding the line
+ * @param "row_index"  index of the line
+ * @param "len"        [out] length of the line, without its newline
+ * @return pointer to the line, which is not NUL-terminated, or NULL
+ *         if out of range or the file can't be decompressed.
+ *
+ * The pointer remains valid until lines from two other blocks have
+ * been read.  Use this to search the text.
+ */
+EXPORT const char *pager_gzip_line(PGZIP *gz, int row_index, int *len)
+{
+   if (row_index < 0 || row_index >= gz->row_count)
+      return NULL;
+
+   GZBLOCK *block = get_block(gz, row_index);
+   if (block == NULL)
+      return NULL;
+
+   int start = block->starts[row_index - gz->points[block->point].line];
+   const char *line = block->text + start;
+   const char *end = block->text + block->len;
+   const char *newline = memchr(line, '\n', end - line);
+
+   *len = (int)((newline ? newline : end) - line);
+   return line;
+}
+
+/**
+ * @brief @ref pager_row_text function for compressed text files,
+ *        to show their colours with @ref pager_ansi_create.
+ */
+EXPORT const char *pager_gzip_text(void *data_source, int row_index, int *len)
+{
+   return pager_gzip_line((PGZIP*)data_source, row_index, len);
+}
+
+/**
+ * @brief @ref pwb_print_line function for compressed text files.
+ *
+ * The @p data_source must be a @ref PGZIP.  Control characters are
+ * written as spaces.
+ */
+EXPORT int pager_gzip_printer(int row_index,
+                              int indicated,
+                              int length,
+                              void *data_source,
+                              void *data_extra)
+{
+   int len;
+   const char *line = pager_gzip_line((PGZIP*)data_source, row_index, &len);
+   if (line == NULL)
+      return 0;
+
+   return pager_print_text(line, len, length, indicated);
+}
+
+/** @} */
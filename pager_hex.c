@@ -0,0 +1,289 @@
+#include <stdlib.h>     // malloc/free
+#include <string.h>
+#include <limits.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "export.h"
+#include "pager.h"
+#include "pager_private.h"
+#include "pager_mfile.h"
+
+/** @brief Bytes shown on a row if @ref pager_hex_open isn't given a width */
+#define HEX_DEFAULT_WIDTH 16
+
+/** @brief Most bytes shown on a row */
+#define HEX_MAX_WIDTH 256
+
+/** @brief Fewest hex digits of the offset at the start of each row */
+#define HEX_MIN_DIGITS 8
+
+struct pager_hex {
+   MFILE mfile;
+   int width;               ///< bytes shown on each row
+   int digits;              ///< hex digits of each offset
+   int row_count;
+};
+
+/**
+ * @brief Write two lowercase hex digits for each byte.
+ * @param "bytes"  bytes to encode
+ * @param "count"  number of bytes
+ * @param "hex"    receives 2 * @p count characters
+ *
+ * Sixteen bytes are encoded at a time where SSE2 is available, by
+ * adding '0' to each nibble, and the gap to 'a' to those above 9.
+ */
+static void encode_hex(const unsigned char *bytes, int count, char *hex)
+{
+   int i = 0;
+
+#ifdef __SSE2__
+   const __m128i nibble = _mm_set1_epi8(0x0f);
+   const __m128i nine = _mm_set1_epi8(9);
+   const __m128i zero = _mm_set1_epi8('0');
+   const __m128i gap = _mm_set1_epi8('a' - '0' - 10);
+
+   for (; count - i >= 16; i += 16)
+   {
+      __m128i chunk = _mm_loadu_si128((const __m128i*)(bytes + i));
+      __m128i high = _mm_and_si128(_mm_srli_epi16(chunk, 4), nibble);
+      __m128i low = _mm_and_si128(chunk, nibble);
+
+      high = _mm_add_epi8(_mm_add_epi8(high, zero),
+                          _mm_and_si128(_mm_cmpgt_epi8(high, nine), gap));
+      low = _mm_add_epi8(_mm_add_epi8(low, zero),
+                         _mm_and_si128(_mm_cmpgt_epi8(low, nine), gap));
+
+      _mm_storeu_si128((__m128i*)(hex + 2 * i), _mm_unpacklo_epi8(high, low));
+      _mm_storeu_si128((__m128i*)(hex + 2 * i + 16), _mm_unpackhi_epi8(high, low));
+   }
+#endif
+
+   static const char digits[] = "0123456789abcdef";
+   for (; i < count; ++i)
+   {
+      hex[2 * i] = digits[bytes[i] >> 4];
+      hex[2 * i + 1] = digits[bytes[i] & 0x0f];
+   }
+}
+
+/**
+ * @brief Copy bytes, replacing those that aren't printable ASCII
+ *        with '.'.
+ */
+static void encode_ascii(const unsigned char *bytes, int count, char *text)
+{
+   int i = 0;
+
+#ifdef __SSE2__
+   // Bytes from 0x80 are negative, so fail the first comparison:
+   const __m128i below = _mm_set1_epi8(0x1f);
+   const __m128i above = _mm_set1_epi8(0x7f);
+   const __m128i dot = _mm_set1_epi8('.');
+
+   for (; count - i >= 16; i += 16)
+   {
+      __m128i chunk = _mm_loadu_si128((const __m128i*)(bytes + i));
+      __m128i printable = _mm_and_si128(_mm_cmpgt_epi8(chunk, below),
+                                        _mm_cmplt_epi8(chunk, above));
+      _mm_storeu_si128((__m128i*)(text + i),
+                       _mm_or_si128(_mm_and_si128(printable, chunk),
+                                    _mm_andnot_si128(printable, dot)));
+   }
+#endif
+
+   for (; i < count; ++i)
+      text[i] = bytes[i] >= 0x20 && bytes[i] < 0x7f ? (char)bytes[i] : '.';
+}
+
+/**
+ * @brief Format a row as its offset, its bytes in hex, then its bytes
+ *        as text.
+ * @return length of the formatted row.
+ *
+ * The hex is grouped by eight bytes, and a short last row is padded
+ * so its text lines up with the rows above.
+ */
+static int format_row(const PHEX *hex, int row_index, char *line)
+{
+   size_t offset = (size_t)row_index * hex->width;
+   const unsigned char *bytes = (const unsigned char*)hex->mfile.data + offset;
+   int count = hex->mfile.size - offset < (size_t)hex->width
+      ? (int)(hex->mfile.size - offset) : hex->width;
+
+   char digits[2 * HEX_MAX_WIDTH];
+   encode_hex(bytes, count, digits);
+
+   static const char hexchars[] = "0123456789abcdef";
+   char *ptr = line;
+   for (int shift = (hex->digits - 1) * 4; shift >= 0; shift -= 4)
+      *ptr++ = hexchars[(offset >> shift) & 0x0f];
+   *ptr++ = ' ';
+
+   for (int i = 0; i < hex->width; ++i)
+   {
+      if (i % 8 == 0)
+         *ptr++ = ' ';
+
+      if (i < count)
+      {
+         ptr[0] = digits[2 * i];
+         ptr[1] = digits[2 * i + 1];
+      }
+      else
+         ptr[0] = ptr[1] = ' ';
+
+      ptr[2] = ' ';
+      ptr += 3;
+   }
+
+   *ptr++ = ' ';
+   *ptr++ = '|';
+   encode_ascii(bytes, count, ptr);
+   ptr += count;
+   *ptr++ = '|';
+
+   return (int)(ptr - line);
+}
+
+/**
+ * @defgroup HEX_SOURCE Hex dumps of binary files
+ * @brief Functions found in `pager_hex.c`
+ *
+ * Shows a file as rows of a fixed number of bytes, each as its
+ * offset, its bytes in hex, and its printable bytes as text.  The
+ * file is mapped, and the bytes of a row are found by multiplying,
+ * so opening takes the same time whatever the size of the file, and
+ * so does moving to any offset.
+ *
+ * The printer only reads the file, so it can be drawn ahead, see
+ * @ref pager_prerender_start.
+ * @{
+ */
+
+/**
+ * @brief Open a file to be shown as a hex dump.
+ * @param "path"   file to show
+ * @param "width"  bytes on each row, up to 256, or 0 for 16
+ * @return new source, or NULL if the file can't be mapped.  Release
+ *         the source with @ref pager_hex_close.
+ *
+ * Rows past INT_MAX can't be shown, so show a file of more than
+ * 32 GiB with a wider row.
+ */
+EXPORT PHEX *pager_hex_open(const char *path, int width)
+{
+   PHEX *hex = (PHEX*)calloc(1, sizeof(PHEX));
+   if (hex == NULL)
+      return NULL;
+
+   if (!mfile_open(&hex->mfile, path))
+   {
+      free(hex);
+      return NULL;
+   }
+
+   if (width <= 0)
+      width = HEX_DEFAULT_WIDTH;
+   else if (width > HEX_MAX_WIDTH)
+      width = HEX_MAX_WIDTH;
+   hex->width = width;
+
+   size_t rows = (hex->mfile.size + width - 1) / width;
+   hex->row_count = rows > INT_MAX ? INT_MAX : (int)rows;
+
+   hex->digits = HEX_MIN_DIGITS;
+   while (hex->digits < 16 && (hex->mfile.size >> (hex->digits * 4)) != 0)
+      ++hex->digits;
+
+   return hex;
+}
+
+/**
+ * @brief Release the source and unmap the file.
+ */
+EXPORT void pager_hex_close(PHEX *hex)
+{
+   mfile_close(&hex->mfile);
+   free(hex);
+}
+
+/**
+ * @brief Number of rows of the dump.
+ */
+EXPORT int pager_hex_row_count(const PHEX *hex)
+{
+   return hex->row_count;
+}
+
+/**
+ * @brief Offset in the file of the first byte of a row.
+ */
+EXPORT size_t pager_hex_offset(const PHEX *hex, int row_index)
+{
+   return (size_t)row_index * hex->width;
+}
+
+/**
+ * @brief Index of the row showing the byte at an offset.
+ * @return the row, the last row if @p offset is past the end, or -1
+ *         if the file is empty.
+ */
+EXPORT int pager_hex_row(const PHEX *hex, size_t offset)
+{
+   size_t row = offset / hex->width;
+   return row >= (size_t)hex->row_count ? hex->row_count - 1 : (int)row;
+}
+
+/**
+ * @brief Move the focus to the row showing a byte.
+ * @param "parms"   pager showing a @ref PHEX
+ * @param "offset"  offset in the file of the byte
+ * @return ARV_REPLOT_DATA, since the page may change.
+ *
+ * The row is shown at the top of the page unless it is already
+ * visible or on the last page.
+ */
+EXPORT ARV pager_hex_seek(DPARMS *parms, size_t offset)
+{
+   const PHEX *hex = (const PHEX*)parms->data_source;
+   if (hex->row_count == 0)
+      return ARV_CONTINUE;
+
+   int row = pager_hex_row(hex, offset);
+   parms->index_row_focus = row;
+
+   if (row < parms->index_row_top || row >= parms->index_row_top + parms->line_count)
+   {
+      int last_top = parms->row_count - parms->line_count;
+      parms->index_row_top = row < last_top ? row : last_top;
+      if (parms->index_row_top < 0)
+         parms->index_row_top = 0;
+   }
+
+   return ARV_REPLOT_DATA;
+}
+
+/**
+ * @brief @ref pwb_print_line function for hex dumps.
+ *
+ * The @p data_source must be a @ref PHEX.
+ */
+EXPORT int pager_hex_printer(int row_index,
+                             int indicated,
+                             int length,
+                             void *data_source,
+                             void *data_extra)
+{
+   const PHEX *hex = (const PHEX*)data_source;
+   if (row_index < 0 || row_index >= hex->row_count)
+      return 0;
+
+   char line[16 + 2 + 4 * HEX_MAX_WIDTH + HEX_MAX_WIDTH / 8 + 3];
+   int len = format_row(hex, row_index, line);
+   return pager_print_text(line, len, length, indicated);
+}
+
+/** @} */
@@ -0,0 +1,688 @@
+#include <stdlib.h>     // malloc/free
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "export.h"
+#include "pager.h"
+#include "pager_mfile.h"
+#include "pager_cache.h"
+
+/** @brief Lines indexed before the first enlargement of the index */
+#define JSONL_INDEX_START 4096
+
+/** @brief Rows whose extracted fields are kept, a power of 2 */
+#define JSONL_ROW_SLOTS 256
+
+/**
+ * @brief Extent of a key or value in the file.
+ */
+typedef struct jsonl_span {
+   const char *begin;       ///< NULL if the field is absent
+   const char *end;
+} JSPAN;
+
+/**
+ * @brief Identifies the projected field read by a table column.
+ */
+typedef struct jsonl_column {
+   PJSONL *jsonl;
+   int index;               ///< position among the projected fields
+   char *path;              ///< keys of the field, separated by '.'
+} JSONCOL;
+
+struct pager_jsonl {
+   MFILE mfile;
+
+   PCOFFSETS lines;         ///< offset of each line
+
+   JSONCOL *columns;        ///< projected fields, see pager_jsonl_columns()
+   int column_count;
+
+   int *slot_rows;          ///< row extracted into each slot, -1 if none
+   JSPAN *slot_spans;       ///< @p column_count values for each slot
+};
+
+/**
+ * @brief @ref pcache_scan function recording the offset of each line.
+ * @param "source"  source whose file is indexed
+ * @param "starts"  offsets of the lines of the file before it grew,
+ *                  allocated with malloc, or NULL to index the whole file
+ * @param "found"   [in,out] number of offsets in @p starts
+ *
+ * The last line of the smaller file may have grown too, so indexing
+ * resumes at its start.
+ */
+static size_t *index_lines(void *source, size_t *starts, int *found)
+{
+   PJSONL *jsonl = (PJSONL*)source;
+   int count = *found;
+
+   const char *data = jsonl->mfile.data;
+   const char *end = data + jsonl->mfile.size;
+   const char *ptr = data;
+
+   if (count > 0)
+      ptr = data + starts[--count];
+
+   int size = JSONL_INDEX_START;
+   while (size < count + 1)
+      size *= 2;
+
+   size_t *sized = (size_t*)realloc(starts, sizeof(size_t) * size);
+   if (sized == NULL)
+   {
+      free(starts);
+      return NULL;
+   }
+   starts = sized;
+
+   mfile_advise_sequential(&jsonl->mfile, true);
+
+   if (ptr < end)
+      starts[count++] = ptr - data;
+
+   while ((ptr = mfile_find_either(ptr, end, '\n', '\n')) < end)
+   {
+      if (++ptr == end)
+         break;
+
+      if (count >= size)
+      {
+         size_t *grown = (size_t*)realloc(starts, sizeof(size_t) * size * 2);
+         if (grown == NULL)
+         {
+            free(starts);
+            return NULL;
+         }
+         starts = grown;
+         size *= 2;
+      }
+
+      starts[count++] = ptr - data;
+   }
+
+   mfile_advise_sequential(&jsonl->mfile, false);
+
+   *found = count;
+   return starts;
+}
+
+static bool is_space(char chr)
+{
+   return chr == ' ' || chr == '\t' || chr == '\r' || chr == '\n';
+}
+
+static const char *skip_space(const char *ptr, const char *end)
+{
+   while (ptr < end && is_space(*ptr))
+      ++ptr;
+   return ptr;
+}
+
+/**
+ * @brief Find the closing quote of a string.
+ * @param "ptr"  first character after the opening quote
+ * @return pointer to the closing quote, or @p end if there is none.
+ *
+ * The string's contents are skipped with @ref mfile_find_either,
+ * stopping only at quotes and backslashes.
+ */
+static const char *skip_string(const char *ptr, const char *end)
+{
+   while ((ptr = mfile_find_either(ptr, end, '"', '\\')) < end)
+   {
+      if (*ptr == '"')
+         return ptr;
+
+      // Step over the escaped character:
+      ptr = end - ptr > 2 ? ptr + 2 : end;
+   }
+
+   return end;
+}
+
+/**
+ * @brief Find the next quote, brace or bracket, to skip over the
+ *        contents of an object or array.
+ *
+ * Braces and brackets differ only in bit 5, so where SSE2 is
+ * available sixteen bytes are tested for all five characters with
+ * three comparisons.
+ */
+static const char *find_structure(const char *ptr, const char *end)
+{
+#ifdef __SSE2__
+   const __m128i quote = _mm_set1_epi8('"');
+   const __m128i bit5 = _mm_set1_epi8(0x20);
+   const __m128i open = _mm_set1_epi8('{');
+   const __m128i close = _mm_set1_epi8('}');
+
+   for (; end - ptr >= 16; ptr += 16)
+   {
+      __m128i chunk = _mm_loadu_si128((const __m128i*)ptr);
+      __m128i folded = _mm_or_si128(chunk, bit5);
+      __m128i found = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                   _mm_or_si128(_mm_cmpeq_epi8(folded, open),
+                                                _mm_cmpeq_epi8(folded, close)));
+      int mask = _mm_movemask_epi8(found);
+      if (mask)
+         return ptr + __builtin_ctz(mask);
+   }
+#endif
+
+   for (; ptr < end; ++ptr)
+      if (*ptr == '"' || (*ptr | 0x20) == '{' || (*ptr | 0x20) == '}')
+         return ptr;
+
+   return end;
+}
+
+/**
+ * @brief Find the end of the value starting at @p ptr.
+ * @return pointer past the value, or @p end if it is unfinished.
+ *
+ * Objects and arrays are skipped by counting their braces and
+ * brackets, without looking at their members.
+ */
+static const char *skip_value(const char *ptr, const char *end)
+{
+   if (ptr < end && *ptr == '"')
+   {
+      ptr = skip_string(ptr + 1, end);
+      return ptr < end ? ptr + 1 : end;
+   }
+
+   if (ptr < end && (*ptr == '{' || *ptr == '['))
+   {
+      int depth = 0;
+      while ((ptr = find_structure(ptr, end)) < end)
+      {
+         if (*ptr == '"')
+         {
+            ptr = skip_string(ptr + 1, end);
+            if (ptr < end)
+               ++ptr;
+            continue;
+         }
+
+         if (*ptr == '{' || *ptr == '[')
+            ++depth;
+         else if (--depth == 0)
+            return ptr + 1;
+         ++ptr;
+      }
+
+      return end;
+   }
+
+   // A number or literal ends at a separator or space:
+   while (ptr < end && *ptr != ',' && *ptr != '}' && *ptr != ']' && !is_space(*ptr))
+      ++ptr;
+
+   return ptr;
+}
+
+/**
+ * @brief Read the next member of an object.
+ * @param "ptr"    [in,out] position after the opening brace or the
+ *                 previous member
+ * @param "end"    end of the object or line
+ * @param "key"    [out] the key, without its quotes
+ * @param "value"  [out] the value
+ * @return *false* at the end of the object, or where it is malformed.
+ */
+static bool next_member(const char **ptr, const char *end, JSPAN *key, JSPAN *value)
+{
+   const char *pos = skip_space(*ptr, end);
+   if (pos < end && *pos == ',')
+      pos = skip_space(pos + 1, end);
+
+   if (pos >= end || *pos != '"')
+      return false;
+
+   key->begin = pos + 1;
+   key->end = skip_string(key->begin, end);
+
+   pos = skip_space(key->end + (key->end < end ? 1 : 0), end);
+   if (pos >= end || *pos != ':')
+      return false;
+
+   value->begin = skip_space(pos + 1, end);
+   value->end = skip_value(value->begin, end);
+
+   *ptr = value->end;
+   return value->end > value->begin;
+}
+
+/**
+ * @brief Compare a key with the first key of a path.
+ */
+static bool key_matches(const JSPAN *key, const char *path, size_t len)
+{
+   return (size_t)(key->end - key->begin) == len && memcmp(key->begin, path, len) == 0;
+}
+
+/**
+ * @brief Find a value in an object by its path.
+ * @param "object"  extent of the object
+ * @param "path"    keys separated by '.'
+ * @return extent of the value, with a NULL @p begin if it is absent.
+ */
+static JSPAN find_path(JSPAN object, const char *path)
+{
+   JSPAN key, value;
+   const char *ptr = object.begin;
+
+   if (ptr < object.end && *ptr == '{')
+   {
+      size_t len = strcspn(path, ".");
+      ++ptr;
+      while (next_member(&ptr, object.end, &key, &value))
+         if (key_matches(&key, path, len))
+            return path[len] ? find_path(value, path + len + 1) : value;
+   }
+
+   return (JSPAN){ NULL, NULL };
+}
+
+/**
+ * @brief Find the values of projected fields in a line.
+ * @param "jsonl"      source holding the line
+ * @param "row_index"  line whose fields are wanted
+ * @param "columns"    fields to find
+ * @param "count"      number of elements in @p columns and @p values
+ * @param "values"     [out] value of each field
+ *
+ * The top-level object is read once for all the fields, stopping
+ * when all have been found, and only the objects holding nested
+ * fields are read member by member.  The values of other members
+ * are skipped over.  Where a key appears twice, the first is used.
+ */
+static void extract_fields(const PJSONL *jsonl, int row_index,
+                           const JSONCOL *columns, int count, JSPAN *values)
+{
+   for (int i = 0; i < count; ++i)
+      values[i].begin = values[i].end = NULL;
+
+   if (row_index < 0 || row_index >= jsonl->lines.count)
+      return;
+
+   const char *ptr = jsonl->mfile.data + jsonl->lines.starts[row_index];
+   const char *end = row_index + 1 < jsonl->lines.count
+      ? jsonl->mfile.data + jsonl->lines.starts[row_index + 1]
+      : jsonl->mfile.data + jsonl->mfile.size;
+
+   ptr = skip_space(ptr, end);
+   if (ptr >= end || *ptr != '{')
+      return;
+   ++ptr;
+
+   JSPAN key, value;
+   int missing = count;
+   while (missing > 0 && next_member(&ptr, end, &key, &value))
+   {
+      for (int i = 0; i < count; ++i)
+      {
+         const char *path = columns[i].path;
+         size_t len = strcspn(path, ".");
+         if (values[i].begin || !key_matches(&key, path, len))
+            continue;
+
+         values[i] = path[len] ? find_path(value, path + len + 1) : value;
+         if (values[i].begin)
+            --missing;
+      }
+   }
+}
+
+/**
+ * @brief Get the values of the projected fields of a row, from the
+ *        kept rows if possible.
+ *
+ * Rows are kept in slots by their index, so the rows of a page each
+ * have their own slot, and drawing the columns of a row, or
+ * scrolling sideways, reads the line once.
+ */
+static const JSPAN *row_values(PJSONL *jsonl, int row_index)
+{
+   int slot = row_index & (JSONL_ROW_SLOTS - 1);
+   JSPAN *values = jsonl->slot_spans + slot * jsonl->column_count;
+
+   if (jsonl->slot_rows[slot] != row_index)
+   {
+      extract_fields(jsonl, row_index, jsonl->columns, jsonl->column_count, values);
+      jsonl->slot_rows[slot] = row_index;
+   }
+
+   return values;
+}
+
+/**
+ * @brief Read the four hex digits of a `\u` escape.
+ * @return the code unit, or -1 if the digits are missing.
+ */
+static long read_code_unit(const char *ptr, const char *end)
+{
+   if (end - ptr < 4)
+      return -1;
+
+   long unit = 0;
+   for (int i = 0; i < 4; ++i)
+   {
+      char chr = ptr[i];
+      int digit;
+      if (chr >= '0' && chr <= '9')
+         digit = chr - '0';
+      else if ((chr | 0x20) >= 'a' && (chr | 0x20) <= 'f')
+         digit = (chr | 0x20) - 'a' + 10;
+      else
+         return -1;
+
+      unit = unit * 16 + digit;
+   }
+
+   return unit;
+}
+
+/**
+ * @brief Encode a code point as UTF-8.
+ * @return number of bytes written to @p utf8.
+ */
+static int encode_utf8(long point, char *utf8)
+{
+   if (point < 0x80)
+   {
+      utf8[0] = (char)point;
+      return 1;
+   }
+   if (point < 0x800)
+   {
+      utf8[0] = (char)(0xc0 | (point >> 6));
+      utf8[1] = (char)(0x80 | (point & 0x3f));
+      return 2;
+   }
+   if (point < 0x10000)
+   {
+      utf8[0] = (char)(0xe0 | (point >> 12));
+      utf8[1] = (char)(0x80 | ((point >> 6) & 0x3f));
+      utf8[2] = (char)(0x80 | (point & 0x3f));
+      return 3;
+   }
+
+   utf8[0] = (char)(0xf0 | (point >> 18));
+   utf8[1] = (char)(0x80 | ((point >> 12) & 0x3f));
+   utf8[2] = (char)(0x80 | ((point >> 6) & 0x3f));
+   utf8[3] = (char)(0x80 | (point & 0x3f));
+   return 4;
+}
+
+/**
+ * @brief Copy a value, unquoting and unescaping a string, and
+ *        replacing control characters.
+ * @return the length of the whole value, as with `snprintf`.
+ *
+ * Values other than strings, including objects and arrays, are
+ * copied as they are written in the file.
+ */
+static int copy_value(const JSPAN *value, char *buff, int bufflen)
+{
+   const char *ptr = value->begin;
+   const char *end = value->end;
+   bool string = ptr < end && *ptr == '"';
+   int len = 0;
+
+   if (string)
+   {
+      ++ptr;
+      if (end > ptr && end[-1] == '"')
+         --end;
+   }
+
+   while (ptr < end)
+   {
+      char utf8[4];
+      int count = 1;
+      utf8[0] = *ptr++;
+
+      if (string && utf8[0] == '\\' && ptr < end)
+      {
+         char chr = *ptr++;
+         if (chr == 'u')
+         {
+            long point = read_code_unit(ptr, end);
+            if (point >= 0)
+               ptr += 4;
+
+            // Join a surrogate pair, replacing a lone surrogate:
+            if (point >= 0xd800 && point < 0xdc00
+                && end - ptr >= 6 && ptr[0] == '\\' && ptr[1] == 'u')
+            {
+               long low = read_code_unit(ptr + 2, end);
+               if (low >= 0xdc00 && low < 0xe000)
+               {
+                  point = 0x10000 + ((point - 0xd800) << 10) + (low - 0xdc00);
+                  ptr += 6;
+               }
+            }
+            if (point < 0 || (point >= 0xd800 && point < 0xe000))
+               point = 0xfffd;
+
+            count = encode_utf8(point, utf8);
+         }
+         else if (chr == '"' || chr == '\\' || chr == '/')
+            utf8[0] = chr;
+         else
+            utf8[0] = ' ';
+      }
+
+      // Newlines and tabs in a field would disturb the screen:
+      if (count == 1 && (unsigned char)utf8[0] < ' ')
+         utf8[0] = ' ';
+
+      for (int i = 0; i < count; ++i)
+      {
+         if (len + 1 < bufflen)
+            buff[len] = utf8[i];
+         ++len;
+      }
+   }
+
+   if (bufflen > 0)
+      buff[len < bufflen ? len : bufflen - 1] = '\0';
+
+   return len;
+}
+
+/**
+ * @brief @ref pcol_text function for projected fields.
+ */
+static int jsonl_field_text(int row_index, char *buff, int bufflen, void *column_data)
+{
+   const JSONCOL *column = (const JSONCOL*)column_data;
+   const JSPAN *values = row_values(column->jsonl, row_index);
+   return copy_value(&values[column->index], buff, bufflen);
+}
+
+/**
+ * @brief Release the projected columns and the kept rows.
+ */
+static void free_columns(PJSONL *jsonl)
+{
+   for (int i = 0; i < jsonl->column_count; ++i)
+      free(jsonl->columns[i].path);
+
+   free(jsonl->columns);
+   free(jsonl->slot_rows);
+   free(jsonl->slot_spans);
+   jsonl->columns = NULL;
+   jsonl->slot_rows = NULL;
+   jsonl->slot_spans = NULL;
+   jsonl->column_count = 0;
+}
+
+/**
+ * @defgroup JSONL_SOURCE JSON lines files
+ * @brief Functions found in `pager_jsonl.c`
+ *
+ * A file of JSON objects, one to a line, as written by many
+ * loggers, is mapped into memory and indexed by line.  Selected
+ * fields are shown as table columns made by @ref pager_jsonl_columns,
+ * without reformatting the file.
+ *
+ * Fields are found only when a row is drawn, by one pass over the
+ * line that stops when every projected field is found.  Strings and
+ * nested values of other members are skipped by searching for the
+ * characters that end them, sixteen bytes at a time where SSE2 is
+ * available.  The fields found for the rows on the page are kept,
+ * so each line is read once however many of its fields are shown.
+ *
+ * To filter the rows on a field, give @ref pager_jsonl_text and the
+ * @p column_data of the field's column to @ref pager_filter_create,
+ * and the filter finds the field in the same way.
+ *
+ * As with delimited files, the index is saved in the cache
+ * directory, if one is set.
+ * @{
+ */
+
+/**
+ * @brief Map and index a file of JSON lines.
+ * @param "path"  file to open
+ * @return new source, or NULL if the file can't be read or out of
+ *         memory.  Release the source with @ref pager_jsonl_close.
+ *
+ * Each line is a row.  A line that isn't an object shows no fields.
+ */
+EXPORT PJSONL *pager_jsonl_open(const char *path)
+{
+   PJSONL *jsonl = (PJSONL*)calloc(1, sizeof(PJSONL));
+   if (jsonl == NULL)
+      return NULL;
+
+   if (!mfile_open(&jsonl->mfile, path))
+   {
+      free(jsonl);
+      return NULL;
+   }
+
+   if (!pcache_offsets_load(&jsonl->lines, "jsonl", &jsonl->mfile, index_lines, jsonl))
+   {
+      mfile_close(&jsonl->mfile);
+      free(jsonl);
+      return NULL;
+   }
+
+   return jsonl;
+}
+
+/**
+ * @brief Unmap the file and release the source.
+ *
+ * Destroy any table or filter using the columns of the source first.
+ */
+EXPORT void pager_jsonl_close(PJSONL *jsonl)
+{
+   free_columns(jsonl);
+   pcache_offsets_release(&jsonl->lines);
+   mfile_close(&jsonl->mfile);
+   free(jsonl);
+}
+
+/**
+ * @brief Number of lines in the file.
+ */
+EXPORT int pager_jsonl_row_count(const PJSONL *jsonl)
+{
+   return jsonl->lines.count;
+}
+
+/**
+ * @brief Make table columns showing selected fields of each line.
+ * @param "jsonl"  source whose fields are to be shown
+ * @param "paths"  keys of the fields, in display order, where the
+ *                 keys of nested objects are separated by '.', as
+ *                 in `"http.status"`
+ * @param "count"  number of elements in @p paths and @p defs
+ * @param "defs"   [out] column definitions for @ref pager_table_create
+ * @return *true* if done, *false* if out of memory.
+ *
+ * Keys are compared as they are written in the file, without
+ * undoing escapes.  String values are shown unquoted and unescaped,
+ * other values as they are written, and absent fields are empty.
+ * The columns are titled with their paths, and refer to the source,
+ * which must outlive the table.  Calling this again replaces the
+ * earlier columns, so destroy a table made from them first.
+ */
+EXPORT bool pager_jsonl_columns(PJSONL *jsonl, const char *const *paths, int count, PCOLUMN *defs)
+{
+   free_columns(jsonl);
+
+   jsonl->columns = (JSONCOL*)calloc(count ? count : 1, sizeof(JSONCOL));
+   jsonl->slot_rows = (int*)malloc(sizeof(int) * JSONL_ROW_SLOTS);
+   jsonl->slot_spans = (JSPAN*)malloc(sizeof(JSPAN) * JSONL_ROW_SLOTS * (count ? count : 1));
+   if (jsonl->columns == NULL || jsonl->slot_rows == NULL || jsonl->slot_spans == NULL)
+      goto abandon;
+
+   for (int i = 0; i < JSONL_ROW_SLOTS; ++i)
+      jsonl->slot_rows[i] = -1;
+
+   for (int i = 0; i < count; ++i)
+   {
+      JSONCOL *column = &jsonl->columns[i];
+      column->jsonl = jsonl;
+      column->index = i;
+      column->path = strdup(paths[i]);
+      if (column->path == NULL)
+         goto abandon;
+      ++jsonl->column_count;
+
+      memset(&defs[i], 0, sizeof(PCOLUMN));
+      defs[i].title = column->path;
+      defs[i].type = PCOL_CALLBACK;
+      defs[i].text = jsonl_field_text;
+      defs[i].column_data = column;
+   }
+
+   return true;
+
+  abandon:
+   free_columns(jsonl);
+   return false;
+}
+
+/**
+ * @brief @ref pager_row_text function getting one field of a row,
+ *        to filter the rows on that field.
+ * @param "data_source"  @p column_data of a column made by
+ *                       @ref pager_jsonl_columns
+ * @param "row_index"    row whose field is wanted
+ * @param "len"          [out] length of the value
+ * @return the value as written in the file, without the quotes of a
+ *         string, or NULL if the row has no such field.
+ *
+ * The kept rows aren't used, so filter threads can call this while
+ * the table is drawn.
+ */
+EXPORT const char *pager_jsonl_text(void *data_source, int row_index, int *len)
+{
+   const JSONCOL *column = (const JSONCOL*)data_source;
+   JSPAN value;
+
+   extract_fields(column->jsonl, row_index, column, 1, &value);
+   if (value.begin == NULL)
+      return NULL;
+
+   if (*value.begin == '"')
+   {
+      ++value.begin;
+      if (value.end > value.begin && value.end[-1] == '"')
+         --value.end;
+   }
+
+   *len = (int)(value.end - value.begin);
+   return value.begin;
+}
+
+/** @} */
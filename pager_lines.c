@@ -0,0 +1,426 @@
+#include <stdlib.h>     // malloc/free
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>     // read(), close()
+#include <fcntl.h>
+#include <errno.h>
+
+#include "export.h"
+#include "pager.h"
+#include "pager_private.h"
+
+/** @brief Size of a chunk, unless a longer line needs more */
+#define LINES_CHUNK_SIZE (1024 * 1024)
+
+/** @brief Bytes read at once by @ref pager_lines_read_fd */
+#define LINES_READ_SIZE (256 * 1024)
+
+/**
+ * @brief A block of line text.
+ *
+ * Lines are stored end to end without their newlines, and never
+ * span chunks.
+ */
+typedef struct line_chunk {
+   char *data;
+   uint32_t used;           ///< bytes used, including an unfinished line
+   uint32_t size;           ///< bytes allocated to @p data
+   uint32_t rows_end;       ///< end of the last finished line
+   int first_row;           ///< index of the first line in the chunk
+} LCHUNK;
+
+struct pager_lines {
+   LCHUNK *chunks;
+   int chunk_count;
+   int chunks_size;         ///< elements allocated to @p chunks
+
+   uint32_t *starts;        ///< offset of each line in its chunk
+   int row_count;
+   int starts_size;         ///< elements allocated to @p starts
+
+   bool in_line;            ///< an unfinished line is at the end of the last chunk
+   uint32_t line_start;     ///< offset of the unfinished line
+};
+
+/**
+ * @brief Add a chunk large enough for @p needed bytes.
+ */
+static LCHUNK *add_chunk(PLINES *store, size_t needed)
+{
+   if (store->chunk_count >= store->chunks_size)
+   {
+      int size = store->chunks_size ? store->chunks_size * 2 : 16;
+      LCHUNK *chunks = (LCHUNK*)realloc(store->chunks, sizeof(LCHUNK) * size);
+      if (chunks == NULL)
+         return NULL;
+
+      store->chunks = chunks;
+      store->chunks_size = size;
+   }
+
+   size_t size = LINES_CHUNK_SIZE;
+   while (size < needed)
+      size *= 2;
+
+   if (size > UINT32_MAX)
+      return NULL;
+
+   LCHUNK *chunk = &store->chunks[store->chunk_count];
+   chunk->data = (char*)malloc(size);
+   if (chunk->data == NULL)
+      return NULL;
+
+   chunk->size = (uint32_t)size;
+   chunk->used = chunk->rows_end = 0;
+   chunk->first_row = store->row_count;
+   ++store->chunk_count;
+   return chunk;
+}
+
+/**
+ * @brief Make room for @p len more bytes of the current line.
+ * @return the chunk holding the current line, or NULL if out of memory.
+ *
+ * An unfinished line that doesn't fit is moved to a new chunk,
+ * unless it's alone in its chunk, which is then enlarged.
+ */
+static LCHUNK *reserve(PLINES *store, size_t len)
+{
+   LCHUNK *chunk = store->chunk_count ? &store->chunks[store->chunk_count - 1] : NULL;
+
+   if (chunk && (size_t)chunk->used + len <= chunk->size)
+      return chunk;
+
+   size_t partial = store->in_line ? chunk->used - store->line_start : 0;
+   size_t needed = partial + len;
+
+   if (chunk && chunk->first_row == store->row_count)
+   {
+      // No finished lines in the chunk, so enlarge it:
+      size_t size = chunk->size;
+      while (size < chunk->used + len)
+         size *= 2;
+
+      char *data = size > UINT32_MAX ? NULL : (char*)realloc(chunk->data, size);
+      if (data == NULL)
+         return NULL;
+
+      chunk->data = data;
+      chunk->size = (uint32_t)size;
+      return chunk;
+   }
+
+   LCHUNK *fresh = add_chunk(store, needed);
+   if (fresh == NULL)
+      return NULL;
+
+   if (store->in_line)
+   {
+      // add_chunk() may have moved the array:
+      chunk = fresh - 1;
+
+      memcpy(fresh->data, chunk->data + store->line_start, partial);
+      fresh->used = (uint32_t)partial;
+      chunk->used = store->line_start;
+      store->line_start = 0;
+   }
+
+   return fresh;
+}
+
+/**
+ * @brief Add bytes to the current line, starting a line if necessary.
+ */
+static bool add_text(PLINES *store, const char *text, size_t len)
+{
+   LCHUNK *chunk = reserve(store, len);
+   if (chunk == NULL)
+      return false;
+
+   if (!store->in_line)
+   {
+      store->in_line = true;
+      store->line_start = chunk->used;
+   }
+
+   memcpy(chunk->data + chunk->used, text, len);
+   chunk->used += (uint32_t)len;
+   return true;
+}
+
+/**
+ * @brief Finish the current line, which may be empty.
+ */
+static bool end_line(PLINES *store)
+{
+   if (!store->in_line && !add_text(store, "", 0))
+      return false;
+
+   if (store->row_count >= store->starts_size)
+   {
+      int size = store->starts_size ? store->starts_size * 2 : 4096;
+      uint32_t *starts = (uint32_t*)realloc(store->starts, sizeof(uint32_t) * size);
+      if (starts == NULL)
+         return false;
+
+      store->starts = starts;
+      store->starts_size = size;
+   }
+
+   LCHUNK *chunk = &store->chunks[store->chunk_count - 1];
+   store->starts[store->row_count++] = store->line_start;
+   chunk->rows_end = chunk->used;
+   store->in_line = false;
+   return true;
+}
+
+/**
+ * @brief Find the chunk holding a line.
+ */
+static const LCHUNK *find_chunk(const PLINES *store, int row_index)
+{
+   int low = 0, high = store->chunk_count - 1;
+   while (low < high)
+   {
+      int mid = (low + high + 1) / 2;
+      if (store->chunks[mid].first_row <= row_index)
+         low = mid;
+      else
+         high = mid - 1;
+   }
+   return &store->chunks[low];
+}
+
+/**
+ * @defgroup LINE_STORE Line store for piped input
+ * @brief Functions found in `pager_lines.c`
+ *
+ * Lines are copied end to end into large chunks, and each line
+ * is indexed by its 32-bit offset in its chunk, so storing a line
+ * costs 4 bytes beyond its text, and allocations are few.
+ * @{
+ */
+
+/**
+ * @brief Create an empty line store.
+ * @return new store, or NULL if out of memory.  Release the store
+ *         with @ref pager_lines_destroy.
+ */
+EXPORT PLINES *pager_lines_create(void)
+{
+   return (PLINES*)calloc(1, sizeof(PLINES));
+}
+
+EXPORT void pager_lines_destroy(PLINES *store)
+{
+   for (int i = 0; i < store->chunk_count; ++i)
+      free(store->chunks[i].data);
+
+   free(store->chunks);
+   free(store->starts);
+   free(store);
+}
+
+/**
+ * @brief Add text to the store.
+ * @param "store"  store to which text is added
+ * @param "text"   text, which may begin or end within a line
+ * @param "len"    number of bytes in @p text
+ * @return *true* if done, *false* if out of memory.
+ *
+ * Lines end with newlines, which are not stored.  Text can be added
+ * in pieces of any size, as read.  Call @ref pager_lines_finish
+ * after the last piece.
+ */
+EXPORT bool pager_lines_append(PLINES *store, const char *text, size_t len)
+{
+   const char *end = text + len;
+   while (text < end)
+   {
+      const char *newline = (const char*)memchr(text, '\n', end - text);
+      const char *stop = newline ? newline : end;
+
+      if (stop > text && !add_text(store, text, stop - text))
+         return false;
+
+      if (newline == NULL)
+         break;
+
+      if (!end_line(store))
+         return false;
+
+      text = newline + 1;
+   }
+
+   return true;
+}
+
+/**
+ * @brief Finish a last line that had no newline, and release
+ *        unused space.
+ */
+EXPORT bool pager_lines_finish(PLINES *store)
+{
+   if (store->in_line && !end_line(store))
+      return false;
+
+   if (store->row_count && store->row_count < store->starts_size)
+   {
+      uint32_t *starts = (uint32_t*)realloc(store->starts, sizeof(uint32_t) * store->row_count);
+      if (starts)
+      {
+         store->starts = starts;
+         store->starts_size = store->row_count;
+      }
+   }
+
+   if (store->chunk_count)
+   {
+      LCHUNK *chunk = &store->chunks[store->chunk_count - 1];
+      if (chunk->used && chunk->used < chunk->size)
+      {
+         char *data = (char*)realloc(chunk->data, chunk->used);
+         if (data)
+         {
+            chunk->data = data;
+            chunk->size = chunk->used;
+         }
+      }
+   }
+
+   return true;
+}
+
+/**
+ * @brief Read a file descriptor to its end, adding its lines.
+ * @return *true* if read to the end, *false* on error.
+ *
+ * This works with pipes and other descriptors that can't seek.
+ */
+EXPORT bool pager_lines_read_fd(PLINES *store, int fd)
+{
+   char *buff = (char*)malloc(LINES_READ_SIZE);
+   if (buff == NULL)
+      return false;
+
+   bool ok = true;
+   for (;;)
+   {
+      ssize_t len = read(fd, buff, LINES_READ_SIZE);
+      if (len < 0 && errno == EINTR)
+         continue;
+
+      if (len <= 0)
+      {
+         ok = len == 0;
+         break;
+      }
+
+      if (!pager_lines_append(store, buff, len))
+      {
+         ok = false;
+         break;
+      }
+   }
+
+   free(buff);
+   return pager_lines_finish(store) && ok;
+}
+
+/**
+ * @brief Read a file, or standard input if @p path is "-".
+ */
+EXPORT bool pager_lines_read_file(PLINES *store, const char *path)
+{
+   if (strcmp(path, "-") == 0)
+      return pager_lines_read_fd(store, STDIN_FILENO);
+
+   int fd = open(path, O_RDONLY);
+   if (fd < 0)
+      return false;
+
+   bool ok = pager_lines_read_fd(store, fd);
+   close(fd);
+   return ok;
+}
+
+/**
+ * @brief Number of finished lines in the store.
+ */
+EXPORT int pager_lines_count(const PLINES *store)
+{
+   return store->row_count;
+}
+
+/**
+ * @brief Bytes allocated by the store, for comparing with other stores.
+ */
+EXPORT size_t pager_lines_memory(const PLINES *store)
+{
+   size_t total = sizeof(PLINES)
+      + sizeof(LCHUNK) * store->chunks_size
+      + sizeof(uint32_t) * store->starts_size;
+
+   for (int i = 0; i < store->chunk_count; ++i)
+      total += store->chunks[i].size;
+
+   return total;
+}
+
+/**
+ * @brief Get the text of a line.
+ * @param "store"      store holding the line
+ * @param "row_index"  index of the line
+ * @param "len"        [out] length of the line
+ * @return pointer to the line, which is not NUL-terminated, or NULL
+ *         if out of range.
+ */
+EXPORT const char *pager_lines_get(const PLINES *store, int row_index, int *len)
+{
+   if (row_index < 0 || row_index >= store->row_count)
+      return NULL;
+
+   const LCHUNK *chunk = find_chunk(store, row_index);
+   uint32_t start = store->starts[row_index];
+   uint32_t end = chunk->rows_end;
+
+   // The line ends where the next begins, if in the same chunk:
+   if (row_index + 1 < store->row_count
+       && (chunk == &store->chunks[store->chunk_count - 1]
+           || row_index + 1 < chunk[1].first_row))
+      end = store->starts[row_index + 1];
+
+   *len = (int)(end - start);
+   return chunk->data + start;
+}
+
+/**
+ * @brief @ref pager_row_text function for a line store, to show
+ *        its colours with @ref pager_ansi_create.
+ */
+EXPORT const char *pager_lines_text(void *data_source, int row_index, int *len)
+{
+   return pager_lines_get((const PLINES*)data_source, row_index, len);
+}
+
+/**
+ * @brief @ref pwb_print_line function for a line store.
+ *
+ * The @p data_source must be a @ref PLINES.  Control characters
+ * are written as spaces.
+ */
+EXPORT int pager_lines_printer(int row_index,
+                               int indicated,
+                               int length,
+                               void *data_source,
+                               void *data_extra)
+{
+   int len;
+   const char *line = pager_lines_get((const PLINES*)data_source, row_index, &len);
+   if (line == NULL)
+      return 0;
+
+   return pager_print_text(line, len, length, indicated);
+}
+
+/** @} */
@@ -0,0 +1,111 @@
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "pager_mfile.h"
+
+/**
+ * @brief Map a file into memory.
+ * @param "mfile"  struct to be initialized
+ * @param "path"   file to map
+ * @return *true* if mapped, *false* if the file can't be opened or mapped.
+ *
+ * The descriptor is closed once the file is mapped.  Release the
+ * mapping with @ref mfile_close.
+ */
+bool mfile_open(MFILE *mfile, const char *path)
+{
+   memset(mfile, 0, sizeof(MFILE));
+
+   int fd = open(path, O_RDONLY);
+   if (fd < 0)
+      return false;
+
+   struct stat st;
+   if (fstat(fd, &st) || !S_ISREG(st.st_mode))
+   {
+      close(fd);
+      return false;
+   }
+
+   mfile->device = st.st_dev;
+   mfile->inode = st.st_ino;
+   mfile->mtime = st.st_mtim;
+
+   // An empty file can't be mapped, but is still a valid file:
+   if (st.st_size > 0)
+   {
+      void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED)
+      {
+         close(fd);
+         return false;
+      }
+
+      mfile->data = (const char*)data;
+      mfile->size = st.st_size;
+   }
+
+   close(fd);
+   return true;
+}
+
+/**
+ * @brief Unmap a file mapped with @ref mfile_open.
+ */
+void mfile_close(MFILE *mfile)
+{
+   if (mfile->data)
+      munmap((void*)mfile->data, mfile->size);
+
+   memset(mfile, 0, sizeof(MFILE));
+}
+
+/**
+ * @brief Tell the kernel whether the file is about to be read through.
+ *
+ * Set @p sequential while scanning the whole file to have it read
+ * ahead aggressively, then clear it for the random access of paging.
+ */
+void mfile_advise_sequential(const MFILE *mfile, bool sequential)
+{
+   if (mfile->data)
+      madvise((void*)mfile->data, mfile->size,
+              sequential ? MADV_SEQUENTIAL : MADV_NORMAL);
+}
+
+/**
+ * @brief Find the first byte equal to either @p first or @p second.
+ * @return pointer to the byte found, or @p end if neither was found.
+ *
+ * Pass the same character twice to search for one character.
+ * Sixteen bytes are compared at a time where SSE2 is available.
+ */
+const char *mfile_find_either(const char *ptr, const char *end, char first, char second)
+{
+#ifdef __SSE2__
+   __m128i match_first = _mm_set1_epi8(first);
+   __m128i match_second = _mm_set1_epi8(second);
+
+   for (; end - ptr >= 16; ptr += 16)
+   {
+      __m128i chunk = _mm_loadu_si128((const __m128i*)ptr);
+      int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, match_first),
+                                                _mm_cmpeq_epi8(chunk, match_second)));
+      if (mask)
+         return ptr + __builtin_ctz(mask);
+   }
+#endif
+
+   for (; ptr < end; ++ptr)
+      if (*ptr == first || *ptr == second)
+         return ptr;
+
+   return end;
+}
@@ -0,0 +1,26 @@
+#ifndef PAGER_MFILE_H
+#define PAGER_MFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include <sys/types.h>
+
+/**
+ * @brief A file mapped read-only into memory.
+ */
+typedef struct mapped_file {
+   const char *data;        ///< file contents, NULL if the file is empty
+   size_t size;             ///< bytes in @p data
+   dev_t device;            ///< identity of the file, to key cached indexes
+   ino_t inode;
+   struct timespec mtime;   ///< when the file was last changed
+} MFILE;
+
+bool mfile_open(MFILE *mfile, const char *path);
+void mfile_close(MFILE *mfile);
+void mfile_advise_sequential(const MFILE *mfile, bool sequential);
+
+const char *mfile_find_either(const char *ptr, const char *end, char first, char second);
+
+#endif
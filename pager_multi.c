@@ -0,0 +1,397 @@
+#include <stdlib.h>     // malloc/free
+#include <string.h>
+#include <limits.h>
+
+#include "export.h"
+#include "pager.h"
+#include "pager_private.h"
+#include "pager_mfile.h"
+
+/** @brief Files kept mapped if @ref pager_multi_open isn't given a limit */
+#define MULTI_DEFAULT_OPEN 16
+
+/**
+ * @brief A mapped file and the offsets of its lines.
+ */
+typedef struct multi_slot {
+   MFILE mfile;
+   size_t *starts;          ///< offset of each line
+   int line_count;          ///< lines in @p starts
+   int file;                ///< index of the file, -1 if the slot is empty
+   unsigned long used;      ///< when last read, to find the least recent
+} MSLOT;
+
+struct pager_multi {
+   char **paths;
+   int file_count;
+
+   /**
+    * First row of each counted file, with the rows of all counted
+    * files after the last.  Only the thread extending the rows
+    * writes these, and only past @p counted, so lines can be looked
+    * up while the count continues.
+    */
+   int *firsts;
+   int counted;             ///< files whose rows are known, atomic
+
+   MSLOT *slots;            ///< mapped files, read by the UI thread only
+   int slot_count;
+   int last_slot;           ///< slot of the last row read
+   unsigned long clock;     ///< advanced on each change of slot
+};
+
+/**
+ * @brief Count the lines of a file, including an unfinished last line.
+ */
+static int count_lines(const char *path)
+{
+   MFILE mfile;
+   if (!mfile_open(&mfile, path))
+      return 0;
+
+   mfile_advise_sequential(&mfile, true);
+
+   long count = 0;
+   const char *ptr = mfile.data;
+   const char *end = ptr + mfile.size;
+   while (ptr < end && count < INT_MAX)
+   {
+      const char *newline = memchr(ptr, '\n', end - ptr);
+      ++count;
+      ptr = newline ? newline + 1 : end;
+   }
+
+   mfile_close(&mfile);
+   return (int)count;
+}
+
+/**
+ * @brief Empty a slot, unmapping its file.
+ */
+static void clear_slot(MSLOT *slot)
+{
+   mfile_close(&slot->mfile);
+   free(slot->starts);
+   slot->starts = NULL;
+   slot->line_count = 0;
+   slot->file = -1;
+}
+
+/**
+ * @brief Map a file into a slot and find its lines.
+ * @return *true* if mapped, *false* if the file can't be read.
+ *
+ * No more lines are found than were counted, so rows keep their
+ * places if the file has grown since.
+ */
+static bool fill_slot(PMULTI *multi, MSLOT *slot, int file)
+{
+   int wanted = multi->firsts[file + 1] - multi->firsts[file];
+
+   if (!mfile_open(&slot->mfile, multi->paths[file]))
+      return false;
+
+   slot->starts = (size_t*)malloc(sizeof(size_t) * (wanted ? wanted : 1));
+   if (slot->starts == NULL)
+   {
+      mfile_close(&slot->mfile);
+      return false;
+   }
+
+   const char *data = slot->mfile.data;
+   size_t size = slot->mfile.size;
+   size_t offset = 0;
+   int count = 0;
+   while (count < wanted && offset < size)
+   {
+      slot->starts[count++] = offset;
+      const char *newline = memchr(data + offset, '\n', size - offset);
+      offset = newline ? (size_t)(newline - data) + 1 : size;
+   }
+
+   slot->line_count = count;
+   slot->file = file;
+   return true;
+}
+
+/**
+ * @brief Get the slot of a file, mapping it in place of the least
+ *        recently read file if it isn't mapped.
+ * @return the slot, or NULL if the file can't be read.
+ */
+static MSLOT *get_slot(PMULTI *multi, int file)
+{
+   MSLOT *slot = &multi->slots[multi->last_slot];
+   if (slot->file == file)
+      return slot;
+
+   MSLOT *oldest = multi->slots;
+   for (int i = 0; i < multi->slot_count; ++i)
+   {
+      slot = &multi->slots[i];
+      if (slot->file == file)
+      {
+         slot->used = ++multi->clock;
+         multi->last_slot = i;
+         return slot;
+      }
+
+      if (slot->used < oldest->used)
+         oldest = slot;
+   }
+
+   clear_slot(oldest);
+   if (!fill_slot(multi, oldest, file))
+      return NULL;
+
+   oldest->used = ++multi->clock;
+   multi->last_slot = (int)(oldest - multi->slots);
+   return oldest;
+}
+
+/**
+ * @brief Find the counted file holding a row.
+ * @return index of the file, or -1 if the row isn't counted.
+ *
+ * Empty files share their first row with the next file, so the
+ * last file starting at or before the row holds it.
+ */
+static int find_file(const PMULTI *multi, int row_index)
+{
+   int counted = __atomic_load_n(&multi->counted, __ATOMIC_ACQUIRE);
+   if (row_index < 0 || row_index >= multi->firsts[counted])
+      return -1;
+
+   int low = 0, high = counted;
+   while (high - low > 1)
+   {
+      int middle = low + (high - low) / 2;
+      if (multi->firsts[middle] <= row_index)
+         low = middle;
+      else
+         high = middle;
+   }
+
+   return low;
+}
+
+/**
+ * @defgroup MULTI_FILE_SOURCE Files paged as one
+ * @brief Functions found in `pager_multi.c`
+ *
+ * Pages a list of files, such as the rotated segments of a log, as
+ * if they were one file, without copying them.
+ *
+ * Files are counted in order only as the view reaches them, through
+ * the @ref pager_extend function @ref pager_multi_extend, so the
+ * total is known only when the last file is counted.
+ * @ref pager_focus_end counts the rest, in the background if the
+ * pager belongs to a @ref PCONTEXT.  A row is found in its file by a
+ * binary search of the first rows of the counted files.
+ *
+ * To show rows, the files holding them are mapped and their lines
+ * found.  Only a few are kept mapped at once, the least recently
+ * read being released to map another.
+ *
+ * A file that can't be read has no rows.  If a file grows after it
+ * is counted, the new lines aren't shown.
+ * @{
+ */
+
+/**
+ * @brief Page a list of files as one.
+ * @param "paths"     files in the order they are shown
+ * @param "count"     number of files
+ * @param "max_open"  most files kept mapped, or 0 for 16
+ * @return new source, or NULL if out of memory.  Release the source
+ *         with @ref pager_multi_close.
+ *
+ * No file is read until rows are wanted.  Initialize the pager with
+ * 0 rows and set @ref pager_multi_extend as its extend function:
+ *
+ * ~~~c
+ * pager_init_dparms(&parms, multi, 0, pager_multi_printer, NULL);
+ * pager_set_extend(&parms, pager_multi_extend);
+ * ~~~
+ */
+EXPORT PMULTI *pager_multi_open(const char *const *paths, int count, int max_open)
+{
+   PMULTI *multi = (PMULTI*)calloc(1, sizeof(PMULTI));
+   if (multi == NULL)
+      return NULL;
+
+   if (max_open <= 0)
+      max_open = MULTI_DEFAULT_OPEN;
+
+   multi->paths = (char**)calloc(count ? count : 1, sizeof(char*));
+   multi->firsts = (int*)calloc(count + 1, sizeof(int));
+   multi->slots = (MSLOT*)calloc(max_open, sizeof(MSLOT));
+   if (multi->paths == NULL || multi->firsts == NULL || multi->slots == NULL)
+      goto abandon;
+
+   for (int i = 0; i < count; ++i)
+   {
+      multi->paths[i] = strdup(paths[i]);
+      if (multi->paths[i] == NULL)
+         goto abandon;
+      ++multi->file_count;
+   }
+
+   multi->slot_count = max_open;
+   for (int i = 0; i < max_open; ++i)
+      multi->slots[i].file = -1;
+
+   return multi;
+
+  abandon:
+   pager_multi_close(multi);
+   return NULL;
+}
+
+/**
+ * @brief Release the source, unmapping its files.
+ */
+EXPORT void pager_multi_close(PMULTI *multi)
+{
+   if (multi->slots)
+      for (int i = 0; i < multi->slot_count; ++i)
+         clear_slot(&multi->slots[i]);
+   free(multi->slots);
+
+   if (multi->paths)
+      for (int i = 0; i < multi->file_count; ++i)
+         free(multi->paths[i]);
+   free(multi->paths);
+
+   free(multi->firsts);
+   free(multi);
+}
+
+/**
+ * @brief @ref pager_extend function, counting files until @p wanted
+ *        rows are known.
+ *
+ * Each file is read through once to count its lines, without being
+ * kept mapped.  The rows of files already counted may be read while
+ * this runs on the count thread.
+ */
+EXPORT int pager_multi_extend(void *data_source, int known, int wanted)
+{
+   PMULTI *multi = (PMULTI*)data_source;
+   int counted = multi->counted;
+   int rows = multi->firsts[counted];
+
+   while (rows < wanted && counted < multi->file_count)
+   {
+      int lines = count_lines(multi->paths[counted]);
+      rows = lines > INT_MAX - rows ? INT_MAX : rows + lines;
+
+      multi->firsts[counted + 1] = rows;
+      __atomic_store_n(&multi->counted, ++counted, __ATOMIC_RELEASE);
+
+      // Rows past INT_MAX can't be shown, so the count ends:
+      if (rows == INT_MAX)
+         break;
+   }
+
+   return rows;
+}
+
+/**
+ * @brief Number of rows in the files counted so far.
+ */
+EXPORT int pager_multi_row_count(const PMULTI *multi)
+{
+   return multi->firsts[__atomic_load_n(&multi->counted, __ATOMIC_ACQUIRE)];
+}
+
+/**
+ * @brief Find the file holding a row, as for a status line.
+ * @param "multi"      source holding the row
+ * @param "row_index"  index of the row
+ * @param "line"       [out] index of the row in its file, or NULL
+ * @return index of the file in the list given to
+ *         @ref pager_multi_open, or -1 if the row isn't counted.
+ */
+EXPORT int pager_multi_file(const PMULTI *multi, int row_index, int *line)
+{
+   int file = find_file(multi, row_index);
+   if (file >= 0 && line)
+      *line = row_index - multi->firsts[file];
+
+   return file;
+}
+
+/**
+ * @brief Get the path of a file, as given to @ref pager_multi_open.
+ */
+EXPORT const char *pager_multi_path(const PMULTI *multi, int file)
+{
+   return file >= 0 && file < multi->file_count ? multi->paths[file] : NULL;
+}
+
+/**
+ * @brief Get the text of a line.
+ * @param "multi"      source holding the line
+ * @param "row_index"  index of the line
+ * @param "len"        [out] length of the line, without its newline
+ * @return pointer to the line, which is not NUL-terminated, or NULL
+ *         if out of range or the file can't be read.
+ *
+ * The pointer remains valid until lines of as many other files as
+ * are kept mapped have been read.  Call this from one thread only.
+ */
+EXPORT const char *pager_multi_line(PMULTI *multi, int row_index, int *len)
+{
+   int file = find_file(multi, row_index);
+   if (file < 0)
+      return NULL;
+
+   MSLOT *slot = get_slot(multi, file);
+   if (slot == NULL)
+      return NULL;
+
+   int line_index = row_index - multi->firsts[file];
+   if (line_index >= slot->line_count)
+      return NULL;
+
+   const char *data = slot->mfile.data;
+   size_t size = slot->mfile.size;
+   size_t start = slot->starts[line_index];
+   const char *newline = memchr(data + start, '\n', size - start);
+
+   *len = (int)((newline ? (size_t)(newline - data) : size) - start);
+   return data + start;
+}
+
+/**
+ * @brief @ref pager_row_text function for lists of files, to show
+ *        their colours with @ref pager_ansi_create.
+ */
+EXPORT const char *pager_multi_text(void *data_source, int row_index, int *len)
+{
+   return pager_multi_line((PMULTI*)data_source, row_index, len);
+}
+
+/**
+ * @brief @ref pwb_print_line function for lists of files.
+ *
+ * The @p data_source must be a @ref PMULTI.  Control characters are
+ * written as spaces.  A row whose file can no longer be read, as when
+ * a rotated log is removed, is left blank.
+ */
+EXPORT int pager_multi_printer(int row_index,
+                               int indicated,
+                               int length,
+                               void *data_source,
+                               void *data_extra)
+{
+   int len;
+   const char *line = pager_multi_line((PMULTI*)data_source, row_index, &len);
+   if (line == NULL)
+      return pager_write_spans(NULL, 0, length, indicated);
+
+   return pager_print_text(line, len, length, indicated);
+}
+
+/** @} */
@@ -1,10 +1,12 @@
 #include <string.h>
+#include <limits.h>     // INT_MAX
 #include <curses.h>
 #include <term.h>
 
 #include "export.h"
 #include "termstuff.h"
 #include "pager.h"
+#include "pager_private.h"
 
 
 /**
@@ -38,6 +40,8 @@ EXPORT void pager_init_dparms(DPARMS *parms,
  */
 EXPORT void pager_calc_borders(DPARMS *parms)
 {
+   pager_select(parms);
+
    int rows, cols;
    ti_get_screen_size(&rows, &cols);
 
@@ -47,7 +51,9 @@ EXPORT void pager_calc_borders(DPARMS *parms)
    parms->chars_left = parms->margin_left;
    parms->chars_count = cols - parms->margin_left - parms->margin_right;
 
-   ti_set_scroll_limit(parms->margin_top, parms->line_count - 1);
+   // The scroll limit will be set when the terminal is initialized:
+   if (ti_values_initialized())
+      ti_set_scroll_limit(parms->margin_top, parms->line_count - 1);
 }
 
 /**
@@ -81,6 +87,8 @@ EXPORT bool pager_set_margins(DPARMS *parms, int top, int right, int bottom, int
    else if (left < 0)
       left = right;
 
+   pager_select(parms);
+
    int rows, cols;
    ti_get_screen_size(&rows, &cols);
 
@@ -98,3 +106,128 @@ EXPORT bool pager_set_margins(DPARMS *parms, int top, int right, int bottom, int
    return false;
 }
 
+/**
+ * @brief Draw on another terminal than the process's own.
+ * @param "parms"  Initialized @ref DPARMS struct
+ * @param "term"   terminal from @ref pager_term_open, or NULL for
+ *                 the process's terminal
+ *
+ * Borders are recalculated for the screen size of @p term.
+ */
+EXPORT void pager_set_term(DPARMS *parms, PTERM *term)
+{
+   parms->term = term;
+   pager_calc_borders(parms);
+}
+
+/**
+ * @brief Page a source whose length isn't known in advance.
+ * @param "parms"   Initialized @ref DPARMS struct
+ * @param "extend"  function to ask the source for more rows
+ *
+ * The @p row_count of @p parms is taken as the rows available so
+ * far, which can be 0.  The pager asks for more rows as the view
+ * nears the last known row, so a database cursor or generator is
+ * only read as far as it is shown.  The @p extend member is cleared
+ * when the source reports its end, and @p row_count is then exact.
+ *
+ * @ref pager_focus_end counts the remaining rows, in the background
+ * if @p parms belongs to a @ref PCONTEXT.
+ */
+EXPORT void pager_set_extend(DPARMS *parms, pager_extend extend)
+{
+   parms->extend = extend;
+}
+
+/**
+ * @brief Have a source told of the rows about to be drawn.
+ * @param "parms"    Initialized @ref DPARMS struct
+ * @param "prepare"  function told of the rows, or NULL
+ *
+ * Each screen update calls @p prepare once, with the rows it is
+ * about to draw, before calling the printer for them.  A source
+ * that fetches its rows from a database or server can then fetch
+ * them in one request instead of one for each row drawn.
+ */
+EXPORT void pager_set_prepare(DPARMS *parms, pager_prepare prepare)
+{
+   parms->prepare = prepare;
+}
+
+/**
+ * @brief Tell the source of @p parms which rows are about to be drawn.
+ * @param "parms"  pager about to draw
+ * @param "first"  index of the first row to be drawn
+ * @param "last"   index of the last row to be drawn
+ *
+ * Rows past the end of the source are left out.
+ */
+void pager_prepare_rows(const DPARMS *parms, int first, int last)
+{
+   if (parms->prepare == NULL)
+      return;
+
+   if (last >= parms->row_count)
+      last = parms->row_count - 1;
+   if (first < 0)
+      first = 0;
+   if (first > last)
+      return;
+
+   PTRACE_BEGIN(trace);
+   (*parms->prepare)(parms->data_source, first, last - first + 1,
+                     parms->index_row_top, parms->line_count);
+   PTRACE_END(trace, "prepare", "rows", last - first + 1);
+}
+
+/**
+ * @brief Ask a source of unknown length for rows up to @p wanted.
+ *
+ * Does nothing if the rows are already known, so call this freely
+ * before moving toward the end of the rows.  A page more than
+ * wanted is asked for, so moving one row at a time doesn't call the
+ * source for every row.
+ */
+void pager_extend_rows(DPARMS *parms, int wanted)
+{
+   if (parms->extend == NULL || wanted <= parms->row_count)
+      return;
+
+   if (parms->line_count > 0 && wanted < INT_MAX - parms->line_count)
+      wanted += parms->line_count;
+
+   if (parms->context)
+   {
+      pager_context_extend(parms->context, wanted);
+      return;
+   }
+
+   int rows = (*parms->extend)(parms->data_source, parms->row_count, wanted);
+   if (rows > parms->row_count)
+      parms->row_count = rows;
+   if (rows < wanted)
+      parms->extend = NULL;
+}
+
+/**
+ * @brief Count the rows of a source of unknown length.
+ * @return *true* if @p row_count is now exact, *false* if the count
+ *         continues in the background.
+ */
+bool pager_count_rows(DPARMS *parms)
+{
+   if (parms->context && pager_context_count(parms->context))
+      return false;
+
+   while (parms->extend)
+   {
+      if (parms->row_count == INT_MAX)
+         parms->extend = NULL;
+      else if (parms->row_count > INT_MAX - PAGER_COUNT_STEP)
+         pager_extend_rows(parms, INT_MAX);
+      else
+         pager_extend_rows(parms, parms->row_count + PAGER_COUNT_STEP);
+   }
+
+   return true;
+}
@@ -0,0 +1,426 @@
+#include <stdlib.h>     // malloc/free
+#include <string.h>
+#include <pthread.h>
+
+#include "export.h"
+#include "termstuff.h"
+#include "pager.h"
+#include "pager_private.h"
+
+/** @brief Most pages kept drawn ahead */
+#define PRERENDER_FRAMES 4
+
+/**
+ * @brief A page drawn ahead, and the state of the pager it shows.
+ */
+typedef struct prerender_frame {
+   DPARMS parms;            ///< pager as it will be when showing the page
+   char *buff;              ///< output that draws the page
+   int len;                 ///< bytes of @p buff
+} PFRAME;
+
+struct pager_prerender {
+   pthread_t thread;
+   pthread_mutex_t lock;    ///< protects the members below but @p cancel
+   pthread_cond_t wake;     ///< signals a new job, or stopping
+   pthread_cond_t idle;     ///< signals that @p drawing was cleared
+
+   DPARMS job;              ///< pager around whose page to draw
+   bool has_job;
+   bool stopping;
+   bool drawing;            ///< the worker is calling the printer
+   int cancel;              ///< set to abandon the page being drawn, atomic
+   unsigned generation;     ///< advanced when frames become stale
+
+   PTERM *capture;          ///< collects the output of the worker
+   size_t budget;           ///< most bytes of frames kept
+   size_t used;             ///< bytes of frames kept
+   PFRAME frames[PRERENDER_FRAMES]; ///< oldest first
+   int frame_count;
+};
+
+/**
+ * @brief Move a copy of the pager to where a page action would.
+ * @param "parms"  copy of the pager, changed to the new page
+ * @param "down"   *true* to follow @ref pager_focus_down_page,
+ *                 *false* to follow @ref pager_focus_up_page
+ * @return *true* if the action would draw a new page.
+ *
+ * Only moves that redraw the whole page are predicted.  A move that
+ * stays on the same page is drawn a row at a time anyway.
+ */
+static bool predict_page(DPARMS *parms, bool down)
+{
+   if (parms->row_count == 0)
+      return false;
+
+   if (down)
+   {
+      int focus = parms->index_row_focus + parms->line_count;
+      if (focus >= parms->row_count)
+         focus = parms->row_count - 1;
+
+      // Staying on the page is no new page:
+      if (focus < parms->index_row_top + parms->line_count)
+         return false;
+
+      int top = focus - parms->line_count + 1;
+      parms->index_row_top = top < 0 ? 0 : top;
+      parms->index_row_focus = focus;
+   }
+   else
+   {
+      // Below the top row, the focus first moves to the top, and
+      // the page above comes with the next move:
+      if (parms->index_row_top == 0)
+         return false;
+
+      int top = parms->index_row_top - parms->line_count;
+      parms->index_row_top = parms->index_row_focus = top < 0 ? 0 : top;
+   }
+
+   return true;
+}
+
+/**
+ * @brief Test if the printer of a pager is one of the library's that
+ *        keep a cache, and so can't be called by the worker while the
+ *        UI thread draws.
+ *
+ * Tables, which also draw delimited and JSON lines files, keep
+ * formatted cells, and the others keep decompressed blocks, mapped
+ * files, parsed lines or fetched rows.  A tree is as safe as the
+ * printer of its nodes.
+ */
+static bool printer_caches(const DPARMS *parms)
+{
+   pwb_print_line printer = parms->printer;
+   if (printer == pager_tree_printer)
+      printer = pager_tree_node_printer((const PTREE*)parms->data_source);
+
+   return printer == pager_table_printer
+      || printer == pager_gzip_printer
+      || printer == pager_ansi_printer
+      || printer == pager_multi_printer
+      || printer == pager_fetch_printer;
+}
+
+/**
+ * @brief Test if a frame shows the page of a pager.
+ */
+static bool frame_matches(const PFRAME *frame, const DPARMS *parms)
+{
+   const DPARMS *drawn = &frame->parms;
+   return drawn->index_row_top == parms->index_row_top
+      && drawn->index_row_focus == parms->index_row_focus
+      && drawn->row_count == parms->row_count
+      && drawn->line_top == parms->line_top
+      && drawn->line_count == parms->line_count
+      && drawn->chars_left == parms->chars_left
+      && drawn->chars_count == parms->chars_count
+      && drawn->data_source == parms->data_source
+      && drawn->printer == parms->printer
+      && drawn->source == parms->source
+      && drawn->selection == parms->selection;
+}
+
+static PFRAME *find_frame(PRENDER *pr, const DPARMS *parms)
+{
+   for (int i = 0; i < pr->frame_count; ++i)
+      if (frame_matches(&pr->frames[i], parms))
+         return &pr->frames[i];
+
+   return NULL;
+}
+
+static void drop_frame(PRENDER *pr, int index)
+{
+   pr->used -= pr->frames[index].len;
+   free(pr->frames[index].buff);
+
+   --pr->frame_count;
+   memmove(&pr->frames[index], &pr->frames[index + 1],
+           sizeof(PFRAME) * (pr->frame_count - index));
+}
+
+/**
+ * @brief Keep a drawn page, dropping the oldest to stay in budget.
+ */
+static void keep_frame(PRENDER *pr, const DPARMS *parms, char *buff, int len)
+{
+   if ((size_t)len > pr->budget)
+   {
+      free(buff);
+      return;
+   }
+
+   while (pr->frame_count > 0
+          && (pr->frame_count == PRERENDER_FRAMES || pr->used + len > pr->budget))
+      drop_frame(pr, 0);
+
+   PFRAME *frame = &pr->frames[pr->frame_count++];
+   frame->parms = *parms;
+   frame->buff = buff;
+   frame->len = len;
+   pr->used += len;
+}
+
+/**
+ * @brief Draw a page into the capture terminal.
+ * @return the output, or NULL if cancelled.
+ */
+static char *draw_page(PRENDER *pr, const DPARMS *parms, int *len)
+{
+   PTRACE_BEGIN(trace);
+   ti_select_term(pr->capture, NULL);
+   ti_begin_frame();
+
+   bool done = pager_write_page(parms, &pr->cancel);
+
+   char *buff = ti_capture_take(len);
+   PTRACE_END(trace, done ? "prerender" : "prerender cancelled",
+              "top", parms->index_row_top);
+   if (!done)
+   {
+      free(buff);
+      return NULL;
+   }
+
+   return buff;
+}
+
+/**
+ * @brief Worker thread, drawing the pages above and below the page
+ *        of each job.
+ */
+static void *draw_pages(void *arg)
+{
+   PRENDER *pr = (PRENDER*)arg;
+
+   pthread_mutex_lock(&pr->lock);
+   for (;;)
+   {
+      while (!pr->has_job && !pr->stopping)
+         pthread_cond_wait(&pr->wake, &pr->lock);
+
+      if (pr->stopping)
+         break;
+
+      DPARMS job = pr->job;
+      pr->has_job = false;
+      __atomic_store_n(&pr->cancel, 0, __ATOMIC_RELAXED);
+
+      // The page below is more likely wanted:
+      for (int i = 0; i < 2 && !pr->has_job && !pr->stopping; ++i)
+      {
+         DPARMS page = job;
+         if (!predict_page(&page, i == 0) || find_frame(pr, &page))
+            continue;
+
+         unsigned generation = pr->generation;
+         pr->drawing = true;
+         pthread_mutex_unlock(&pr->lock);
+
+         int len = 0;
+         char *buff = draw_page(pr, &page, &len);
+
+         pthread_mutex_lock(&pr->lock);
+         pr->drawing = false;
+         pthread_cond_broadcast(&pr->idle);
+
+         if (buff && generation == pr->generation)
+            keep_frame(pr, &page, buff, len);
+         else
+            free(buff);
+      }
+   }
+   pthread_mutex_unlock(&pr->lock);
+
+   return NULL;
+}
+
+/**
+ * @brief Write the page of a pager if it was drawn ahead.
+ * @return *true* if written, *false* if it must be drawn.
+ */
+bool pager_prerender_take(DPARMS *parms)
+{
+   PRENDER *pr = parms->prerender;
+   bool taken = false;
+
+   pthread_mutex_lock(&pr->lock);
+   PFRAME *frame = find_frame(pr, parms);
+   if (frame)
+   {
+      // The frame starts and ends in the default style:
+      static const PSTYLE plain = { 0, 0, 0 };
+
+      ti_begin_frame();
+      ti_set_style(&plain);
+      ti_write(frame->buff, frame->len);
+      ti_end_frame();
+
+      PSTAT_INC(parms->stats, prerendered);
+      taken = true;
+   }
+   pthread_mutex_unlock(&pr->lock);
+
+   return taken;
+}
+
+/**
+ * @brief Have the worker draw the pages around the page of a pager,
+ *        abandoning the pages it was drawing.
+ */
+void pager_prerender_schedule(DPARMS *parms)
+{
+   PRENDER *pr = parms->prerender;
+
+   pthread_mutex_lock(&pr->lock);
+   pr->job = *parms;
+   pr->job.stats = NULL;
+   pr->job.prerender = NULL;
+   // The worker draws predicted pages, which the source mustn't fetch:
+   pr->job.prepare = NULL;
+   pr->has_job = true;
+   __atomic_store_n(&pr->cancel, 1, __ATOMIC_RELAXED);
+   pthread_cond_signal(&pr->wake);
+   pthread_mutex_unlock(&pr->lock);
+}
+
+/**
+ * @defgroup PRERENDER Pages drawn ahead on a worker thread
+ * @brief Functions found in `pager_prerender.c`
+ *
+ * After each page is drawn, while the user reads it, a worker thread
+ * draws the pages above and below into memory.  When
+ * @ref pager_focus_down_page or @ref pager_focus_up_page moves to
+ * one of them, @ref pager_plot writes the drawn page at once instead
+ * of calling the printer for each row.
+ *
+ * The worker calls the printer while the UI thread may be calling it
+ * too, so the printer must be safe to call from two threads, as is
+ * one that only reads its data.  The library's printers that keep a
+ * cache, those of tables, compressed files, coloured text, lists of
+ * files and fetched rows, are refused.
+ * @{
+ */
+
+/**
+ * @brief Start drawing pages ahead for a pager.
+ * @param "parms"   pager, prepared with @ref pager_init_dparms and
+ *                  with its terminal set
+ * @param "budget"  most bytes of drawn pages to keep
+ * @return *true* if started, *false* if the printer keeps a cache,
+ *         if out of memory, or if the thread couldn't be started.
+ *
+ * Call @ref pager_prerender_stop before discarding the pager.
+ */
+EXPORT bool pager_prerender_start(DPARMS *parms, size_t budget)
+{
+   if (printer_caches(parms))
+      return false;
+
+   PRENDER *pr = (PRENDER*)calloc(1, sizeof(PRENDER));
+   if (pr == NULL)
+      return false;
+
+   pr->budget = budget;
+   pr->capture = ti_capture_open(parms->term);
+   if (pr->capture == NULL)
+   {
+      free(pr);
+      return false;
+   }
+
+   pthread_mutex_init(&pr->lock, NULL);
+   pthread_cond_init(&pr->wake, NULL);
+   pthread_cond_init(&pr->idle, NULL);
+
+   if (pthread_create(&pr->thread, NULL, draw_pages, pr))
+   {
+      pthread_cond_destroy(&pr->idle);
+      pthread_cond_destroy(&pr->wake);
+      pthread_mutex_destroy(&pr->lock);
+      pager_term_close(pr->capture);
+      free(pr);
+      return false;
+   }
+
+   parms->prerender = pr;
+   return true;
+}
+
+/**
+ * @brief Stop the worker and release the drawn pages.
+ */
+EXPORT void pager_prerender_stop(DPARMS *parms)
+{
+   PRENDER *pr = parms->prerender;
+   if (pr == NULL)
+      return;
+
+   pthread_mutex_lock(&pr->lock);
+   pr->stopping = true;
+   __atomic_store_n(&pr->cancel, 1, __ATOMIC_RELAXED);
+   pthread_cond_signal(&pr->wake);
+   pthread_mutex_unlock(&pr->lock);
+
+   pthread_join(pr->thread, NULL);
+
+   while (pr->frame_count > 0)
+      drop_frame(pr, 0);
+
+   pthread_cond_destroy(&pr->idle);
+   pthread_cond_destroy(&pr->wake);
+   pthread_mutex_destroy(&pr->lock);
+   pager_term_close(pr->capture);
+   free(pr);
+
+   parms->prerender = NULL;
+}
+
+/**
+ * @brief Drop drawn pages showing rows that have changed.
+ * @param "parms"  pager drawing pages ahead
+ * @param "first"  index of first changed row
+ * @param "last"   index of last changed row
+ *
+ * The page being drawn is abandoned, and the worker has left the
+ * printer when this returns, so the data or the selection can then
+ * be changed safely.  The worker resumes when the pager is next
+ * plotted.
+ *
+ * @ref pager_invalidate_rows and @ref pager_toggle_selection call
+ * this.  Call it for other changes to what the pager shows, with
+ * 0 and INT_MAX if the changed rows aren't known.
+ */
+EXPORT void pager_prerender_discard(DPARMS *parms, int first, int last)
+{
+   PRENDER *pr = parms->prerender;
+   if (pr == NULL)
+      return;
+
+   pthread_mutex_lock(&pr->lock);
+
+   for (int i = pr->frame_count - 1; i >= 0; --i)
+   {
+      const DPARMS *drawn = &pr->frames[i].parms;
+      int top = drawn->index_row_top;
+      int bottom = top + drawn->line_count - 1;
+      if (top <= last && bottom >= first)
+         drop_frame(pr, i);
+   }
+
+   // The page being drawn may show the old rows:
+   ++pr->generation;
+   pr->has_job = false;
+   __atomic_store_n(&pr->cancel, 1, __ATOMIC_RELAXED);
+
+   while (pr->drawing)
+      pthread_cond_wait(&pr->idle, &pr->lock);
+
+   pthread_mutex_unlock(&pr->lock);
+}
+
+/** @} */
@@ -0,0 +1,90 @@
+#ifndef PAGER_PRIVATE_H
+#define PAGER_PRIVATE_H
+
+/**
+ * @file pager_private.h
+ * @brief Declarations shared between library modules, not installed.
+ */
+
+#include <stdbool.h>
+#include "pager.h"
+
+/**
+ * @defgroup STATS_MACROS Update a PSTATS struct if collecting
+ *
+ * Statistics are only written by the thread running the pager, so
+ * relaxed atomic stores suffice to let other threads read them
+ * through @ref pager_context_stats.  Without `PAGER_STATS` defined,
+ * the macros compile to nothing.
+ * @{
+ */
+#ifdef PAGER_STATS
+#define PSTAT_ADD(stats, field, n)                                      \
+   do {                                                                 \
+      if (stats)                                                        \
+         __atomic_store_n(&(stats)->field, (stats)->field + (n),        \
+                          __ATOMIC_RELAXED);                            \
+   } while(0)
+
+#define PSTAT_MAX(stats, field, n)                                      \
+   do {                                                                 \
+      if ((stats) && (unsigned long)(n) > (stats)->field)               \
+         __atomic_store_n(&(stats)->field, (n), __ATOMIC_RELAXED);      \
+   } while(0)
+#else
+#define PSTAT_ADD(stats, field, n) ((void)0)
+#define PSTAT_MAX(stats, field, n) ((void)0)
+#endif
+/** @} */
+
+#define PSTAT_INC(stats, field) PSTAT_ADD(stats, field, 1)
+
+/**
+ * @defgroup TRACE_MACROS Record an event if tracing
+ *
+ * @ref PTRACE_BEGIN notes the start of a span of work in a local
+ * variable, which is 0 when not tracing, and @ref PTRACE_END records
+ * the span if the variable was set.  Each costs one test of a flag
+ * that is almost always clear.  See @ref pager_trace_start.
+ * @{
+ */
+extern int ptrace_on;
+unsigned long ptrace_clock(void);
+void ptrace_record(unsigned long start, const char *name, const char *arg_name, int arg);
+void ptrace_init(void);
+void ptrace_cleanup(void);
+
+#define PTRACE_BEGIN(var)                                               \
+   unsigned long var =                                                  \
+      __builtin_expect(__atomic_load_n(&ptrace_on, __ATOMIC_RELAXED), 0) \
+      ? ptrace_clock() : 0
+
+#define PTRACE_END(var, name, arg_name, arg)                            \
+   do {                                                                 \
+      if (__builtin_expect((var) != 0, 0))                              \
+         ptrace_record((var), (name), (arg_name), (arg));               \
+   } while(0)
+/** @} */
+
+/** @brief Rows requested at a time when counting a source of unknown length */
+#define PAGER_COUNT_STEP 65536
+
+void pager_select(const DPARMS *parms);
+int pager_call_printer(const DPARMS *parms, int row_index, bool has_focus);
+int pager_print_text(const char *text, int len, int length, int indicated);
+void pager_write_clean(const char *text, int len);
+void pager_indicated_style(PSTYLE *style, int indicated);
+int pager_write_builtin(const DPARMS *parms, int row_index, int indicated);
+bool pager_write_page(const DPARMS *parms, const int *stop);
+
+bool pager_prerender_take(DPARMS *parms);
+void pager_prerender_schedule(DPARMS *parms);
+pwb_print_line pager_tree_node_printer(const PTREE *tree);
+
+void pager_prepare_rows(const DPARMS *parms, int first, int last);
+void pager_extend_rows(DPARMS *parms, int wanted);
+bool pager_count_rows(DPARMS *parms);
+void pager_context_extend(PCONTEXT *ctx, int wanted);
+bool pager_context_count(PCONTEXT *ctx);
+
+#endif
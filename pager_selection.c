@@ -0,0 +1,521 @@
+#include <stdlib.h>     // malloc/free
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "export.h"
+#include "pager.h"
+#include "pager_private.h"
+
+/** @brief Rows covered by one container, from the low 16 bits of a row index */
+#define SEL_CONTAINER_ROWS 65536
+
+/** @brief Most rows held in an array container before it becomes a bitmap */
+#define SEL_ARRAY_MAX 4096
+
+/** @brief 64-bit words in a bitmap container */
+#define SEL_BITMAP_WORDS (SEL_CONTAINER_ROWS / 64)
+
+/**
+ * @brief Encodings of the rows selected in a container.
+ *
+ * After Roaring bitmaps: sparse selections are sorted arrays,
+ * dense selections are bitmaps, and completely selected ranges
+ * take no memory beyond the container.
+ */
+typedef enum sel_container_type {
+   SC_ARRAY = 0,
+   SC_BITMAP,
+   SC_FULL
+} SCTYPE;
+
+typedef struct sel_container {
+   SCTYPE type;
+   int count;               ///< rows selected in the container
+   int size;                ///< elements allocated to @p array
+   union {
+      uint16_t *array;      ///< sorted low bits of selected rows
+      uint64_t *bits;       ///< one bit for each row
+   } data;
+} SCONT;
+
+struct pager_selection {
+   SCONT **containers;      ///< indexed by the high bits of the row index
+   int container_count;     ///< elements allocated to @p containers
+   long count;              ///< rows selected
+};
+
+static void free_container(SCONT *cont)
+{
+   if (cont->type == SC_ARRAY)
+      free(cont->data.array);
+   else if (cont->type == SC_BITMAP)
+      free(cont->data.bits);
+   free(cont);
+}
+
+/**
+ * @brief Get the container for @p key, creating it if necessary.
+ */
+static SCONT *get_container(PSELECTION *sel, int key)
+{
+   if (key >= sel->container_count)
+   {
+      int count = sel->container_count ? sel->container_count : 16;
+      while (count <= key)
+         count *= 2;
+
+      SCONT **containers = (SCONT**)realloc(sel->containers, sizeof(SCONT*) * count);
+      if (containers == NULL)
+         return NULL;
+
+      memset(containers + sel->container_count, 0,
+             sizeof(SCONT*) * (count - sel->container_count));
+      sel->containers = containers;
+      sel->container_count = count;
+   }
+
+   SCONT *cont = sel->containers[key];
+   if (cont == NULL)
+   {
+      cont = (SCONT*)calloc(1, sizeof(SCONT));
+      sel->containers[key] = cont;
+   }
+
+   return cont;
+}
+
+/**
+ * @brief Position of @p low in an array container, or where it belongs.
+ */
+static int array_find(const SCONT *cont, uint16_t low)
+{
+   int left = 0, right = cont->count;
+   while (left < right)
+   {
+      int mid = (left + right) / 2;
+      if (cont->data.array[mid] < low)
+         left = mid + 1;
+      else
+         right = mid;
+   }
+   return left;
+}
+
+/**
+ * @brief Change a container to a bitmap, keeping its rows.
+ */
+static bool make_bitmap(SCONT *cont)
+{
+   if (cont->type == SC_BITMAP)
+      return true;
+
+   uint64_t *bits = (uint64_t*)malloc(sizeof(uint64_t) * SEL_BITMAP_WORDS);
+   if (bits == NULL)
+      return false;
+
+   if (cont->type == SC_FULL)
+      memset(bits, 0xff, sizeof(uint64_t) * SEL_BITMAP_WORDS);
+   else
+   {
+      memset(bits, 0, sizeof(uint64_t) * SEL_BITMAP_WORDS);
+      for (int i = 0; i < cont->count; ++i)
+      {
+         uint16_t low = cont->data.array[i];
+         bits[low >> 6] |= (uint64_t)1 << (low & 63);
+      }
+      free(cont->data.array);
+   }
+
+   cont->type = SC_BITMAP;
+   cont->data.bits = bits;
+   return true;
+}
+
+/**
+ * @brief Choose the smallest encoding for a bitmap whose count has changed.
+ */
+static void compact_bitmap(SCONT *cont)
+{
+   if (cont->type != SC_BITMAP)
+      return;
+
+   if (cont->count == SEL_CONTAINER_ROWS)
+   {
+      free(cont->data.bits);
+      cont->type = SC_FULL;
+   }
+   else if (cont->count <= SEL_ARRAY_MAX)
+   {
+      uint16_t *array = (uint16_t*)malloc(sizeof(uint16_t) * (cont->count ? cont->count : 1));
+      if (array == NULL)
+         return;      // a bitmap is still correct
+
+      int index = 0;
+      for (int word = 0; word < SEL_BITMAP_WORDS; ++word)
+      {
+         uint64_t bits = cont->data.bits[word];
+         while (bits)
+         {
+            array[index++] = (uint16_t)(word * 64 + __builtin_ctzll(bits));
+            bits &= bits - 1;
+         }
+      }
+
+      free(cont->data.bits);
+      cont->type = SC_ARRAY;
+      cont->data.array = array;
+      cont->size = cont->count ? cont->count : 1;
+   }
+}
+
+/**
+ * @brief Release a container that no longer holds rows.
+ */
+static void drop_if_empty(PSELECTION *sel, int key)
+{
+   SCONT *cont = sel->containers[key];
+   if (cont && cont->count == 0)
+   {
+      free_container(cont);
+      sel->containers[key] = NULL;
+   }
+}
+
+/**
+ * @brief Select or deselect rows @p low to @p high of one container.
+ */
+static bool set_container_range(PSELECTION *sel, int key, int low, int high, bool selected)
+{
+   if (!selected && (key >= sel->container_count || sel->containers[key] == NULL))
+      return true;
+
+   SCONT *cont = get_container(sel, key);
+   if (cont == NULL)
+      return false;
+
+   int old_count = cont->count;
+   int span = high - low + 1;
+
+   if (span == SEL_CONTAINER_ROWS)
+   {
+      // The whole container changes:
+      if (cont->type == SC_ARRAY)
+         free(cont->data.array);
+      else if (cont->type == SC_BITMAP)
+         free(cont->data.bits);
+
+      cont->type = SC_FULL;
+      cont->count = selected ? SEL_CONTAINER_ROWS : 0;
+   }
+   else if (cont->type == SC_FULL && selected)
+      return true;
+   else if (cont->type == SC_ARRAY && (selected ? cont->count + span <= SEL_ARRAY_MAX : true))
+   {
+      // Small changes to an array are made in place:
+      int first = array_find(cont, (uint16_t)low);
+      int end = first;
+      while (end < cont->count && cont->data.array[end] <= high)
+         ++end;
+
+      int tail = cont->count - end;
+      int new_count = selected ? first + span + tail : first + tail;
+
+      if (new_count > cont->size)
+      {
+         int size = cont->size ? cont->size : 4;
+         while (size < new_count)
+            size *= 2;
+
+         uint16_t *array = (uint16_t*)realloc(cont->data.array, sizeof(uint16_t) * size);
+         if (array == NULL)
+            return false;
+
+         cont->data.array = array;
+         cont->size = size;
+      }
+
+      uint16_t *array = cont->data.array;
+      int insert = selected ? span : 0;
+      memmove(array + first + insert, array + end, sizeof(uint16_t) * tail);
+      for (int i = 0; i < insert; ++i)
+         array[first + i] = (uint16_t)(low + i);
+
+      cont->count = new_count;
+   }
+   else
+   {
+      if (!make_bitmap(cont))
+         return false;
+
+      uint64_t *bits = cont->data.bits;
+      int first_word = low >> 6, last_word = high >> 6;
+      for (int word = first_word; word <= last_word; ++word)
+      {
+         uint64_t mask = ~(uint64_t)0;
+         if (word == first_word)
+            mask &= ~(uint64_t)0 << (low & 63);
+         if (word == last_word && (high & 63) != 63)
+            mask &= ((uint64_t)1 << ((high & 63) + 1)) - 1;
+
+         int before = __builtin_popcountll(bits[word]);
+         if (selected)
+            bits[word] |= mask;
+         else
+            bits[word] &= ~mask;
+         cont->count += __builtin_popcountll(bits[word]) - before;
+      }
+
+      compact_bitmap(cont);
+   }
+
+   sel->count += cont->count - old_count;
+   drop_if_empty(sel, key);
+   return true;
+}
+
+/**
+ * @defgroup SELECTION Multiple-row selection
+ * @brief Functions found in `pager_selection.c`
+ *
+ * A selection is a set of row indexes, stored in containers of
+ * 65536 rows that are encoded as sorted arrays, bitmaps, or as
+ * fully selected, whichever is smallest.  Selecting a range of
+ * millions of rows only marks containers as full.
+ * @{
+ */
+
+/**
+ * @brief Create an empty selection.
+ * @return new selection, or NULL if out of memory.  Release the
+ *         selection with @ref pager_selection_destroy.
+ */
+EXPORT PSELECTION *pager_selection_create(void)
+{
+   return (PSELECTION*)calloc(1, sizeof(PSELECTION));
+}
+
+EXPORT void pager_selection_destroy(PSELECTION *sel)
+{
+   pager_selection_clear(sel);
+   free(sel->containers);
+   free(sel);
+}
+
+/**
+ * @brief Deselect all rows.
+ */
+EXPORT void pager_selection_clear(PSELECTION *sel)
+{
+   for (int key = 0; key < sel->container_count; ++key)
+   {
+      if (sel->containers[key])
+      {
+         free_container(sel->containers[key]);
+         sel->containers[key] = NULL;
+      }
+   }
+
+   sel->count = 0;
+}
+
+/**
+ * @brief Number of rows selected.
+ */
+EXPORT long pager_selection_count(const PSELECTION *sel)
+{
+   return sel->count;
+}
+
+/**
+ * @brief Test if a row is selected.
+ *
+ * Full and bitmap containers answer directly, and an array
+ * container with at most 4096 rows is searched in 12 steps.
+ */
+EXPORT bool pager_selection_has(const PSELECTION *sel, int row_index)
+{
+   int key = row_index >> 16;
+   if (row_index < 0 || key >= sel->container_count)
+      return false;
+
+   const SCONT *cont = sel->containers[key];
+   if (cont == NULL)
+      return false;
+
+   uint16_t low = (uint16_t)(row_index & 0xffff);
+   switch(cont->type)
+   {
+      case SC_FULL:
+         return true;
+      case SC_BITMAP:
+         return (cont->data.bits[low >> 6] >> (low & 63)) & 1;
+      default:
+      {
+         int index = array_find(cont, low);
+         return index < cont->count && cont->data.array[index] == low;
+      }
+   }
+}
+
+/**
+ * @brief Select or deselect a range of rows.
+ * @param "sel"       selection to change
+ * @param "first"     index of first row of the range
+ * @param "last"      index of last row of the range
+ * @param "selected"  *true* to select, *false* to deselect
+ * @return *true* if done, *false* if out of memory, in which case
+ *         only part of the range may have changed.
+ */
+EXPORT bool pager_selection_set_range(PSELECTION *sel, int first, int last, bool selected)
+{
+   if (first < 0)
+      first = 0;
+
+   for (int key = first >> 16; first <= last; ++key)
+   {
+      int end = (key << 16) | 0xffff;
+      if (end > last)
+         end = last;
+
+      if (!set_container_range(sel, key, first & 0xffff, end & 0xffff, selected))
+         return false;
+
+      if (end == last)
+         break;
+      first = end + 1;
+   }
+
+   return true;
+}
+
+/**
+ * @brief Select or deselect one row.
+ */
+EXPORT bool pager_selection_set(PSELECTION *sel, int row_index, bool selected)
+{
+   return pager_selection_set_range(sel, row_index, row_index, selected);
+}
+
+/**
+ * @brief Reverse the selection of one row.
+ * @return *true* if done, *false* if out of memory.
+ */
+EXPORT bool pager_selection_toggle(PSELECTION *sel, int row_index)
+{
+   return pager_selection_set(sel, row_index, !pager_selection_has(sel, row_index));
+}
+
+/**
+ * @brief Select the rows in a range for which @p match returns *true*.
+ * @param "sel"    selection to extend
+ * @param "first"  index of first row to test
+ * @param "last"   index of last row to test
+ * @param "match"  function to test a row
+ * @param "data"   passed to @p match
+ * @return *true* if done, *false* if out of memory.
+ *
+ * Consecutive matches are selected as ranges.
+ */
+EXPORT bool pager_selection_add_matching(PSELECTION *sel,
+                                         int first,
+                                         int last,
+                                         psel_match match,
+                                         void *data)
+{
+   int run = -1;
+   for (int row = first; row <= last; ++row)
+   {
+      if ((*match)(row, data))
+      {
+         if (run < 0)
+            run = row;
+      }
+      else if (run >= 0)
+      {
+         if (!pager_selection_set_range(sel, run, row - 1, true))
+            return false;
+         run = -1;
+      }
+   }
+
+   return run < 0 || pager_selection_set_range(sel, run, last, true);
+}
+
+/**
+ * @brief Find the next selected row.
+ * @param "sel"    selection to search
+ * @param "after"  row after which to search, -1 to start at the beginning
+ * @return index of the first selected row after @p after, or -1 if none.
+ *
+ * Walk the selection with
+ * `for (row = pager_selection_next(sel, -1); row >= 0; row = pager_selection_next(sel, row))`.
+ */
+EXPORT int pager_selection_next(const PSELECTION *sel, int after)
+{
+   if (after < -1)
+      after = -1;
+   if (after == 0x7fffffff)
+      return -1;
+
+   int row = after + 1;
+   int low = row & 0xffff;
+
+   for (int key = row >> 16; key < sel->container_count; ++key, low = 0)
+   {
+      const SCONT *cont = sel->containers[key];
+      if (cont == NULL)
+         continue;
+
+      int base = key << 16;
+      switch(cont->type)
+      {
+         case SC_FULL:
+            return base + low;
+
+         case SC_BITMAP:
+         {
+            int word = low >> 6;
+            uint64_t bits = cont->data.bits[word] & (~(uint64_t)0 << (low & 63));
+            for (;;)
+            {
+               if (bits)
+                  return base + word * 64 + __builtin_ctzll(bits);
+               if (++word >= SEL_BITMAP_WORDS)
+                  break;
+               bits = cont->data.bits[word];
+            }
+            break;
+         }
+
+         default:
+         {
+            int index = array_find(cont, (uint16_t)low);
+            if (index < cont->count)
+               return base + cont->data.array[index];
+            break;
+         }
+      }
+   }
+
+   return -1;
+}
+
+/**
+ * @brief Toggle selection of the focused row, for the @p selection
+ *        of @p parms.
+ */
+EXPORT ARV pager_toggle_selection(DPARMS *parms)
+{
+   if (parms->selection == NULL || parms->row_count == 0)
+      return ARV_CONTINUE;
+
+   // The worker mustn't read the selection while it changes:
+   pager_prerender_discard(parms, parms->index_row_focus, parms->index_row_focus);
+
+   pager_selection_toggle(parms->selection, parms->index_row_focus);
+   pager_plot_row(parms, parms->index_row_focus);
+   return ARV_CONTINUE;
+}
+
+/** @} */
@@ -0,0 +1,114 @@
+#include <string.h>
+
+#include "export.h"
+#include "pager.h"
+#include "pager_private.h"
+
+/**
+ * @brief Write one string of a built-in source.
+ *
+ * Only as much of a C string as fits is measured, so long strings
+ * cost no more than short ones.
+ */
+static int write_builtin(int source, const void *strings, int row_index, int length, int indicated)
+{
+   const char *text;
+   int len;
+
+   if (source == PAGER_SOURCE_COUNTED)
+   {
+      const PSTRING *string = &((const PSTRING*)strings)[row_index];
+      text = string->text;
+      len = string->len;
+   }
+   else
+   {
+      text = ((const char **)strings)[row_index];
+      len = text ? (int)strnlen(text, length) : 0;
+   }
+
+   return pager_print_text(text, len, length, indicated);
+}
+
+/**
+ * @brief Write a row of a built-in source, without calling a printer.
+ * @return the number of characters filled, the whole line.
+ */
+int pager_write_builtin(const DPARMS *parms, int row_index, int indicated)
+{
+   return write_builtin(parms->source,
+                        parms->data_source,
+                        row_index,
+                        parms->chars_count,
+                        indicated);
+}
+
+/**
+ * @defgroup STRING_ARRAYS Arrays of strings
+ * @brief Functions found in `pager_strings.c`
+ *
+ * Paging an array of strings is common enough that the library
+ * draws the strings itself, copying the text into the screen update
+ * without calling a printer or formatting anything.
+ * @{
+ */
+
+/**
+ * @brief Prepare a pager to show an array of C strings.
+ * @param "parms"    pager to initialize, as with @ref pager_init_dparms
+ * @param "strings"  strings to show, one per row.  A NULL string
+ *                   is shown as an empty row.
+ * @param "count"    number of elements in @p strings
+ *
+ * The array must outlive the pager.
+ */
+EXPORT void pager_init_strings(DPARMS *parms, const char **strings, int count)
+{
+   pager_init_dparms(parms, (void*)strings, count, pager_strings_printer, NULL);
+   parms->source = PAGER_SOURCE_STRINGS;
+}
+
+/**
+ * @brief Prepare a pager to show an array of counted strings.
+ * @param "parms"    pager to initialize, as with @ref pager_init_dparms
+ * @param "strings"  strings to show, one per row, which need not be
+ *                   NUL-terminated
+ * @param "count"    number of elements in @p strings
+ *
+ * The array must outlive the pager.
+ */
+EXPORT void pager_init_counted(DPARMS *parms, const PSTRING *strings, int count)
+{
+   pager_init_dparms(parms, (void*)strings, count, pager_counted_printer, NULL);
+   parms->source = PAGER_SOURCE_COUNTED;
+}
+
+/**
+ * @brief @ref pwb_print_line function for an array of C strings.
+ *
+ * A pager made with @ref pager_init_strings doesn't call this, but
+ * draws the strings directly.  This is for using the array where
+ * a printer is needed.
+ */
+EXPORT int pager_strings_printer(int row_index,
+                                 int indicated,
+                                 int length,
+                                 void *data_source,
+                                 void *data_extra)
+{
+   return write_builtin(PAGER_SOURCE_STRINGS, data_source, row_index, length, indicated);
+}
+
+/**
+ * @brief @ref pwb_print_line function for an array of @ref PSTRING.
+ */
+EXPORT int pager_counted_printer(int row_index,
+                                 int indicated,
+                                 int length,
+                                 void *data_source,
+                                 void *data_extra)
+{
+   return write_builtin(PAGER_SOURCE_COUNTED, data_source, row_index, length, indicated);
+}
+
+/** @} */
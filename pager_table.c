@@ -0,0 +1,453 @@
+#include <stdlib.h>     // malloc/free
+#include <string.h>
+#include <stdio.h>      // snprintf
+#include <assert.h>
+
+#include "export.h"
+#include "termstuff.h"
+#include "pager.h"
+#include "pager_private.h"
+
+/** @brief Most rows read to measure a column */
+#define TABLE_SAMPLE_ROWS 1024
+
+/** @brief Limit of a measured column width, unless the column sets one */
+#define TABLE_DEFAULT_MAX_WIDTH 40
+
+/** @brief Slots in the formatted cell cache, a power of 2 */
+#define TABLE_CELL_SLOTS 4096
+
+/** @brief Smallest buffer allocated for a cached cell */
+#define TABLE_CELL_MIN_SIZE 32
+
+/**
+ * @brief A formatted cell, saved to be redrawn without formatting.
+ *
+ * The cache is direct-mapped, so a cell simply replaces whatever
+ * cell was in its slot.
+ */
+typedef struct table_cell {
+   int row;                 ///< row of cached text, -1 if empty
+   int column;              ///< column of cached text
+   int len;                 ///< length of @p text
+   int size;                ///< bytes allocated to @p text
+   char *text;
+} TCELL;
+
+struct pager_table {
+   PCOLUMN *columns;        ///< copy of the column definitions
+   int column_count;
+   int row_count;
+   int column_first;        ///< leftmost column shown
+   int *widths;             ///< width of each column on screen
+   TCELL *cells;            ///< cache of formatted cells
+};
+
+static const char blanks[] = "                                        "
+                             "                                        ";
+
+/**
+ * @brief Write @p count spaces.
+ */
+static void write_blanks(int count)
+{
+   int chunk = (int)sizeof(blanks) - 1;
+   while (count > 0)
+   {
+      int len = count < chunk ? count : chunk;
+      ti_write(blanks, len);
+      count -= len;
+   }
+}
+
+/**
+ * @brief Format a non-string cell into @p buff.
+ * @return the length of the whole text, which may exceed @p bufflen
+ *         as with `snprintf`.
+ */
+static int format_cell(const PCOLUMN *column, int row_index, char *buff, int bufflen)
+{
+   switch(column->type)
+   {
+      case PCOL_LONG:
+         return snprintf(buff, bufflen, "%ld", ((const long*)column->values)[row_index]);
+
+      case PCOL_DOUBLE:
+         return snprintf(buff, bufflen, "%.*f",
+                         column->precision,
+                         ((const double*)column->values)[row_index]);
+
+      case PCOL_CALLBACK:
+         return (*column->text)(row_index, buff, bufflen, column->column_data);
+
+      default:
+         break;
+   }
+
+   if (bufflen > 0)
+      *buff = '\0';
+   return 0;
+}
+
+/**
+ * @brief Get the text of a cell, from the cache if possible.
+ * @param "table"      table holding the cell
+ * @param "row_index"  row of the cell
+ * @param "col_index"  column of the cell
+ * @param "len"        [out] length of the returned text
+ * @return the text of the cell, not necessarily NUL-terminated.
+ *
+ * String columns are written straight from their values, so only
+ * cells that must be formatted are cached.
+ */
+static const char *get_cell(PTABLE *table, int row_index, int col_index, int *len)
+{
+   const PCOLUMN *column = &table->columns[col_index];
+
+   if (column->type == PCOL_STRING)
+   {
+      const char *str = ((const char **)column->values)[row_index];
+      if (str == NULL)
+         str = "";
+      *len = (int)strnlen(str, table->widths[col_index]);
+      return str;
+   }
+
+   unsigned int hash = (unsigned int)row_index * 2654435761u + (unsigned int)col_index;
+   TCELL *cell = &table->cells[(hash ^ (hash >> 16)) & (TABLE_CELL_SLOTS - 1)];
+
+   if (cell->row != row_index || cell->column != col_index)
+   {
+      cell->row = -1;
+
+      int needed = format_cell(column, row_index, cell->text, cell->size);
+      if (needed < 0)
+         needed = 0;
+
+      if (needed >= cell->size)
+      {
+         int size = cell->size ? cell->size : TABLE_CELL_MIN_SIZE;
+         while (size <= needed)
+            size *= 2;
+
+         char *text = (char*)realloc(cell->text, size);
+         if (text == NULL)
+         {
+            *len = 0;
+            return "";
+         }
+
+         cell->text = text;
+         cell->size = size;
+         format_cell(column, row_index, cell->text, cell->size);
+      }
+
+      cell->row = row_index;
+      cell->column = col_index;
+      cell->len = needed;
+   }
+
+   *len = cell->len;
+   return cell->text;
+}
+
+/**
+ * @brief Length of the text of a cell, for measuring a column.
+ */
+static int measure_cell(const PCOLUMN *column, int row_index, int limit)
+{
+   if (column->type == PCOL_STRING)
+   {
+      const char *str = ((const char **)column->values)[row_index];
+      return str ? (int)strnlen(str, limit) : 0;
+   }
+
+   char buff[TABLE_CELL_MIN_SIZE];
+   return format_cell(column, row_index, buff, sizeof(buff));
+}
+
+/**
+ * @brief Set the width of every column that doesn't have a fixed width.
+ *
+ * Columns are measured from an evenly spaced sample of rows, so
+ * the time taken doesn't depend on the size of the table.  Longer
+ * values in rows that weren't sampled will be truncated.
+ */
+static void measure_columns(PTABLE *table)
+{
+   int rows = table->row_count;
+   int step_count = rows < TABLE_SAMPLE_ROWS ? rows : TABLE_SAMPLE_ROWS;
+
+   for (int col = 0; col < table->column_count; ++col)
+   {
+      const PCOLUMN *column = &table->columns[col];
+      if (column->width > 0)
+      {
+         table->widths[col] = column->width;
+         continue;
+      }
+
+      int limit = column->max_width > 0 ? column->max_width : TABLE_DEFAULT_MAX_WIDTH;
+      int width = column->title ? (int)strnlen(column->title, limit) : 0;
+
+      for (int step = 0; step < step_count && width < limit; ++step)
+      {
+         int row = (int)((long)step * rows / step_count);
+         int len = measure_cell(column, row, limit);
+         if (len > width)
+            width = len;
+      }
+
+      table->widths[col] = width < limit ? (width ? width : 1) : limit;
+   }
+}
+
+/**
+ * @brief Empty the cell cache.
+ */
+static void clear_cells(PTABLE *table, int first, int last)
+{
+   for (int i = 0; i < TABLE_CELL_SLOTS; ++i)
+   {
+      TCELL *cell = &table->cells[i];
+      if (cell->row >= first && cell->row <= last)
+         cell->row = -1;
+   }
+}
+
+/**
+ * @brief Write the visible part of one line of a table.
+ * @param "table"   table to be written
+ * @param "length"  number of characters to write
+ * @param "row"     index of row to write, or -1 for the column titles
+ */
+static int write_table_line(PTABLE *table, int length, int row)
+{
+   int written = 0;
+
+   for (int col = table->column_first; col < table->column_count && written < length; ++col)
+   {
+      if (col > table->column_first)
+      {
+         ti_write(" ", 1);
+         if (++written >= length)
+            break;
+      }
+
+      const PCOLUMN *column = &table->columns[col];
+      int width = table->widths[col];
+      if (width > length - written)
+         width = length - written;
+
+      int len;
+      const char *text;
+      if (row < 0)
+      {
+         text = column->title ? column->title : "";
+         len = (int)strnlen(text, width);
+      }
+      else
+         text = get_cell(table, row, col, &len);
+
+      if (len > width)
+         len = width;
+
+      if (column->align_right)
+      {
+         write_blanks(width - len);
+         pager_write_clean(text, len);
+      }
+      else
+      {
+         pager_write_clean(text, len);
+         write_blanks(width - len);
+      }
+
+      written += width;
+   }
+
+   write_blanks(length - written);
+   return length;
+}
+
+/**
+ * @defgroup TABLES Columnar table rendering
+ * @brief Functions found in `pager_table.c`
+ *
+ * A table is a set of typed columns, each with its own array of
+ * values (struct-of-arrays), drawn by @ref pager_table_printer.
+ * Only the columns that fit on the screen are formatted, and
+ * formatted numbers are cached to be redrawn.
+ * @{
+ */
+
+/**
+ * @brief Create a table for @ref pager_table_printer.
+ * @param "defs"          column definitions, copied into the table
+ * @param "column_count"  number of elements in @p defs
+ * @param "row_count"     number of rows in each column
+ * @return new table, or NULL if out of memory.  Release the table
+ *         with @ref pager_table_destroy.
+ *
+ * Use the table as the data source of a @ref DPARMS, with
+ * @ref pager_table_printer as its printer.
+ */
+EXPORT PTABLE *pager_table_create(const PCOLUMN *defs, int column_count, int row_count)
+{
+   PTABLE *table = (PTABLE*)malloc(sizeof(PTABLE));
+   if (table == NULL)
+      return NULL;
+
+   memset(table, 0, sizeof(PTABLE));
+
+   table->columns = (PCOLUMN*)malloc(sizeof(PCOLUMN) * column_count);
+   table->widths = (int*)malloc(sizeof(int) * column_count);
+   table->cells = (TCELL*)calloc(TABLE_CELL_SLOTS, sizeof(TCELL));
+
+   if (table->columns == NULL || table->widths == NULL || table->cells == NULL)
+   {
+      pager_table_destroy(table);
+      return NULL;
+   }
+
+   memcpy(table->columns, defs, sizeof(PCOLUMN) * column_count);
+   table->column_count = column_count;
+
+   for (int i = 0; i < TABLE_CELL_SLOTS; ++i)
+      table->cells[i].row = -1;
+
+   pager_table_reset(table, row_count);
+
+   return table;
+}
+
+/**
+ * @brief Release a table and its cached cells.
+ */
+EXPORT void pager_table_destroy(PTABLE *table)
+{
+   if (table->cells)
+   {
+      for (int i = 0; i < TABLE_CELL_SLOTS; ++i)
+         free(table->cells[i].text);
+      free(table->cells);
+   }
+
+   free(table->widths);
+   free(table->columns);
+   free(table);
+}
+
+/**
+ * @brief Remeasure the columns after the contents of the table changed.
+ * @param "table"      table whose content has changed
+ * @param "row_count"  new number of rows in each column
+ *
+ * This also empties the cell cache.  Update the @p row_count of
+ * the @ref DPARMS, then replot.
+ */
+EXPORT void pager_table_reset(PTABLE *table, int row_count)
+{
+   table->row_count = row_count < 0 ? 0 : row_count;
+   clear_cells(table, 0, 0x7fffffff);
+   measure_columns(table);
+}
+
+/**
+ * @brief Drop cached cells of rows whose values have changed.
+ *
+ * Column widths are not changed, see @ref pager_table_reset.
+ */
+EXPORT void pager_table_invalidate(PTABLE *table, int first, int last)
+{
+   clear_cells(table, first, last);
+}
+
+/**
+ * @brief Screen width of a column, or -1 if @p column is out of range.
+ */
+EXPORT int pager_table_column_width(const PTABLE *table, int column)
+{
+   if (column < 0 || column >= table->column_count)
+      return -1;
+
+   return table->widths[column];
+}
+
+/**
+ * @brief @ref pwb_print_line function for tables.
+ *
+ * The @p data_source must be a @ref PTABLE.  Columns are written
+ * from the current horizontal position, see @ref pager_table_right,
+ * for as many as fit in @p length characters.
+ */
+EXPORT int pager_table_printer(int row_index,
+                               int indicated,
+                               int length,
+                               void *data_source,
+                               void *data_extra)
+{
+   PTABLE *table = (PTABLE*)data_source;
+   assert(row_index >= 0 && row_index < table->row_count);
+
+   PSTYLE style = { 0, 0, 0 };
+   pager_indicated_style(&style, indicated);
+   ti_set_style(&style);
+
+   return write_table_line(table, length, row_index);
+}
+
+/**
+ * @brief Write the column titles at the cursor, aligned with the rows.
+ * @param "parms"  pager whose data source is a @ref PTABLE
+ *
+ * Call this to draw a heading in a top margin, moving the cursor
+ * first with @ref ti_set_cursor_position.  Redraw the heading when
+ * the horizontal position changes.
+ */
+EXPORT void pager_table_print_titles(const DPARMS *parms)
+{
+   assert(parms->printer == pager_table_printer);
+
+   static const PSTYLE plain = { 0, 0, 0 };
+   ti_set_style(&plain);
+   write_table_line((PTABLE*)parms->data_source, parms->chars_count, -1);
+}
+
+/**
+ * @brief Shift the view of a table one column to the right.
+ *
+ * Stops when the last column is fully visible.
+ */
+EXPORT ARV pager_table_right(DPARMS *parms)
+{
+   assert(parms->printer == pager_table_printer);
+   PTABLE *table = (PTABLE*)parms->data_source;
+
+   int width = -1;
+   for (int col = table->column_first; col < table->column_count; ++col)
+      width += table->widths[col] + 1;
+
+   if (width <= parms->chars_count)
+      return ARV_CONTINUE;
+
+   ++table->column_first;
+   return ARV_REPLOT_DATA;
+}
+
+/**
+ * @brief Shift the view of a table one column to the left.
+ */
+EXPORT ARV pager_table_left(DPARMS *parms)
+{
+   assert(parms->printer == pager_table_printer);
+   PTABLE *table = (PTABLE*)parms->data_source;
+
+   if (table->column_first == 0)
+      return ARV_CONTINUE;
+
+   --table->column_first;
+   return ARV_REPLOT_DATA;
+}
+
+/** @} */
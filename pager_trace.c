@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>     // malloc/free, getenv()
+#include <string.h>
+#include <unistd.h>     // getpid()
+#include <time.h>       // clock_gettime()
+
+#include "export.h"
+#include "pager.h"
+#include "pager_private.h"
+
+/** @brief Events kept when tracing is started by `PAGER_TRACE` */
+#define TRACE_DEFAULT_EVENTS 65536
+
+/**
+ * @brief A timed span of work, in a slot of the ring buffer.
+ *
+ * The members are written and read atomically, and @p seq is cleared
+ * while they are written, so an event being overwritten as the
+ * buffer is dumped is left out rather than torn.
+ */
+typedef struct trace_event {
+   unsigned long seq;       ///< 1 + number of the event, 0 while written
+   unsigned long start;     ///< monotonic nanoseconds
+   unsigned long duration;  ///< nanoseconds
+   const char *name;        ///< what was done, a string literal
+   const char *arg_name;    ///< what @p arg means, a string literal
+   int arg;
+   int tid;                 ///< thread, numbered as it first records
+} TEVENT;
+
+/** @brief Nonzero while events are recorded, see @ref PTRACE_BEGIN */
+int ptrace_on = 0;
+
+static TEVENT *events = NULL;
+static unsigned long event_count = 0;    ///< slots in @p events
+static unsigned long event_next = 0;     ///< number of the next event
+static char *dump_path = NULL;           ///< written by pager_cleanup()
+static int thread_count = 0;
+static __thread int thread_id = 0;
+
+/**
+ * @brief Monotonic time in nanoseconds, for an event's start.
+ */
+unsigned long ptrace_clock(void)
+{
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return now.tv_sec * 1000000000UL + now.tv_nsec;
+}
+
+/**
+ * @brief Record an event that started at @p start and ends now.
+ *
+ * Call through @ref PTRACE_END.  Safe from any thread.
+ */
+void ptrace_record(unsigned long start, const char *name, const char *arg_name, int arg)
+{
+   unsigned long end = ptrace_clock();
+
+   // A span that outlived pager_cleanup() has no buffer to go to:
+   TEVENT *slots = __atomic_load_n(&events, __ATOMIC_ACQUIRE);
+   unsigned long slot_count = __atomic_load_n(&event_count, __ATOMIC_RELAXED);
+   if (slots == NULL || slot_count == 0)
+      return;
+
+   if (thread_id == 0)
+      thread_id = __atomic_add_fetch(&thread_count, 1, __ATOMIC_RELAXED);
+
+   unsigned long number = __atomic_fetch_add(&event_next, 1, __ATOMIC_RELAXED);
+   TEVENT *event = &slots[number % slot_count];
+
+   __atomic_store_n(&event->seq, 0, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+   __atomic_store_n(&event->start, start, __ATOMIC_RELAXED);
+   __atomic_store_n(&event->duration, end - start, __ATOMIC_RELAXED);
+   __atomic_store_n(&event->name, name, __ATOMIC_RELAXED);
+   __atomic_store_n(&event->arg_name, arg_name, __ATOMIC_RELAXED);
+   __atomic_store_n(&event->arg, arg, __ATOMIC_RELAXED);
+   __atomic_store_n(&event->tid, thread_id, __ATOMIC_RELAXED);
+   __atomic_store_n(&event->seq, number + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Write a string as a JSON string, escaping quotes,
+ *        backslashes and control characters.
+ */
+static void write_json_string(FILE *f, const char *str)
+{
+   fputc('"', f);
+   for (; *str; ++str)
+   {
+      unsigned char chr = (unsigned char)*str;
+      if (chr == '"' || chr == '\\')
+         fprintf(f, "\\%c", chr);
+      else if (chr < ' ')
+         fprintf(f, "\\u%04x", chr);
+      else
+         fputc(chr, f);
+   }
+   fputc('"', f);
+}
+
+/**
+ * @brief Start tracing if `PAGER_TRACE` names a file, to be written
+ *        by @ref pager_cleanup.  Called by @ref pager_init.
+ */
+void ptrace_init(void)
+{
+   const char *path = getenv("PAGER_TRACE");
+   if (path && *path && !ptrace_on)
+      pager_trace_start(0, path);
+}
+
+/**
+ * @brief Write the trace, if one was asked for, and release it.
+ *        Called by @ref pager_cleanup.
+ */
+void ptrace_cleanup(void)
+{
+   if (events == NULL)
+      return;
+
+   __atomic_store_n(&ptrace_on, 0, __ATOMIC_RELEASE);
+   if (dump_path)
+      pager_trace_dump(dump_path);
+
+   free(dump_path);
+   dump_path = NULL;
+
+   TEVENT *released = events;
+   __atomic_store_n(&event_count, 0, __ATOMIC_RELAXED);
+   __atomic_store_n(&events, NULL, __ATOMIC_RELEASE);
+   free(released);
+}
+
+/**
+ * @defgroup TRACING Timeline of frames, printer calls and writes
+ * @brief Functions found in `pager_trace.c`
+ *
+ * While tracing, the library records the start and duration of
+ * each frame, each printer call, each write to the terminal and
+ * each action run by a context, in a ring buffer that keeps the
+ * latest events.  The buffer is written as Chrome trace events,
+ * to be loaded in `chrome://tracing` or Perfetto, on demand or by
+ * @ref pager_cleanup.
+ *
+ * Setting environment variable `PAGER_TRACE` to a file name starts
+ * tracing in @ref pager_init, so a slow session can be traced
+ * without changing the program.
+ *
+ * When not tracing, each place that records an event costs a test
+ * of one flag.
+ * @{
+ */
+
+/**
+ * @brief Start recording events.
+ * @param "capacity"  most recent events to keep, or 0 for 65536
+ * @param "path"      file to which @ref pager_cleanup writes the
+ *                    trace, or NULL to write it only on demand
+ * @return *true* if started, *false* if out of memory.
+ *
+ * Each event takes 48 bytes.  The buffer is kept until
+ * @ref pager_cleanup, so threads still drawing when tracing stops
+ * can't write to released memory.  Restarting with another
+ * @p capacity replaces the buffer, so do that only while no other
+ * thread draws.
+ */
+EXPORT bool pager_trace_start(int capacity, const char *path)
+{
+   unsigned long count = capacity > 0 ? (unsigned long)capacity : TRACE_DEFAULT_EVENTS;
+
+   __atomic_store_n(&ptrace_on, 0, __ATOMIC_RELEASE);
+
+   if (count != event_count)
+   {
+      TEVENT *resized = (TEVENT*)calloc(count, sizeof(TEVENT));
+      if (resized == NULL)
+         return false;
+
+      free(events);
+      events = resized;
+      event_count = count;
+   }
+   else
+      memset(events, 0, sizeof(TEVENT) * count);
+
+   free(dump_path);
+   dump_path = path ? strdup(path) : NULL;
+
+   __atomic_store_n(&event_next, 0, __ATOMIC_RELAXED);
+   __atomic_store_n(&ptrace_on, 1, __ATOMIC_RELEASE);
+   return true;
+}
+
+/**
+ * @brief Stop recording events, keeping those recorded to be dumped.
+ */
+EXPORT void pager_trace_stop(void)
+{
+   __atomic_store_n(&ptrace_on, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Write the recorded events as a Chrome trace.
+ * @param "path"  file to write
+ * @return *true* if written, *false* if there is no trace or the
+ *         file can't be written.
+ *
+ * Recording continues while the events are written.
+ */
+EXPORT bool pager_trace_dump(const char *path)
+{
+   if (events == NULL)
+      return false;
+
+   FILE *f = fopen(path, "w");
+   if (f == NULL)
+      return false;
+
+   unsigned long last = __atomic_load_n(&event_next, __ATOMIC_ACQUIRE);
+   unsigned long first = last > event_count ? last - event_count : 0;
+   int pid = (int)getpid();
+   const char *separator = "";
+
+   fputs("{\"traceEvents\":[", f);
+
+   for (unsigned long number = first; number < last; ++number)
+   {
+      const TEVENT *slot = &events[number % event_count];
+      if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != number + 1)
+         continue;
+
+      TEVENT event;
+      event.start = __atomic_load_n(&slot->start, __ATOMIC_RELAXED);
+      event.duration = __atomic_load_n(&slot->duration, __ATOMIC_RELAXED);
+      event.name = __atomic_load_n(&slot->name, __ATOMIC_RELAXED);
+      event.arg_name = __atomic_load_n(&slot->arg_name, __ATOMIC_RELAXED);
+      event.arg = __atomic_load_n(&slot->arg, __ATOMIC_RELAXED);
+      event.tid = __atomic_load_n(&slot->tid, __ATOMIC_RELAXED);
+
+      // Skip an event overwritten while it was read:
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != number + 1)
+         continue;
+
+      fprintf(f, "%s\n{\"name\":", separator);
+      write_json_string(f, event.name);
+      fprintf(f,
+              ",\"cat\":\"pager\",\"ph\":\"X\","
+              "\"ts\":%lu.%03lu,\"dur\":%lu.%03lu,\"pid\":%d,\"tid\":%d",
+              event.start / 1000, event.start % 1000,
+              event.duration / 1000, event.duration % 1000,
+              pid, event.tid);
+
+      if (event.arg_name)
+      {
+         fputs(",\"args\":{", f);
+         write_json_string(f, event.arg_name);
+         fprintf(f, ":%d}", event.arg);
+      }
+
+      fputc('}', f);
+      separator = ",";
+   }
+
+   fputs("\n],\"displayTimeUnit\":\"ms\"}\n", f);
+   return fclose(f) == 0;
+}
+
+/**
+ * @brief Note the start of work to be traced by the program.
+ * @return a start time for @ref pager_trace_end, or 0 if not tracing.
+ *
+ * The library can't see keystrokes, so a program traces its key
+ * dispatch by calling this before running the action and
+ * @ref pager_trace_end after.
+ */
+EXPORT unsigned long pager_trace_begin(void)
+{
+   return __atomic_load_n(&ptrace_on, __ATOMIC_RELAXED) ? ptrace_clock() : 0;
+}
+
+/**
+ * @brief Record work started with @ref pager_trace_begin.
+ * @param "start"  value returned by @ref pager_trace_begin
+ * @param "name"   what was done, a string that must outlive the
+ *                 trace, such as a literal
+ * @param "arg"    a number shown with the event, such as a key code
+ */
+EXPORT void pager_trace_end(unsigned long start, const char *name, int arg)
+{
+   if (start)
+      ptrace_record(start, name, "arg", arg);
+}
+
+/** @} */
@@ -0,0 +1,474 @@
+#include <stdlib.h>     // malloc/free
+#include <string.h>
+#include <limits.h>     // INT_MAX
+#include <assert.h>
+
+#include "export.h"
+#include "pager.h"
+#include "pager_private.h"
+
+/** @brief Columns of indentation for each level of the tree */
+#define TREE_INDENT 2
+
+/**
+ * @brief Nodes in preorder, and which of them are shown.
+ *
+ * A node's descendants follow it in preorder, so collapsing a node
+ * hides a range of nodes.  A segment tree over the nodes counts, for
+ * each range it covers, the collapses that hide the whole range and
+ * the nodes shown in it.  Collapses are counted rather than flagged
+ * so that a collapse inside another survives expanding the outer one,
+ * and hiding any number of nodes touches O(log n) segments.
+ */
+struct pager_tree {
+   int count;               ///< nodes in the tree
+   int *depths;             ///< level of each node, 0 for the roots
+   int *ends;               ///< index after the last descendant of each node
+   int *parents;            ///< index of the parent of each node, -1 for roots
+   bool *collapsed;         ///< nodes whose descendants are hidden
+
+   int leaves;              ///< leaves of the segment tree, a power of 2
+   int *cover;              ///< collapses hiding all of each segment
+   int *shown;              ///< nodes shown in each segment
+
+   pwb_print_line printer;  ///< prints a node, given its index
+   void *data_source;
+};
+
+/**
+ * @brief Recount the nodes shown in a segment from its children.
+ */
+static void update_segment(PTREE *tree, int segment, int low)
+{
+   if (tree->cover[segment] > 0)
+      tree->shown[segment] = 0;
+   else if (segment >= tree->leaves)
+      tree->shown[segment] = low < tree->count;
+   else
+      tree->shown[segment] = tree->shown[segment * 2] + tree->shown[segment * 2 + 1];
+}
+
+/**
+ * @brief Add @p delta collapses covering nodes @p first to @p last.
+ */
+static void cover_range(PTREE *tree, int segment, int low, int high,
+                        int first, int last, int delta)
+{
+   if (last < low || first > high)
+      return;
+
+   if (first <= low && high <= last)
+      tree->cover[segment] += delta;
+   else
+   {
+      int mid = (low + high) / 2;
+      cover_range(tree, segment * 2, low, mid, first, last, delta);
+      cover_range(tree, segment * 2 + 1, mid + 1, high, first, last, delta);
+   }
+
+   update_segment(tree, segment, low);
+}
+
+/**
+ * @brief Hide or show the descendants of a node.
+ */
+static void set_collapsed(PTREE *tree, int node, bool collapsed)
+{
+   if (tree->collapsed[node] == collapsed || tree->ends[node] == node + 1)
+      return;
+
+   tree->collapsed[node] = collapsed;
+   cover_range(tree, 1, 0, tree->leaves - 1,
+               node + 1, tree->ends[node] - 1, collapsed ? 1 : -1);
+}
+
+/**
+ * @brief Find the extent and parent of each node from the depths.
+ * @param "tree"   tree whose nodes are linked
+ * @param "stack"  room for the index of every node
+ */
+static void link_nodes(PTREE *tree, int *stack)
+{
+   int depth = 0;
+
+   for (int node = 0; node < tree->count; ++node)
+   {
+      while (depth > 0 && tree->depths[stack[depth - 1]] >= tree->depths[node])
+      {
+         int ended = stack[--depth];
+         tree->ends[ended] = node;
+      }
+
+      tree->parents[node] = depth > 0 ? stack[depth - 1] : -1;
+      stack[depth++] = node;
+   }
+
+   while (depth > 0)
+   {
+      int ended = stack[--depth];
+      tree->ends[ended] = tree->count;
+   }
+}
+
+/**
+ * @brief Update a pager for a change in the nodes shown below its focus.
+ * @return ARV_REPLOT_DATA, to show the change.
+ */
+static ARV reshow(DPARMS *parms)
+{
+   PTREE *tree = (PTREE*)parms->data_source;
+   parms->row_count = tree->shown[1];
+
+   // Keep the page full if rows below it were hidden:
+   int top = parms->row_count - parms->line_count;
+   if (parms->index_row_top > top)
+      parms->index_row_top = top < 0 ? 0 : top;
+   if (parms->index_row_top > parms->index_row_focus)
+      parms->index_row_top = parms->index_row_focus;
+
+   return ARV_REPLOT_DATA;
+}
+
+/**
+ * @brief Printer of the nodes of a tree, to test if the tree can be
+ *        drawn ahead.
+ */
+pwb_print_line pager_tree_node_printer(const PTREE *tree)
+{
+   return tree->printer;
+}
+
+/**
+ * @defgroup TREE_VIEW Collapsible trees
+ * @brief Functions found in `pager_tree.c`
+ *
+ * A tree is given as the depths of its nodes in preorder, as a
+ * process tree, a directory listing or nested JSON is naturally
+ * listed.  The pager's rows are the nodes that are shown, those not
+ * below a collapsed node, so the focus actions and printers work
+ * unchanged.  Finding the node of a row, the row of a node, and
+ * collapsing or expanding a node each take O(log n) time, however
+ * many nodes are hidden or shown.
+ * @{
+ */
+
+/**
+ * @brief Make a tree from the depths of its nodes in preorder.
+ * @param "depths"       level of each node, 0 for a root.  The
+ *                       descendants of a node are the nodes that
+ *                       follow it and are deeper than it.
+ * @param "count"        number of nodes
+ * @param "expanded"     *true* to show every node, *false* to show
+ *                       only the roots
+ * @param "printer"      prints a node, passed the index of the node
+ *                       as @p row_index, see @ref pager_tree_printer.
+ *                       May be NULL if the tree isn't printed with it.
+ * @param "data_source"  passed to @p printer
+ * @return new tree, or NULL if out of memory.  Release it with
+ *         @ref pager_tree_destroy.
+ */
+EXPORT PTREE *pager_tree_create(const int *depths,
+                                int count,
+                                bool expanded,
+                                pwb_print_line printer,
+                                void *data_source)
+{
+   PTREE *tree = (PTREE*)calloc(1, sizeof(PTREE));
+   if (tree == NULL)
+      return NULL;
+
+   tree->count = count;
+   tree->printer = printer;
+   tree->data_source = data_source;
+
+   tree->leaves = 1;
+   while (tree->leaves < count)
+      tree->leaves *= 2;
+
+   int nodes = count ? count : 1;
+   tree->depths = (int*)malloc(sizeof(int) * nodes);
+   tree->ends = (int*)malloc(sizeof(int) * nodes);
+   tree->parents = (int*)malloc(sizeof(int) * nodes);
+   tree->collapsed = (bool*)calloc(nodes, sizeof(bool));
+   tree->cover = (int*)calloc(tree->leaves * 2, sizeof(int));
+   tree->shown = (int*)malloc(sizeof(int) * tree->leaves * 2);
+
+   if (!tree->depths || !tree->ends || !tree->parents
+       || !tree->collapsed || !tree->cover || !tree->shown)
+   {
+      pager_tree_destroy(tree);
+      return NULL;
+   }
+
+   // The ancestors of each node are pending until their ends:
+   int *stack = (int*)malloc(sizeof(int) * nodes);
+   if (stack == NULL)
+   {
+      pager_tree_destroy(tree);
+      return NULL;
+   }
+
+   memcpy(tree->depths, depths, sizeof(int) * count);
+   link_nodes(tree, stack);
+   free(stack);
+
+   for (int leaf = 0; leaf < tree->leaves; ++leaf)
+      tree->shown[tree->leaves + leaf] = leaf < count;
+   for (int segment = tree->leaves - 1; segment >= 1; --segment)
+      tree->shown[segment] = tree->shown[segment * 2] + tree->shown[segment * 2 + 1];
+
+   if (!expanded)
+      for (int node = 0; node < count; ++node)
+         set_collapsed(tree, node, true);
+
+   return tree;
+}
+
+/**
+ * @brief Release a tree.
+ */
+EXPORT void pager_tree_destroy(PTREE *tree)
+{
+   free(tree->depths);
+   free(tree->ends);
+   free(tree->parents);
+   free(tree->collapsed);
+   free(tree->cover);
+   free(tree->shown);
+   free(tree);
+}
+
+/**
+ * @brief Number of nodes shown, the row count of the pager.
+ */
+EXPORT int pager_tree_row_count(const PTREE *tree)
+{
+   return tree->shown[1];
+}
+
+/**
+ * @brief Find the node shown on a row.
+ * @return index of the node, or -1 if @p row_index is out of range.
+ */
+EXPORT int pager_tree_node(const PTREE *tree, int row_index)
+{
+   if (row_index < 0 || row_index >= tree->shown[1])
+      return -1;
+
+   int segment = 1;
+   while (segment < tree->leaves)
+   {
+      segment *= 2;
+      if (row_index >= tree->shown[segment])
+      {
+         row_index -= tree->shown[segment];
+         ++segment;
+      }
+   }
+
+   return segment - tree->leaves;
+}
+
+/**
+ * @brief Find the row showing a node.
+ * @return index of the row, or -1 if the node is hidden.
+ */
+EXPORT int pager_tree_row(const PTREE *tree, int node)
+{
+   if (node < 0 || node >= tree->count)
+      return -1;
+
+   int row = 0, segment = 1, low = 0, high = tree->leaves - 1;
+   for (;;)
+   {
+      if (tree->cover[segment] > 0)
+         return -1;
+      if (segment >= tree->leaves)
+         return row;
+
+      int mid = (low + high) / 2;
+      segment *= 2;
+      if (node > mid)
+      {
+         row += tree->shown[segment];
+         ++segment;
+         low = mid + 1;
+      }
+      else
+         high = mid;
+   }
+}
+
+/**
+ * @brief Level of a node, 0 for a root.
+ */
+EXPORT int pager_tree_depth(const PTREE *tree, int node)
+{
+   return tree->depths[node];
+}
+
+/**
+ * @brief Parent of a node, or -1 for a root.
+ */
+EXPORT int pager_tree_parent(const PTREE *tree, int node)
+{
+   return tree->parents[node];
+}
+
+/**
+ * @brief Test if a node has children.
+ */
+EXPORT bool pager_tree_has_children(const PTREE *tree, int node)
+{
+   return tree->ends[node] > node + 1;
+}
+
+/**
+ * @brief Test if a node's children are shown, as they are for a
+ *        node without children.
+ *
+ * A node may be expanded but hidden by a collapsed ancestor.
+ */
+EXPORT bool pager_tree_is_expanded(const PTREE *tree, int node)
+{
+   return !tree->collapsed[node];
+}
+
+/**
+ * @brief Show or hide the descendants of a node.
+ * @param "tree"      tree holding the node
+ * @param "node"      node to change
+ * @param "expanded"  *true* to show the children of the node
+ *
+ * Descendants that are themselves collapsed stay so when their
+ * ancestor is expanded.  A pager showing the tree must then be
+ * updated with the new @ref pager_tree_row_count.  The actions
+ * below do that.
+ */
+EXPORT void pager_tree_set_expanded(PTREE *tree, int node, bool expanded)
+{
+   if (node >= 0 && node < tree->count)
+      set_collapsed(tree, node, !expanded);
+}
+
+/**
+ * @brief @ref pwb_print_line function for the rows of a tree.
+ *
+ * The @p data_source must be a @ref PTREE.  Each node is indented
+ * for its depth and marked `+` if it is collapsed or `-` if its
+ * children are shown, and the rest of the line is printed by the
+ * printer of the tree, passed the index of the node.
+ */
+EXPORT int pager_tree_printer(int row_index,
+                              int indicated,
+                              int length,
+                              void *data_source,
+                              void *data_extra)
+{
+   static const char spaces[] = "                                ";
+
+   PTREE *tree = (PTREE*)data_source;
+   int node = pager_tree_node(tree, row_index);
+   if (node < 0)
+      return pager_write_spans(NULL, 0, length, indicated);
+
+   int indent = tree->depths[node] * TREE_INDENT;
+   if (indent > length)
+      indent = length;
+
+   // Indent in spans no wider than the spaces written at once:
+   int written = 0;
+   while (written < indent)
+   {
+      int len = indent - written;
+      if (len > (int)sizeof(spaces) - 1)
+         len = sizeof(spaces) - 1;
+      PSPAN blank = { spaces, len, { 0, 0, 0 } };
+      written += pager_write_spans(&blank, 1, len, indicated);
+   }
+
+   if (written == length)
+      return length;
+
+   const char *marker = !pager_tree_has_children(tree, node) ? "  "
+      : tree->collapsed[node] ? "+ " : "- ";
+   PSPAN span = { marker, 2, { 0, 0, PAGER_ATTR_BOLD } };
+
+   int prefix = indent + 2;
+   if (prefix >= length || tree->printer == NULL)
+      return written + pager_write_spans(&span, 1, length - written, indicated);
+
+   pager_write_spans(&span, 1, 2, indicated);
+   (*tree->printer)(node, indicated, length - prefix, tree->data_source, data_extra);
+   return length;
+}
+
+/**
+ * @brief Action to collapse or expand the node with the focus.
+ *
+ * The pager must show the tree with @ref pager_tree_printer.  Rows
+ * of a selection are rows of the pager, not nodes, so a selection
+ * should be cleared when nodes are hidden or shown.
+ */
+EXPORT ARV pager_tree_toggle(DPARMS *parms)
+{
+   assert(parms->printer == pager_tree_printer);
+   PTREE *tree = (PTREE*)parms->data_source;
+
+   int node = pager_tree_node(tree, parms->index_row_focus);
+   if (node < 0 || !pager_tree_has_children(tree, node))
+      return ARV_CONTINUE;
+
+   pager_prerender_discard(parms, parms->index_row_focus, INT_MAX);
+   set_collapsed(tree, node, !tree->collapsed[node]);
+   return reshow(parms);
+}
+
+/**
+ * @brief Action to show the children of the node with the focus.
+ */
+EXPORT ARV pager_tree_expand(DPARMS *parms)
+{
+   assert(parms->printer == pager_tree_printer);
+   PTREE *tree = (PTREE*)parms->data_source;
+
+   int node = pager_tree_node(tree, parms->index_row_focus);
+   if (node < 0 || !tree->collapsed[node])
+      return ARV_CONTINUE;
+
+   pager_prerender_discard(parms, parms->index_row_focus, INT_MAX);
+   set_collapsed(tree, node, false);
+   return reshow(parms);
+}
+
+/**
+ * @brief Action to hide the children of the node with the focus, or
+ *        if they are hidden, to move the focus to its parent.
+ */
+EXPORT ARV pager_tree_collapse(DPARMS *parms)
+{
+   assert(parms->printer == pager_tree_printer);
+   PTREE *tree = (PTREE*)parms->data_source;
+
+   int node = pager_tree_node(tree, parms->index_row_focus);
+   if (node < 0)
+      return ARV_CONTINUE;
+
+   if (pager_tree_has_children(tree, node) && !tree->collapsed[node])
+   {
+      pager_prerender_discard(parms, parms->index_row_focus, INT_MAX);
+      set_collapsed(tree, node, true);
+      return reshow(parms);
+   }
+
+   int parent = tree->parents[node];
+   if (parent < 0)
+      return ARV_CONTINUE;
+
+   parms->index_row_focus = pager_tree_row(tree, parent);
+   if (parms->index_row_top > parms->index_row_focus)
+      parms->index_row_top = parms->index_row_focus;
+   return ARV_REPLOT_DATA;
+}
+
+/** @} */
@@ -2,45 +2,43 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h>    // for get_env()
+#include <stdarg.h>    // for va_list in ti_printf
+#include <errno.h>
 #include <sys/ioctl.h>
+#include <poll.h>
 
 #include <assert.h>
 #include <alloca.h>    // needed by ti_printf
+#include <pthread.h>
 
 #include <curses.h>    // for tigetstr, tiparm
 #include <term.h>
 
 #include "export.h"
+#include "pager.h"
+#include "pager_private.h"
 #include "termstuff.h"
+#include "pager_cache.h"
 
 /**
- * @brief Equivalent to `struct termcap_entry` found in `lib_cons/cons.h`
- *
- * Using an equivalent struct to enable cooperation between the two
- * submodules, but using a different name to preserve the disconnect
- * between the submodules.
- *
- * The values can be set by hand in a testing environment
- */
-typedef struct termcap_value {
-   const char *name;
-   const char *value;
-} TCVAL;
-
-TCVAL code_vals[] = {
-   { "cl" },              // 'clear'  reset screen
-   { "cm" },              // 'cm'     cursor address (move to row;col)
-   { "u7" },              // 'u7'     conventional cursor position report
-   { "cs" },              // 'csr'    change scroll region
-   { "sf" },              // 'ind'    scroll forward
-   { "sr" },              //  'ri'    scroll reverse
-   { "vi" },              // 'civis'  cursor invisible
-   { "ve" },              // 'cnorm'  normal cursor
-   { "so" },              // 'smso'   enter standout mode
-   { "se" },              // 'rmso'   exit standout mode
-   { "ti" },              // 'smcup'  enter ca mode
-   { "te" },              // 'rmcup'  exit ca mode
-   { NULL }
+ * @brief Termcap codes of the capabilities used by the pager.
+ *
+ * The order must match @ref term_indexes.
+ */
+static const char *cap_codes[] = {
+   "cl",              // 'clear'  reset screen
+   "cm",              // 'cm'     cursor address (move to row;col)
+   "u7",              // 'u7'     conventional cursor position report
+   "cs",              // 'csr'    change scroll region
+   "sf",              // 'ind'    scroll forward
+   "sr",              //  'ri'    scroll reverse
+   "vi",              // 'civis'  cursor invisible
+   "ve",              // 'cnorm'  normal cursor
+   "so",              // 'smso'   enter standout mode
+   "se",              // 'rmso'   exit standout mode
+   "ti",              // 'smcup'  enter ca mode
+   "te",              // 'rmcup'  exit ca mode
+   NULL
 };
 
 enum term_indexes {
@@ -59,19 +57,291 @@ enum term_indexes {
    TI_INDEX_END
 };
 
-#define CLEAR_STR                 code_vals[TI_CLEAR].value
-#define MOVE_CURSOR_STR           code_vals[TI_MOVE_CURSOR].value
-#define REPORT_CURSOR_STR         code_vals[TI_REPORT_CURSOR].value
-#define SCROLL_REGION_STR         code_vals[TI_SCROLL_REGION].value
-#define SCROLL_FORWARD_STR        code_vals[TI_SCROLL_FORWARD].value
-#define SCROLL_REVERSE_STR        code_vals[TI_SCROLL_REVERSE].value
-#define HIDE_CURSOR_STR           code_vals[TI_HIDE_CURSOR].value
-#define SHOW_CURSOR_STR           code_vals[TI_SHOW_CURSOR].value
-#define ENTER_STANDOUT_MODE_STR   code_vals[TI_ENTER_STANDOUT_MODE].value
-#define EXIT_STANDOUT_MODE_STR    code_vals[TI_EXIT_STANDOUT_MODE].value
-#define ENTER_CA_MODE_STR         code_vals[TI_ENTER_CA_MODE].value
-#define EXIT_CA_MODE_STR          code_vals[TI_EXIT_CA_MODE].value
+/**
+ * @brief Capability values for one type of terminal.
+ *
+ * Capability sets are loaded once per terminal type and shared by
+ * every @ref PTERM of that type, so a terminal session only costs
+ * a pointer for its capabilities.
+ */
+typedef struct term_capset {
+   struct term_capset *next;
+   char *name;                         ///< terminal type, as in `$TERM`
+   const char *values[TI_INDEX_END];   ///< never NULL once loaded
+   unsigned int missing;               ///< bit flags of missing capabilities
+   bool lr_margins;                    ///< may support DECSLRM, see @ref query_lr_margins
+} TCAPSET;
+
+static TCAPSET *capsets = NULL;
+
+/**
+ * @brief State of a terminal driven by the pager.
+ *
+ * The output buffer collects frames (see @ref FRAME_BUFFER), and
+ * also holds output that a non-blocking descriptor couldn't accept,
+ * until @ref pager_term_flush can write it.
+ */
+struct pager_term {
+   int fd_in;               ///< read keystrokes and reports
+   int fd_out;              ///< write screen output
+   const TCAPSET *caps;
+   int rows;                ///< screen rows, if set by @ref pager_term_set_size
+   int cols;                ///< screen columns, if set by @ref pager_term_set_size
+
+   char *buff;              ///< output buffer
+   int size;                ///< bytes allocated to @p buff
+   int len;                 ///< bytes waiting in @p buff
+   int depth;               ///< nesting level of open frames
+
+   int scroll_top;          ///< current scroll window, to avoid
+   int scroll_count;        ///  resending unchanged limits
+   int side_left;           ///< current left/right margins,
+   int side_count;          ///  0 while margin mode is off
+   bool lr_margins;         ///< confirmed to support DECSLRM
+
+   PSTATS *stats;           ///< counters of the @ref DPARMS last drawn
+   PSTYLE style;            ///< current SGR state, see @ref ti_set_style
+   unsigned long trace_start; ///< start of the outermost frame, if tracing
+};
+
+/** @brief Terminal of the process, used unless another is selected */
+static PTERM default_term = { STDIN_FILENO, STDOUT_FILENO, NULL, 0, 0,
+                              NULL, 0, 0, 0, -1, -1, 0, 0, false, NULL };
+
+/**
+ * @brief Target of the `ti_` functions, see @ref ti_select_term
+ *
+ * Each thread has its own, so a worker can render into a capture
+ * terminal, see @ref ti_capture_open, while the UI thread draws.
+ */
+static __thread PTERM *active_term = &default_term;
+
+#define CAP(t, index)             ((t)->caps->values[index])
+
+/**
+ * @brief Compiled-in capability values for common terminals.
+ *
+ * When `$TERM` matches one of these profiles, the terminfo database
+ * is not consulted at all, saving the cost of `setupterm` at startup.
+ * Values are listed in @ref term_indexes order, and a NULL value
+ * marks a capability the terminal lacks.
+ */
+typedef struct term_profile {
+   const char *names;      // space-separated list of matching $TERM values
+   bool lr_margins;        // may support DECSLRM left/right scroll margins
+   const char *values[TI_INDEX_END];
+} TPROFILE;
+
+#define XTERM_CUP "\x1b[%i%p1%d;%p2%dH"
+#define XTERM_CSR "\x1b[%i%p1%d;%p2%dr"
+
+static const TPROFILE term_profiles[] = {
+   { "xterm-256color xterm", true,
+     { "\x1b[H\x1b[2J", XTERM_CUP, "\x1b[6n", XTERM_CSR, "\n", "\x1bM",
+       "\x1b[?25l", "\x1b[?12l\x1b[?25h", "\x1b[7m", "\x1b[27m",
+       "\x1b[?1049h\x1b[22;0;0t", "\x1b[?1049l\x1b[23;0;0t" } },
+   { "screen screen-256color", false,
+     { "\x1b[H\x1b[J", XTERM_CUP, "\x1b[6n", XTERM_CSR, "\n", "\x1bM",
+       "\x1b[?25l", "\x1b[34h\x1b[?25h", "\x1b[3m", "\x1b[23m",
+       "\x1b[?1049h", "\x1b[?1049l" } },
+   { "tmux tmux-256color", false,
+     { "\x1b[H\x1b[J", XTERM_CUP, "\x1b[6n", XTERM_CSR, "\n", "\x1bM",
+       "\x1b[?25l", "\x1b[34h\x1b[?25h", "\x1b[7m", "\x1b[27m",
+       "\x1b[?1049h", "\x1b[?1049l" } },
+   { "linux", false,
+     { "\x1b[H\x1b[J", XTERM_CUP, "\x1b[6n", XTERM_CSR, "\n", "\x1bM",
+       "\x1b[?25l\x1b[?1c", "\x1b[?25h\x1b[?0c", "\x1b[7m", "\x1b[27m",
+       NULL, NULL } },
+   { NULL }
+};
+
+/**
+ * @brief Find a compiled-in profile matching the terminal name
+ * @param "term"   terminal name, usually from `$TERM`
+ * @return matching profile, or NULL if not found
+ */
+static const TPROFILE *find_term_profile(const char *term)
+{
+   if (term == NULL || *term == '\0')
+      return NULL;
+
+   int len = strlen(term);
+   const TPROFILE *ptr = term_profiles;
+   while (ptr->names)
+   {
+      const char *name = ptr->names;
+      while (*name)
+      {
+         const char *end = strchr(name, ' ');
+         int nlen = end ? end - name : (int)strlen(name);
+         if (nlen == len && strncmp(name, term, len) == 0)
+            return ptr;
+
+         name += nlen;
+         if (*name == ' ')
+            ++name;
+      }
+      ++ptr;
+   }
+
+   return NULL;
+}
+
+/**
+ * @brief Read capability values saved by @ref save_cached_values
+ * @param "set"    capability set to be filled
+ * @param "path"   cache file for the terminal type
+ * @return *true* if every value was read from the cache file, or
+ *         *false*, leaving @p set->values empty
+ *
+ * Cache file lines take the form `xx=value`, where `xx` is the
+ * termcap code and non-printing characters in `value` are written
+ * as 3-digit octal escapes.  A missing capability is saved as `xx!`.
+ */
+static bool load_cached_values(TCAPSET *set, const char *path)
+{
+   FILE *f = fopen(path, "r");
+   if (f == NULL)
+      return false;
+
+   bool result = false;
+   char line[256];
+
+   if (fgets(line, sizeof(line), f) == NULL
+       || strcmp(line, "libpager-termcaps 1\n") != 0)
+      goto abandon;
+
+   for (int index = 0; index < TI_INDEX_END; ++index)
+   {
+      if (fgets(line, sizeof(line), f) == NULL
+          || strncmp(line, cap_codes[index], 2) != 0)
+         goto abandon;
+
+      if (line[2] == '!')
+         continue;
+      else if (line[2] != '=')
+         goto abandon;
+
+      // Decoded string is never longer than the encoded string:
+      char *val = (char*)malloc(strlen(line));
+      if (val == NULL)
+         goto abandon;
+
+      char *out = val;
+      const char *in = &line[3];
+      for (; *in && *in != '\n'; ++in)
+      {
+         if (*in == '\\' && in[1] && in[2] && in[3])
+         {
+            *out++ = (char)(((in[1]-'0') << 6) | ((in[2]-'0') << 3) | (in[3]-'0'));
+            in += 3;
+         }
+         else
+            *out++ = *in;
+      }
+      *out = '\0';
+      set->values[index] = val;
+   }
+
+   result = true;
+
+  abandon:
+   fclose(f);
+
+   // Release the values read before a short or corrupt line:
+   if (!result)
+      for (int index = 0; index < TI_INDEX_END; ++index)
+      {
+         free((void*)set->values[index]);
+         set->values[index] = NULL;
+      }
+
+   return result;
+}
+
+/**
+ * @brief Save capability values so later starts can skip terminfo
+ * @param "set"    capability set, as read from terminfo
+ * @param "path"   cache file for the terminal type
+ *
+ * The values are written to a temporary file that then replaces the
+ * old one, so a program starting at the same time never reads a
+ * partly written file.
+ */
+static void save_cached_values(const TCAPSET *set, const char *path)
+{
+   char temp[540];
+   snprintf(temp, sizeof(temp), "%s.%d", path, (int)getpid());
+
+   FILE *f = fopen(temp, "w");
+   if (f == NULL)
+      return;
+
+   fputs("libpager-termcaps 1\n", f);
+
+   for (int index = 0; index < TI_INDEX_END; ++index)
+   {
+      if (set->values[index] == NULL)
+      {
+         fprintf(f, "%s!\n", cap_codes[index]);
+         continue;
+      }
 
+      fprintf(f, "%s=", cap_codes[index]);
+      const unsigned char *chr = (const unsigned char*)set->values[index];
+      for (; *chr; ++chr)
+      {
+         if (*chr < ' ' || *chr > '~' || *chr == '\\')
+            fprintf(f, "\\%03o", *chr);
+         else
+            fputc(*chr, f);
+      }
+      fputc('\n', f);
+   }
+
+   bool ok = !ferror(f);
+   if (fclose(f))
+      ok = false;
+
+   if (!ok || rename(temp, path) != 0)
+      unlink(temp);
+}
+
+/**
+ * @brief Read capability values from the terminfo database.
+ * @param "set"   capability set to be filled
+ * @param "fd"    descriptor of a terminal of the type
+ * @return *false* if the terminal type isn't in the database
+ *
+ * For the process's own terminal type, an entry already loaded by
+ * the application is used.  Otherwise the entry is loaded with
+ * `setupterm` and kept, since the values point into it.
+ */
+static bool load_terminfo_values(TCAPSET *set, int fd)
+{
+   int err;
+   const char *own_type = getenv("TERM");
+   bool is_own = own_type && strcmp(own_type, set->name) == 0;
+
+   TERMINAL *saved = cur_term;
+   if (!is_own || cur_term == NULL)
+   {
+      if (setupterm(set->name, fd, &err) != OK)
+      {
+         set_curterm(saved);
+         return false;
+      }
+   }
+
+   for (int index = 0; index < TI_INDEX_END; ++index)
+      set->values[index] = tgetstr(cap_codes[index], NULL);
+
+   // Leave the application's terminal in place:
+   if (saved)
+      set_curterm(saved);
+
+   return true;
+}
 
 /**
  * @brief Get terminfo value from environment if possible
@@ -92,51 +362,365 @@ const char *get_less_termcap_val(const char *code)
 }
 
 /**
- * @brief Populate the value members of the global array of TCVAL elements.
- * @return *true* if successful, *false* for any errors.
+ * @brief Get the capability set of a terminal type, loading it if necessary.
+ * @param "name"  terminal type, as in `$TERM`
+ * @param "fd"    descriptor of a terminal of the type, for terminfo
+ * @return shared capability set, or NULL if out of memory
+ *
+ * Values are taken from the first of the following that succeeds:
+ * - a compiled-in profile matching @p name,
+ * - a cache file for @p name (see @ref pager_set_cache_dir),
+ * - the terminfo database, which refreshes the cache file.
+ *
+ * `LESS_TERMCAP_xx` environment variables override any of these.
+ *
+ * Missing capabilities are replaced by empty strings rather than
+ * being treated as fatal errors.
  */
-bool ti_get_code_values(void)
+static const TCAPSET *get_capset(const char *name, int fd)
 {
-   // Quick exit if already initialized:
-   if (CLEAR_STR != NULL)
-      return true;
+   if (name == NULL)
+      name = "";
+
+   TCAPSET *set = capsets;
+   for (; set; set = set->next)
+      if (strcmp(set->name, name) == 0)
+         return set;
+
+   set = (TCAPSET*)malloc(sizeof(TCAPSET) + strlen(name) + 1);
+   if (set == NULL)
+      return NULL;
 
-   TCVAL *ptr = code_vals;
-   while (ptr->name)
+   memset(set, 0, sizeof(TCAPSET));
+   set->name = (char*)(set + 1);
+   strcpy(set->name, name);
+
+   const TPROFILE *profile = find_term_profile(name);
+   if (profile)
    {
-      const char *val = get_less_termcap_val(ptr->name);
-      if (val == NULL)
-         val = tgetstr(ptr->name, NULL);
+      memcpy(set->values, profile->values, sizeof(set->values));
+      set->lr_margins = profile->lr_margins;
+   }
+   else
+   {
+      char path[512];
+      bool use_cache = pcache_path(path, sizeof(path), "term", name);
+      if (!use_cache || !load_cached_values(set, path))
+      {
+         memset(set->values, 0, sizeof(set->values));
+
+         // Only a type found in terminfo is cached, so it's retried:
+         if (load_terminfo_values(set, fd) && use_cache)
+            save_cached_values(set, path);
+      }
+   }
 
+   for (int index = 0; index < TI_INDEX_END; ++index)
+   {
+      const char *val = get_less_termcap_val(cap_codes[index]);
       if (val)
-         ptr->value = val;
-      else
+         set->values[index] = val;
+
+      if (set->values[index] == NULL || *set->values[index] == '\0')
       {
-         printf("Failed to find termcap code %s.\n", ptr->name);
-         exit(1);
+         set->values[index] = "";
+         set->missing |= 1 << index;
       }
+   }
 
-      ++ptr;
+   set->next = capsets;
+   capsets = set;
+
+   return set;
+}
+
+/**
+ * @brief Load the capabilities of the process's terminal.
+ * @return *true* if successful, *false* if the terminal can't position
+ *         the cursor, without which the pager can't work.
+ */
+bool ti_get_code_values(void)
+{
+   if (default_term.caps == NULL)
+      default_term.caps = get_capset(getenv("TERM"), STDOUT_FILENO);
+
+   return default_term.caps
+      && !(default_term.caps->missing & (1 << TI_MOVE_CURSOR));
+}
+
+bool ti_values_initialized(void)
+{
+   return active_term->caps != NULL;
+}
+
+/**
+ * @brief Report if a terminal capability was found.
+ * @param "index"   one of the @ref term_indexes values
+ */
+static bool ti_has_cap(int index)
+{
+   assert(index >= 0 && index < TI_INDEX_END);
+   return active_term->caps && !(active_term->caps->missing & (1 << index));
+}
+
+/**
+ * @brief Report if the terminal can scroll a region in place.
+ *
+ * If not, pager actions must replot rather than scroll.
+ */
+bool ti_can_scroll(void)
+{
+   return ti_has_cap(TI_SCROLL_REGION)
+      && ti_has_cap(TI_SCROLL_FORWARD)
+      && ti_has_cap(TI_SCROLL_REVERSE);
+}
+
+/**
+ * @brief Report if the terminal can confine scrolling between
+ *        left and right margins (DECSLRM).
+ *
+ * Only terminals whose profile allows it, and which confirmed it
+ * when asked by @ref query_lr_margins, are trusted with this.  Panes
+ * narrower than the screen are replotted instead of scrolled when
+ * it's unavailable.
+ */
+bool ti_can_scroll_sides(void)
+{
+   return ti_can_scroll() && active_term->lr_margins;
+}
+
+/**
+ * @defgroup FRAME_BUFFER Collects output to be written all at once
+ *
+ * While a frame is open, everything sent through @ref ti_write_str
+ * or @ref ti_printf is saved to the buffer of the active terminal,
+ * to be written with a single `write` when the outermost frame is
+ * closed.  Frames can be nested so several panes can be composed
+ * into one update.
+ * @{
+ */
+
+/** @brief Buffers larger than this are released after being written */
+#define FRAME_KEEP_SIZE 16384
+
+/**
+ * @brief Write bytes to the terminal, retrying on partial writes.
+ * @return number of bytes written, which is less than @p len only
+ *         if the descriptor is non-blocking and full, or failed.
+ */
+static int term_write_fd(PTERM *term, const char *str, int len)
+{
+   PTRACE_BEGIN(trace);
+   int total = 0;
+   while (total < len)
+   {
+      ssize_t written = write(term->fd_out, str + total, len - total);
+      PSTAT_INC(term->stats, write_calls);
+      if (written < 0 && errno == EINTR)
+         continue;
+      if (written <= 0)
+         break;
+      PSTAT_ADD(term->stats, bytes_written, written);
+      total += written;
    }
+   PTRACE_END(trace, "flush", "bytes", total);
+   return total;
+}
+
+/**
+ * @brief Make room for @p len more bytes in the output buffer.
+ * @return *true* if the room is available.
+ */
+static bool term_reserve(PTERM *term, int len)
+{
+   if (term->len + len <= term->size)
+      return true;
 
+   int new_size = term->size ? term->size : 4096;
+   while (new_size < term->len + len)
+      new_size *= 2;
+
+   char *temp = (char*)realloc(term->buff, new_size);
+   if (temp == NULL)
+      return false;
+
+   term->buff = temp;
+   term->size = new_size;
    return true;
 }
 
-bool ti_values_initialized(void)
+/**
+ * @brief Write as much of the output buffer as the terminal accepts.
+ */
+static void term_flush(PTERM *term)
+{
+   if (term->len > 0)
+   {
+      int written = term_write_fd(term, term->buff, term->len);
+      if (written < term->len)
+         memmove(term->buff, term->buff + written, term->len - written);
+      term->len -= written;
+   }
+
+   // Don't let one large frame pin memory for the life of a session:
+   if (term->len == 0 && term->depth == 0 && term->size > FRAME_KEEP_SIZE)
+   {
+      free(term->buff);
+      term->buff = NULL;
+      term->size = 0;
+   }
+}
+
+/**
+ * @brief Send bytes to a terminal, through its buffer if a frame is
+ *        open or earlier output is still waiting.
+ */
+static void term_write(PTERM *term, const char *str, int len)
+{
+   if (len <= 0)
+      return;
+
+   if (term->depth == 0)
+      term_flush(term);
+
+   if (term->depth > 0 || term->len > 0)
+   {
+      if (term_reserve(term, len))
+      {
+         memcpy(term->buff + term->len, str, len);
+         term->len += len;
+      }
+      return;
+   }
+
+   int written = term_write_fd(term, str, len);
+
+   // Keep what a non-blocking descriptor couldn't take:
+   if (written < len && term_reserve(term, len - written))
+   {
+      memcpy(term->buff, str + written, len - written);
+      term->len = len - written;
+   }
+}
+
+/**
+ * @brief Write the contents of the frame buffer, even if a frame is open.
+ */
+void ti_flush(void)
+{
+   term_flush(active_term);
+}
+
+/**
+ * @brief Start collecting output for a single write.
+ */
+EXPORT void ti_begin_frame(void)
+{
+   if (active_term->depth++ == 0)
+   {
+      PTRACE_BEGIN(trace);
+      active_term->trace_start = trace;
+   }
+}
+
+/**
+ * @brief Close a frame opened with @ref ti_begin_frame, writing the
+ *        collected output if it was the outermost frame.
+ */
+EXPORT void ti_end_frame(void)
+{
+   assert(active_term->depth > 0);
+
+   // Leave the terminal in its default style between frames:
+   if (active_term->depth == 1)
+   {
+      static const PSTYLE plain = { 0, 0, 0 };
+      ti_set_style(&plain);
+   }
+
+   if (--active_term->depth == 0)
+   {
+      PSTAT_INC(active_term->stats, frames);
+      int bytes = active_term->len;
+      term_flush(active_term);
+      PTRACE_END(active_term->trace_start, "frame", "bytes", bytes);
+   }
+}
+
+/**
+ * @brief Write bytes to the terminal, through the frame buffer if open.
+ * @param "str"   bytes to write
+ * @param "len"   number of bytes to write
+ */
+EXPORT void ti_write(const char *str, int len)
+{
+   term_write(active_term, str, len);
+}
+
+/**
+ * @brief Open a terminal that collects output without writing it.
+ * @param "like"  terminal whose capabilities are used, NULL for the
+ *                process's terminal
+ * @return new capture terminal, or NULL if out of memory.  Release
+ *         it with @ref pager_term_close.
+ *
+ * Select the capture, open a frame, write to it as to a terminal,
+ * then take the output with @ref ti_capture_take.
+ */
+PTERM *ti_capture_open(const PTERM *like)
+{
+   if (like == NULL)
+      like = &default_term;
+
+   PTERM *term = (PTERM*)malloc(sizeof(PTERM));
+   if (term)
+   {
+      memset(term, 0, sizeof(PTERM));
+      term->fd_in = term->fd_out = -1;
+      term->caps = like->caps;
+      term->lr_margins = like->lr_margins;
+      term->rows = like->rows;
+      term->cols = like->cols;
+      term->scroll_top = term->scroll_count = -1;
+   }
+
+   return term;
+}
+
+/**
+ * @brief Take the output collected by the active capture terminal.
+ * @param "len"  [out] bytes of output
+ * @return the output, which the caller must free, or NULL if none.
+ *
+ * The open frame is closed, returning to the default style as
+ * @ref ti_end_frame does, so the output can be written where the
+ * terminal is known to be in its default style.
+ */
+char *ti_capture_take(int *len)
 {
-   return CLEAR_STR != NULL;
+   static const PSTYLE plain = { 0, 0, 0 };
+   ti_set_style(&plain);
+
+   char *buff = active_term->buff;
+   *len = active_term->len;
+
+   active_term->buff = NULL;
+   active_term->size = active_term->len = active_term->depth = 0;
+   return buff;
 }
 
+/** @} */
 
 /**
- * @brief Unbuffered write string to STDOUT to run the terminal
+ * @brief Write string to the active terminal
  * @param "str"   String to write
+ *
+ * The write is unbuffered unless a frame is open.
  */
 EXPORT void ti_write_str(const char *str)
 {
-   int len;
-   if (str && (len=strlen(str)) > 0)
-      write(STDOUT_FILENO, str, len);
+   if (str)
+      term_write(active_term, str, strlen(str));
 }
 
 /**
@@ -166,24 +750,107 @@ int vdprintf(int fd, const char *restrict format, va_list ap)
 #endif
 
 /**
- * @brief Unbuffered two-pass printf to STDOUT
+ * @brief Two-pass printf to the active terminal
  * @param "fmt"    format string aux `printf`
  * @param "..."    values matching tokens in @p fmt
  * @return number of characters written to the stream
  *
- * This function uses vdprintf() for an unbuffered write
- * of the content.
+ * If a frame is open, the output is formatted directly into the
+ * frame buffer.  Otherwise this function uses vdprintf() for an
+ * unbuffered write of the content.
  */
 EXPORT int ti_printf(const char *fmt, ...)
 {
+   PTERM *term = active_term;
    va_list args;
+   int len;
+
+   if (term->depth > 0 || term->len > 0)
+   {
+      va_start(args, fmt);
+      len = vsnprintf(NULL, 0, fmt, args);
+      va_end(args);
+
+      if (len > 0 && term_reserve(term, len + 1))
+      {
+         va_start(args, fmt);
+         vsnprintf(term->buff + term->len, len + 1, fmt, args);
+         va_end(args);
+         term->len += len;
+
+         if (term->depth == 0)
+            term_flush(term);
+         return len;
+      }
+   }
+
    va_start(args, fmt);
-   int len = vdprintf(STDOUT_FILENO, fmt, args);
+   len = vdprintf(term->fd_out, fmt, args);
    va_end(args);
 
+   PSTAT_INC(term->stats, write_calls);
+   PSTAT_ADD(term->stats, bytes_written, len > 0 ? len : 0);
+
    return len;
 }
 
+/** @brief Milliseconds to wait for each byte of a terminal report */
+#define REPORT_TIMEOUT 250
+
+/**
+ * @brief Ask the terminal if it supports left/right margin mode.
+ *
+ * Many terminals share the `xterm-256color` type without supporting
+ * DECLRMM, and take the DECSLRM sequence for a cursor save.  Their
+ * panes would be scrolled across the whole screen, so the mode is
+ * requested with DECRQM, followed by a cursor position report that
+ * every terminal answers, to avoid waiting on terminals that ignore
+ * DECRQM.  Only a reply that the mode is known marks it supported.
+ */
+static void query_lr_margins(PTERM *term)
+{
+   term->lr_margins = false;
+   if (term->caps == NULL || !term->caps->lr_margins || term->fd_in < 0)
+      return;
+
+   int fh = term->fd_in;
+
+   term_flush(term);
+   static const char request[] = "\x1b[?69$p";
+   term_write_fd(term, request, sizeof(request) - 1);
+   const char *report = CAP(term, TI_REPORT_CURSOR);
+   term_write_fd(term, report, strlen(report));
+
+   struct termios original, raw;
+   bool restore = tcgetattr(fh, &original) == 0;
+   if (restore)
+   {
+      raw = original;
+      raw.c_lflag &= ~(ECHO|ECHONL|ICANON|ISIG|IEXTEN);
+      tcsetattr(fh, TCSANOW, &raw);
+   }
+
+   // Read "\x1b[?69;<mode>$y", if answered, then "\x1b[row;colR":
+   char buff[64];
+   int len = 0;
+   struct pollfd pfd = { fh, POLLIN, 0 };
+   while (len < (int)sizeof(buff) - 1
+          && poll(&pfd, 1, REPORT_TIMEOUT) == 1
+          && read(fh, &buff[len], 1) == 1)
+      if (buff[len++] == 'R')
+         break;
+   buff[len] = '\0';
+
+   // Modes 1-3 are set or reset; 0 is unknown and 4 is permanently reset:
+   const char *reply = strstr(buff, "\x1b[?69;");
+   int mode = 0;
+   if (reply && sscanf(reply, "\x1b[?69;%d$y", &mode) == 1)
+      term->lr_margins = mode >= 1 && mode <= 3;
+
+   if (restore)
+      tcsetattr(fh, TCSANOW, &original);
+}
+
 /**
  * @brief Collect terminal strings and set up screen to run the pager
  * This should be run once at the beginning of a program to prepare
@@ -196,7 +863,9 @@ EXPORT void ti_start_term(void)
    // setupterm(NULL, STDOUT_FILENO, (int*)0);
    // get_term_values();
    ti_get_code_values();
-   ti_write_str(ENTER_CA_MODE_STR);
+   ti_select_term(NULL, NULL);
+   query_lr_margins(active_term);
+   ti_write_str(CAP(active_term, TI_ENTER_CA_MODE));
    ti_reset_screen(NULL);
 }
 
@@ -213,8 +882,25 @@ EXPORT void ti_cleanup_term(void)
    int row, col;
    ti_get_screen_size(&row, &col);
    ti_set_scroll_limit(0,row);
+   ti_clear_side_limits();
 
-   ti_write_str(EXIT_CA_MODE_STR);
+   ti_write_str(CAP(active_term, TI_EXIT_CA_MODE));
+   ti_flush();
+}
+
+/**
+ * @brief Make a terminal the target of the `ti_` functions.
+ * @param "term"   terminal to use, NULL for the process's terminal
+ * @param "stats"  counters to update for output to @p term, or NULL
+ *
+ * The pager functions select the terminal of the @ref DPARMS they
+ * are given, so printer functions called by the pager write to the
+ * right terminal through @ref ti_write_str or @ref ti_printf.
+ */
+void ti_select_term(PTERM *term, PSTATS *stats)
+{
+   active_term = term ? term : &default_term;
+   active_term->stats = stats;
 }
 
 /** @brief Clear screen and home cursor */
@@ -223,7 +909,23 @@ EXPORT void ti_reset_screen(const char *cmd)
    if (cmd)
       ti_write_str(cmd);
 
-   ti_write_str(CLEAR_STR);
+   ti_write_str(CAP(active_term, TI_CLEAR));
+}
+
+/** @brief Serializes `tiparm`, which formats into a static buffer */
+static pthread_mutex_t tiparm_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Write a capability with two parameters.
+ *
+ * Workers drawing into capture terminals, see @ref ti_capture_open,
+ * may call this at the same time as the UI thread.
+ */
+static void write_cap(const char *cap, int first, int second)
+{
+   pthread_mutex_lock(&tiparm_lock);
+   ti_write_str(tiparm(cap, first, second));
+   pthread_mutex_unlock(&tiparm_lock);
 }
 
 /**
@@ -233,8 +935,7 @@ EXPORT void ti_reset_screen(const char *cmd)
  */
 EXPORT void ti_set_cursor_position(int row, int col)
 {
-   const char *str = tiparm(MOVE_CURSOR_STR, row, col);
-   ti_write_str(str);
+   write_cap(CAP(active_term, TI_MOVE_CURSOR), row, col);
 }
 
 /**
@@ -244,8 +945,16 @@ EXPORT void ti_set_cursor_position(int row, int col)
 */
 EXPORT void ti_get_cursor_position(int *row, int *col)
 {
-   int fh = STDOUT_FILENO;
-   ti_write_str(REPORT_CURSOR_STR);
+   PTERM *term = active_term;
+   int fh = term->fd_in;
+
+   *row = *col = 0;
+   if (term->caps == NULL)
+      return;
+
+   term_flush(term);
+   const char *report = CAP(term, TI_REPORT_CURSOR);
+   term_write_fd(term, report, strlen(report));
 
    struct termios original, raw;
    tcgetattr(fh, &original);
@@ -253,7 +962,15 @@ EXPORT void ti_get_cursor_position(int *row, int *col)
    raw.c_lflag &= ~(ECHO|ECHONL|ICANON|ISIG|IEXTEN);
    tcsetattr(fh, TCSANOW, &raw);
 
-   scanf("\x1b[%d;%dR", row, col);
+   // Read the "\x1b[row;colR" response:
+   char buff[32];
+   int len = 0;
+   while (len < (int)sizeof(buff) - 1 && read(fh, &buff[len], 1) == 1)
+      if (buff[len++] == 'R')
+         break;
+   buff[len] = '\0';
+
+   sscanf(buff, "\x1b[%d;%dR", row, col);
 
    tcsetattr(fh, TCSANOW, &original);
 }
@@ -262,19 +979,30 @@ EXPORT void ti_get_cursor_position(int *row, int *col)
  * @brief Return screen size in rows and columns
  * @param "rows"   int variable pointer to return screen size in rows
  * @param "cols"   int variable pointer to return screen size in columns
+ *
+ * A size set with @ref pager_term_set_size takes precedence over
+ * what the terminal reports.
  */
 EXPORT void ti_get_screen_size(int *rows, int *cols)
 {
+   PTERM *term = active_term;
+   if (term->rows > 0 && term->cols > 0)
+   {
+      *rows = term->rows;
+      *cols = term->cols;
+      return;
+   }
+
    (*rows) = 0;
    (*cols) = 0;
    struct winsize ws;
-   int result = ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws);
+   int result = ioctl(term->fd_out, TIOCGWINSZ, &ws);
    if (result == 0)
    {
       *rows = ws.ws_row;
       *cols = ws.ws_col;
    }
-   else
+   else if (term->caps)
    {
       int strow, stcol;
       ti_get_cursor_position(&strow, &stcol);
@@ -296,8 +1024,52 @@ EXPORT void ti_set_scroll_limit(int top, int count)
    // Check status in this rarely-called function:
    assert(ti_values_initialized());
 
-   const char *str = tiparm(SCROLL_REGION_STR, top, top + count);
-   ti_write_str(str);
+   PTERM *term = active_term;
+
+   // Skip redundant changes when panes take turns scrolling:
+   if (top == term->scroll_top && count == term->scroll_count)
+      return;
+
+   write_cap(CAP(term, TI_SCROLL_REGION), top, top + count);
+
+   term->scroll_top = top;
+   term->scroll_count = count;
+}
+
+/**
+ * @brief Confine scrolling between left and right margins (DECSLRM)
+ * @param "left"   index of the leftmost column of the scroll window
+ * @param "count"  number of columns in the scroll window
+ *
+ * Only call this if @ref ti_can_scroll_sides returns *true*.
+ */
+void ti_set_side_limits(int left, int count)
+{
+   PTERM *term = active_term;
+   if (left == term->side_left && count == term->side_count)
+      return;
+
+   // Enable left/right margin mode before first use:
+   if (term->side_count == 0)
+      ti_write_str("\x1b[?69h");
+
+   ti_printf("\x1b[%d;%ds", left + 1, left + count);
+
+   term->side_left = left;
+   term->side_count = count;
+}
+
+/**
+ * @brief Restore full-width scrolling if side limits were set.
+ */
+void ti_clear_side_limits(void)
+{
+   PTERM *term = active_term;
+   if (term->side_count)
+   {
+      ti_write_str("\x1b[?69l");
+      term->side_left = term->side_count = 0;
+   }
 }
 
 /**
@@ -305,7 +1077,7 @@ EXPORT void ti_set_scroll_limit(int top, int count)
  */
 EXPORT void ti_hide_cursor(void)
 {
-   ti_write_str(HIDE_CURSOR_STR);
+   ti_write_str(CAP(active_term, TI_HIDE_CURSOR));
 }
 
 /**
@@ -313,7 +1085,7 @@ EXPORT void ti_hide_cursor(void)
  */
 EXPORT void ti_show_cursor(void)
 {
-   ti_write_str(SHOW_CURSOR_STR);
+   ti_write_str(CAP(active_term, TI_SHOW_CURSOR));
 }
 
 
@@ -326,7 +1098,7 @@ EXPORT void ti_show_cursor(void)
  */
 EXPORT void ti_start_standout(void)
 {
-   ti_write_str(ENTER_STANDOUT_MODE_STR);
+   ti_write_str(CAP(active_term, TI_ENTER_STANDOUT_MODE));
 }
 
 /**
@@ -338,15 +1110,153 @@ EXPORT void ti_start_standout(void)
  */
 EXPORT void ti_end_standout(void)
 {
-   ti_write_str(EXIT_STANDOUT_MODE_STR);
+   ti_write_str(CAP(active_term, TI_EXIT_STANDOUT_MODE));
+}
+
+/**
+ * @defgroup SGR_STATE Minimal changes of text style
+ *
+ * Each terminal remembers the style last set, so only the changes
+ * between styles are sent, even from one line to the next.  The
+ * style returns to the default when the outermost frame closes, so
+ * output outside the pager starts from a known state.
+ * @{
+ */
+
+/**
+ * @brief Append an SGR parameter, with a separator if needed.
+ */
+static void add_sgr_param(char *buff, int *len, int size, const char *fmt, int value)
+{
+   if (*len > 0 && *len < size)
+      buff[(*len)++] = ';';
+   if (*len < size)
+      *len += snprintf(buff + *len, size - *len, fmt, value);
+}
+
+/**
+ * @brief Append the SGR parameters of a colour.
+ * @param "base"  30 for a foreground colour, 40 for a background
+ */
+static void add_sgr_color(char *buff, int *len, int size, int color, int base)
+{
+   int index = color - 1;
+   if (color == 0)
+      add_sgr_param(buff, len, size, "%d", base + 9);
+   else if (index < 8)
+      add_sgr_param(buff, len, size, "%d", base + index);
+   else if (index < 16)
+      add_sgr_param(buff, len, size, "%d", base + 60 + index - 8);
+   else
+   {
+      add_sgr_param(buff, len, size, "%d", base + 8);
+      add_sgr_param(buff, len, size, "5;%d", index);
+   }
+}
+
+/**
+ * @brief Change the text style, sending only what differs.
+ *
+ * The changes are sent as a single SGR sequence, either turning off
+ * and on each attribute that differs, or resetting and setting
+ * every attribute of @p style, whichever is shorter.
+ */
+void ti_set_style(const PSTYLE *style)
+{
+   static const struct { int flag; int on; int off; } attrs[] = {
+      { PAGER_ATTR_BOLD, 1, 22 },
+      { PAGER_ATTR_UNDERLINE, 4, 24 },
+      { PAGER_ATTR_REVERSE, 7, 27 }
+   };
+
+   PSTYLE *current = &active_term->style;
+   if (current->fg == style->fg && current->bg == style->bg && current->attrs == style->attrs)
+      return;
+
+   char change[48], reset[48];
+   int change_len = 0, reset_len = 0;
+   int size = (int)sizeof(change);
+
+   // An empty list of parameters resets the style:
+   if (style->fg || style->bg || style->attrs)
+      add_sgr_param(reset, &reset_len, size, "%d", 0);
+
+   for (int i = 0; i < (int)(sizeof(attrs) / sizeof(attrs[0])); ++i)
+   {
+      bool on = style->attrs & attrs[i].flag;
+      if (on != ((current->attrs & attrs[i].flag) != 0))
+         add_sgr_param(change, &change_len, size, "%d", on ? attrs[i].on : attrs[i].off);
+      if (on)
+         add_sgr_param(reset, &reset_len, size, "%d", attrs[i].on);
+   }
+
+   if (style->fg != current->fg)
+      add_sgr_color(change, &change_len, size, style->fg, 30);
+   if (style->bg != current->bg)
+      add_sgr_color(change, &change_len, size, style->bg, 40);
+   if (style->fg)
+      add_sgr_color(reset, &reset_len, size, style->fg, 30);
+   if (style->bg)
+      add_sgr_color(reset, &reset_len, size, style->bg, 40);
+
+   const char *params = reset_len < change_len ? reset : change;
+   int len = reset_len < change_len ? reset_len : change_len;
+
+   char sequence[56];
+   len = snprintf(sequence, sizeof(sequence), "\x1b[%.*sm", len, params);
+   term_write(active_term, sequence, len);
+
+   *current = *style;
 }
 
+/**
+ * @brief Return to the default background, leaving other attributes.
+ *
+ * Reverse video is turned off too, since some terminals erase in
+ * the reversed colours.
+ */
+static void default_background(void)
+{
+   if (active_term->style.bg || (active_term->style.attrs & PAGER_ATTR_REVERSE))
+   {
+      PSTYLE style = active_term->style;
+      style.bg = 0;
+      style.attrs &= ~PAGER_ATTR_REVERSE;
+      ti_set_style(&style);
+   }
+}
+
+/**
+ * @brief Erase characters from the cursor, in the default background.
+ *
+ * The cursor does not move.  A background colour left by earlier
+ * text is cleared first, since erased cells take the current
+ * background.
+ */
+void ti_erase_chars(int count)
+{
+   if (count <= 0)
+      return;
+
+   default_background();
+
+   char sequence[16];
+   int len = snprintf(sequence, sizeof(sequence), "\x1b[%dX", count);
+   term_write(active_term, sequence, len);
+}
+
+/** @} */
+
 /**
  * @brief AKA scroll DOWN
+ *
+ * The background is made default first, because some terminals
+ * fill the new line with the current background.
  */
 void ti_scroll_forward(void)
 {
-   ti_write_str(SCROLL_FORWARD_STR);
+   default_background();
+   ti_write_str(CAP(active_term, TI_SCROLL_FORWARD));
 }
 
 /**
@@ -354,8 +1264,111 @@ void ti_scroll_forward(void)
  */
 void ti_scroll_reverse(void)
 {
-   ti_write_str(SCROLL_REVERSE_STR);
+   default_background();
+   ti_write_str(CAP(active_term, TI_SCROLL_REVERSE));
 }
 
+/**
+ * @defgroup TERMINAL_SESSIONS Terminals other than the process's own
+ * @brief A program can drive many terminals, each with its own
+ *        descriptors, capabilities, geometry and output buffer.
+ * @{
+ */
 
+/**
+ * @brief Prepare to drive a terminal on a pty or socket.
+ * @param "fd_in"      descriptor from which reports are read
+ * @param "fd_out"     descriptor to which screen output is written,
+ *                     which may be non-blocking
+ * @param "term_name"  terminal type, like `$TERM` for the terminal
+ * @return new terminal handle, or NULL on failure.  Release the
+ *         handle with @ref pager_term_close.
+ *
+ * Set a @ref DPARMS to use the terminal with @ref pager_set_term.
+ */
+EXPORT PTERM *pager_term_open(int fd_in, int fd_out, const char *term_name)
+{
+   const TCAPSET *caps = get_capset(term_name, fd_out);
+   if (caps == NULL)
+      return NULL;
+
+   PTERM *term = (PTERM*)malloc(sizeof(PTERM));
+   if (term)
+   {
+      memset(term, 0, sizeof(PTERM));
+      term->fd_in = fd_in;
+      term->fd_out = fd_out;
+      term->caps = caps;
+      term->scroll_top = term->scroll_count = -1;
+   }
+
+   return term;
+}
+
+/**
+ * @brief Release a terminal handle.  The descriptors are not closed.
+ */
+EXPORT void pager_term_close(PTERM *term)
+{
+   if (active_term == term)
+      active_term = &default_term;
+
+   free(term->buff);
+   free(term);
+}
+
+/**
+ * @brief Take over the screen of a terminal, like @ref pager_init.
+ */
+EXPORT void pager_term_init(PTERM *term)
+{
+   ti_select_term(term, term->stats);
+   query_lr_margins(term);
+   ti_write_str(CAP(term, TI_ENTER_CA_MODE));
+   ti_reset_screen(NULL);
+}
+
+/**
+ * @brief Restore the screen of a terminal, like @ref pager_cleanup.
+ */
+EXPORT void pager_term_cleanup(PTERM *term)
+{
+   ti_select_term(term, term->stats);
+   ti_cleanup_term();
+}
+
+/**
+ * @brief Set the screen size of a terminal.
+ * @param "term"   terminal whose size is being set
+ * @param "rows"   screen rows, or 0 to ask the terminal
+ * @param "cols"   screen columns, or 0 to ask the terminal
+ *
+ * Use this for terminals that can't report their size through
+ * `ioctl`, such as those on sockets, and when they are resized.
+ */
+EXPORT void pager_term_set_size(PTERM *term, int rows, int cols)
+{
+   term->rows = rows;
+   term->cols = cols;
+}
+
+/**
+ * @brief Number of bytes of output waiting to be written.
+ *
+ * If not 0, wait for the output descriptor to become writable, then
+ * call @ref pager_term_flush.
+ */
+EXPORT int pager_term_pending(const PTERM *term)
+{
+   return term->depth ? 0 : term->len;
+}
+
+/**
+ * @brief Write waiting output, as much as the terminal will accept.
+ */
+EXPORT void pager_term_flush(PTERM *term)
+{
+   term_flush(term);
+}
 
+/** @} */
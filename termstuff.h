@@ -1,14 +1,31 @@
 #ifndef TERMSTUFF_H
 #define TERMSTUFF_H
 
+#include <stdbool.h>
+
+struct pager_term;
+struct pager_stats;
+struct pager_style;
+
 bool ti_get_code_values(void);
 bool ti_values_initialized(void);
+bool ti_can_scroll(void);
+bool ti_can_scroll_sides(void);
+
+void ti_begin_frame(void);
+void ti_end_frame(void);
+void ti_flush(void);
 
+struct pager_term *ti_capture_open(const struct pager_term *like);
+char *ti_capture_take(int *len);
+
+void ti_write(const char *str, int len);
 void ti_write_str(const char *str);
 int ti_printf(const char *fmt, ...);
 
 void ti_start_term(void);
 void ti_cleanup_term(void);
+void ti_select_term(struct pager_term *term, struct pager_stats *stats);
 
 void ti_reset_screen(const char *cmd);
 void ti_set_cursor_position(int row, int col);
@@ -17,6 +34,8 @@ void ti_get_cursor_position(int *row, int *col);
 void ti_get_screen_size(int *rows, int *cols);
 
 void ti_set_scroll_limit(int top, int count);
+void ti_set_side_limits(int left, int count);
+void ti_clear_side_limits(void);
 
 void ti_hide_cursor(void);
 void ti_show_cursor(void);
@@ -24,6 +43,9 @@ void ti_show_cursor(void);
 void ti_start_standout(void);
 void ti_end_standout(void);
 
+void ti_set_style(const struct pager_style *style);
+void ti_erase_chars(int count);
+
 void ti_scroll_forward(void);
 void ti_scroll_reverse(void);
 
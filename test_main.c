@@ -10,7 +10,6 @@
 #include <assert.h>
 #include <sys/ioctl.h>    // for ioctl() in get_screen_size()
 
-#include <linelist.h>
 #include <contools.h>
 
 #include "pager.h"
@@ -18,66 +17,6 @@
 
 // #include "../lib_cons/cons.h"
 
-typedef struct {
-   int   count;
-   LLIST *contents;
-   const char **lines;
-} LLDATA;
-
-const char *get_line_LLDATA(LLDATA *lldata, int index)
-{
-   assert(index>=0 && index < lldata->count);
-   return lldata->lines[index];
-}
-
-bool init_LLDATA(LLDATA *lls, const char *filename)
-{
-   memset(lls, 0, sizeof(LLDATA));
-   if (linelist_from_filename(&lls->contents, &lls->count, filename))
-   {
-      char **temp = (char**)malloc(sizeof(char*) * lls->count);
-      if (temp)
-      {
-         char **sptr = temp;
-         char **send = sptr + lls->count;
-         LLIST *lptr = lls->contents;
-
-         while (lptr && sptr < send)
-         {
-            *sptr = lptr->line;
-
-            lptr = lptr->next;
-            ++sptr;
-         }
-
-         lls->lines = (const char **)temp;
-
-         return true;
-      }
-      else
-      {
-         linelist_destroy(&lls->contents);
-         lls->count = 0;
-      }
-   }
-
-   return false;
-}
-
-void destroy_LLDATA(LLDATA *lls)
-{
-   if (lls->lines)
-   {
-      free(lls->lines);
-      lls->lines = NULL;
-   }
-
-   if (lls->contents)
-      linelist_destroy(&lls->contents);
-
-   lls->count = 0;
-}
-
 typedef struct key_map {
    const char *stroke;
    const char *name;
@@ -139,48 +78,20 @@ ARV process_keystroke(DPARMS *parms)
 }
 
 
-/**
- * @brief Implementation of line printer function to be used in a DPARMs struct
- *
- * @param "row_index"   index of row in source data of the indicated line
- * @param "indicated"   flag, highlight if *true*, normal if *false*
- * @param "length"      number of characters to print (include spaces to fill line)
- * @param "data_source" to be recase as appropriate data source from which to get data
- * @param "data_extra"  optional, application-specific data
- * @return Number of characters printed, kind of meaningless.
- */
-int lldata_print(int row_index, int indicated, int length, void *data_source, void *data_extra)
-{
-   LLDATA *lldata = (LLDATA*)data_source;
-   const char *str = get_line_LLDATA(lldata, row_index);
-   if (indicated)
-      ti_write_str("\x1b[7m");
-
-   char *buff = (char*)alloca(length+1);
-   snprintf(buff, length+1, "%-*s", length, str);
-   ti_write_str(buff);
-   // ti_printf("%-*s", length, str);
-
-   if (indicated)
-      ti_write_str("\x1b[27m");
-
-   return length;
-}
-
-void prepare_DPARMS(DPARMS *parms, LLDATA *index)
+void prepare_DPARMS(DPARMS *parms, PLINES *store)
 {
    memset(parms, 0, sizeof(DPARMS));
-   pager_init_dparms(parms, index, index->count, lldata_print, NULL);
+   pager_init_dparms(parms, store, pager_lines_count(store), pager_lines_printer, NULL);
    pager_set_margins(parms, 4, 4, 4, 4);
 }
 
 int run_with_keymap(const char *filename)
 {
-   LLDATA lldata;
-   if (init_LLDATA(&lldata, filename))
+   PLINES *store = pager_lines_create();
+   if (store && pager_lines_read_file(store, filename))
    {
       DPARMS parms;
-      prepare_DPARMS(&parms, &lldata);
+      prepare_DPARMS(&parms, store);
 
       ARV arv = ARV_REPLOT_DATA;
       while (arv != ARV_EXIT)
@@ -196,11 +107,14 @@ int run_with_keymap(const char *filename)
 
       // pager_begin(&parms, (KEYMAP*)&km_test, get_keystroke);
 
-      destroy_LLDATA(&lldata);
+      pager_lines_destroy(store);
 
       return 0;
    }
 
+   if (store)
+      pager_lines_destroy(store);
+
    return 1;
 }
 